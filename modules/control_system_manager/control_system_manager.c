@@ -1,4 +1,5 @@
 #include <control_system_manager.h>
+#include <trace.h>
 #include <string.h>
 
 /** Call a filter() pointer :
@@ -97,6 +98,18 @@ void  cs_set_output_filter(struct cs* cs, float (*output_filter)(void*, float),
 }
 
 
+/** Set the cs disturbance_observer fields in the cs structure */
+void cs_set_disturbance_observer(struct cs* cs, float (*disturbance_observer)(void*, float, float, float),
+                                 void (*disturbance_observer_restart)(void*),
+                                 void* disturbance_observer_params)
+{
+    cs->disturbance_observer = disturbance_observer;
+    cs->disturbance_observer_restart = disturbance_observer_restart;
+    cs->disturbance_observer_params = disturbance_observer_params;
+    cs->disturbance_observer_stale = 0;
+}
+
+
 void cs_set_process_in(struct cs* cs, void (*process_in)(void*, float), void* process_in_params)
 {
     cs->process_in = process_in;
@@ -116,6 +129,9 @@ void cs_set_process_out(struct cs* cs, float (*process_out)(void*), void* proces
 float cs_do_process(struct cs* cs, float consign)
 {
     float process_out_value = 0;
+    float prev_out_value;
+
+    TRACE_BEGIN("cs_do_process");
 
     if (cs->enabled) {
         cs->consign_value = consign;
@@ -129,25 +145,102 @@ float cs_do_process(struct cs* cs, float consign)
 
         cs->error_value = cs->filtered_consign_value - process_out_value ;
 
+        prev_out_value = cs->out_value;
         cs->out_value = safe_filter(cs->correct_filter, cs->correct_filter_params, cs->error_value);
+        if (cs->disturbance_observer) {
+            if (cs->disturbance_observer_stale && cs->disturbance_observer_restart)
+                cs->disturbance_observer_restart(cs->disturbance_observer_params);
+            cs->disturbance_observer_stale = 0;
+            cs->out_value = cs->disturbance_observer(cs->disturbance_observer_params, cs->out_value,
+                                                     process_out_value, prev_out_value);
+        }
         cs->out_value = safe_filter(cs->output_filter, cs->output_filter_params, cs->out_value);
     } else {
         cs->out_value = 0; /* disables the cs */
+        cs->disturbance_observer_stale = 1;
     }
 
     /* send out_value to process in*/
     safe_setprocessin (cs->process_in, cs->process_in_params, cs->out_value);
 
+    TRACE_END("cs_do_process");
+
     /* return the out value */
     return (cs->out_value);
 }
 
 
 
+void cs_set_adaptive_rate(struct cs* cs, float deadband, uint16_t delay, uint16_t divider)
+{
+    cs->idle_deadband = deadband;
+    cs->idle_delay = delay;
+    cs->idle_divider = divider;
+    cs_wake(cs);
+}
+
+uint8_t cs_is_idle(struct cs* cs)
+{
+    return cs->idle;
+}
+
+void cs_wake(struct cs* cs)
+{
+    cs->idle = 0;
+    cs->idle_cpt = 0;
+}
+
+/** Returns 1 if this call of cs_manage() can be skipped. */
+static uint8_t cs_idle_skip(struct cs* cs)
+{
+    if (!cs->idle)
+        return 0;
+
+    /* supervision iteration */
+    if (++cs->idle_cpt >= cs->idle_divider) {
+        cs->idle_cpt = 0;
+        return 0;
+    }
+
+    cs->disturbance_observer_stale = 1;
+    return 1;
+}
+
+/** Updates the idle state after processing the control system. */
+static void cs_idle_update(struct cs* cs)
+{
+    uint8_t settled;
+
+    /* a disabled cs already sent its zero output */
+    if (!cs->enabled) {
+        cs->idle = 1;
+        return;
+    }
+
+    settled = cs->filtered_consign_value == cs->consign_value &&
+              cs->error_value <= cs->idle_deadband &&
+              cs->error_value >= -cs->idle_deadband;
+
+    if (!settled) {
+        cs_wake(cs);
+    }
+    else if (!cs->idle && ++cs->idle_cpt >= cs->idle_delay) {
+        cs->idle = 1;
+        cs->idle_cpt = 0;
+    }
+}
+
 void cs_manage(void * data)
 {
     struct cs* cs = data;
+
+    if (cs->idle_divider > 1 && cs_idle_skip(cs))
+        return;
+
     cs_do_process(cs, cs->consign_value);
+
+    if (cs->idle_divider > 1)
+        cs_idle_update(cs);
 }
 
 
@@ -186,17 +279,21 @@ float cs_get_feedback(struct cs* cs)
 
 void cs_set_consign(struct cs* cs, float v)
 {
+    if (v != cs->consign_value)
+        cs_wake(cs);
     cs->consign_value = v;
 }
 
 void cs_enable(struct cs * cs)
 {
     cs->enabled = 1;
+    cs_wake(cs);
 }
 
 void cs_disable(struct cs * cs)
 {
     cs->enabled = 0;
+    cs_wake(cs);
 }
 
 
@@ -33,6 +33,17 @@ struct cs {
     float (*output_filter)(void*, float);
     void* output_filter_params; /**< Parameter for output_filter, will be passed as 1st param. */
 
+    /** Callback function for the disturbance observer, eg: cs_dob_do_filter().
+     * It gets the output of correct_filter, the filtered feedback and the
+     * output sent to the process at the previous iteration, and returns the
+     * compensated output, given to output_filter. */
+    float (*disturbance_observer)(void*, float, float, float);
+    /** Called before disturbance_observer when the previous iterations were
+     * not processed (idle or disabled control system), eg: cs_dob_do_restart(). */
+    void (*disturbance_observer_restart)(void*);
+    void* disturbance_observer_params; /**< Parameter for disturbance_observer, will be passed as 1st param. */
+    uint8_t disturbance_observer_stale; /**< =1 if iterations were not given to disturbance_observer. */
+
     float (*process_out)(void*); /**< Callback function to get process out, eg : encoder value. */
     void* process_out_params; /**< Parameter for process_out, will be passed as 1st param. */
 
@@ -49,6 +60,13 @@ struct cs {
     float error_value; /**< Error value. This is filtered_consign_value - filtered_feedback_value. */
     float out_value; /**< Output of correct_filter, as sent to process_in. */
     int enabled; /**< =1 if the control system is enabled, 0 otherwise. */
+
+    /* Adaptive rate, see cs_set_adaptive_rate(). */
+    float idle_deadband; /**< Maximal error of an idle control system. */
+    uint16_t idle_delay; /**< Number of settled iterations before going idle. */
+    uint16_t idle_divider; /**< An idle control system is processed once every idle_divider calls. */
+    uint16_t idle_cpt; /**< Settled iterations, or calls skipped when idle. */
+    uint8_t idle; /**< =1 if the control system is idle. */
 };
 
 /******* - Prototyping - *******/
@@ -95,6 +113,21 @@ void  cs_set_output_filter(struct cs* cs,
                                     float (*output_filter)(void*, float),
                                     void* output_filer_params);
 
+/** Set the cs disturbance_observer fields in the cs structure.
+ * @param [in] cs A cs structure instance.
+ * @param [in] *disturbance_observer The disturbance observer function, eg cs_dob_do_filter().
+ * @param [in] *disturbance_observer_restart Called when the control system
+ * is processed again after skipped iterations (idle or disabled), as the
+ * feedback history of the observer is then outdated, eg cs_dob_do_restart().
+ * May be NULL.
+ * @param [in] *disturbance_observer_params The first parameter of both functions.
+ * @sa cs_dob.h
+ */
+void  cs_set_disturbance_observer(struct cs* cs,
+                                  float (*disturbance_observer)(void*, float, float, float),
+                                  void (*disturbance_observer_restart)(void*),
+                                  void* disturbance_observer_params);
+
 /** Set the cs process_in fields in the cs structure.
  * @param [in] cs A cs structure instance.
  * @param [in] *process_in The process in callback, eg : set_pwm().
@@ -122,6 +155,7 @@ void cs_set_process_out(struct cs* cs,
  * - Apply the feedback filter to the process out
  * - Substract filtered consign to filtered process out.
  * - Save the result in error_value and apply the correct filter.
+ * - Apply the disturbance observer and the output filter.
  * - Save the filtered result and send it to process_in().
  * - Return this result.
  *
@@ -135,10 +169,44 @@ float cs_do_process(struct cs* cs, float consign);
 /** Apply cs_do_process() to the structure cs
  *  @param [in] cs A cs structure instance, cast to void *.
  *  @note This is the same as cs_do_process except it takes the consign from
- *  the structure field.
+ *  the structure field, and it skips idle control systems when the
+ *  adaptive rate is enabled (see cs_set_adaptive_rate()).
  */
 void cs_manage(void * cs);
 
+/** @brief Enables the adaptive rate of cs_manage().
+ *
+ * When the consign filter has reached the consign (the ramp is finished)
+ * and the error stays within the deadband during delay iterations, or
+ * when the control system is disabled, it becomes idle: cs_manage() only
+ * processes it once every divider calls, the process input keeping its
+ * last value in between. This leaves the CPU to other tasks when the
+ * robot is parked.
+ *
+ * An idle control system wakes up immediately when its consign is changed
+ * with cs_set_consign(), when it is enabled or disabled, or when its error
+ * leaves the deadband at one of the supervision iterations.
+ *
+ * @param [in] cs A cs structure instance.
+ * @param [in] deadband Maximal absolute error of an idle control system.
+ * @param [in] delay Number of settled iterations before going idle.
+ * @param [in] divider Processing period when idle, in calls of
+ * cs_manage(). 0 or 1 disables the adaptive rate (default).
+ */
+void cs_set_adaptive_rate(struct cs* cs, float deadband, uint16_t delay, uint16_t divider);
+
+/** @brief Returns 1 if the control system is idle.
+ * @param [in] cs A cs structure instance.
+ * @sa cs_set_adaptive_rate()
+ */
+uint8_t cs_is_idle(struct cs* cs);
+
+/** @brief Wakes an idle control system up, it will be processed at the next
+ * call of cs_manage().
+ * @param [in] cs A cs structure instance.
+ */
+void cs_wake(struct cs* cs);
+
 /** Return the last output sent to process.
  * @param [in] cs A cs structure instance.
  * @returns Last output of the control system, as sent to process in. */
@@ -0,0 +1,87 @@
+#include <cs_dob.h>
+
+void cs_dob_init(struct cs_dob *dob)
+{
+    cs_dob_set_model(dob, 1., 0.);
+    cs_dob_set_q_filter(dob, 1., 20.);
+    cs_dob_set_max(dob, 0.);
+    cs_dob_reset(dob);
+}
+
+void cs_dob_set_model(struct cs_dob *dob, float gain, float damping)
+{
+    dob->gain = gain;
+    dob->damping = damping;
+}
+
+void cs_dob_set_q_filter(struct cs_dob *dob, float fc, float fs)
+{
+    lowpass_set_cutoff(&dob->q1, fc, fs);
+    lowpass_set_cutoff(&dob->q2, fc, fs);
+}
+
+void cs_dob_set_max(struct cs_dob *dob, float max)
+{
+    dob->max = max;
+}
+
+void cs_dob_reset(struct cs_dob *dob)
+{
+    cs_dob_do_restart(dob);
+
+    /* The Q filter starts from 0, not from the first (noisy) estimate. */
+    lowpass_reset(&dob->q1);
+    lowpass_reset(&dob->q2);
+    lowpass_do_filter(&dob->q1, 0.);
+    lowpass_do_filter(&dob->q2, 0.);
+    dob->disturbance = 0.;
+}
+
+void cs_dob_do_restart(void *data)
+{
+    struct cs_dob *dob = data;
+
+    dob->samples = 0;
+    dob->y_prev = 0.;
+    dob->v_prev = 0.;
+}
+
+float cs_dob_get_disturbance(struct cs_dob *dob)
+{
+    return dob->disturbance;
+}
+
+float cs_dob_do_filter(void *data, float out, float feedback, float prev_out)
+{
+    struct cs_dob *dob = data;
+    float v, raw;
+
+    v = feedback - dob->y_prev;
+    dob->y_prev = feedback;
+
+    /* Two samples are needed for a speed, three for an acceleration. */
+    if (dob->samples < 2) {
+        dob->samples++;
+        dob->v_prev = v;
+        return out - dob->disturbance;
+    }
+
+    /* Command explained by the measure (inverse nominal model), minus the
+     * command really sent. */
+    raw = (v - (1. - dob->damping) * dob->v_prev) / dob->gain - prev_out;
+    dob->v_prev = v;
+
+    /* Q filter */
+    dob->disturbance = lowpass_do_filter(&dob->q2, lowpass_do_filter(&dob->q1, raw));
+
+    /* The limit also applies to the filter state, so it does not wind up. */
+    if (dob->max > 0.) {
+        if (dob->disturbance > dob->max)
+            dob->disturbance = dob->max;
+        else if (dob->disturbance < -dob->max)
+            dob->disturbance = -dob->max;
+        dob->q2.out = dob->disturbance;
+    }
+
+    return out - dob->disturbance;
+}
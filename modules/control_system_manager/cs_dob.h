@@ -0,0 +1,112 @@
+/** @file cs_dob.h
+ * @author CVRA
+ * @brief Disturbance observer for the control system manager.
+ *
+ * When the robot pushes something, the motors see a load which the
+ * integral term of the PID only absorbs slowly. A disturbance observer
+ * estimates this load every period and cancels it directly.
+ *
+ * The process is modelled as a motor driving an inertia, in the units of
+ * the control system (feedback units and periods):
+ *
+ * v(k) = y(k) - y(k-1), v(k) = (1 - c) v(k-1) + g (u(k-1) + d)
+ *
+ * where u is the command sent to the process and d the disturbance, in
+ * command units. Inverting this nominal model gives the command which
+ * would explain the measured acceleration; its difference with the
+ * command really sent is the disturbance. This raw estimate is very
+ * noisy (it is a second derivative of the position), so it goes through
+ * a low pass filter, the Q filter, before being subtracted from the
+ * output of the corrector. The cutoff of the Q filter sets the trade-off
+ * between the rejection speed and the noise. The cost is a few
+ * multiply-adds per period.
+ *
+ * The same g and c as the ones given to tools/lqr_design can be used.
+ *
+ * @code
+ * cs_dob_init(&dob);
+ * cs_dob_set_model(&dob, 0.02, 0.01);
+ * cs_dob_set_q_filter(&dob, 20., 1000.);
+ * cs_dob_set_max(&dob, 1000.);
+ * cs_set_disturbance_observer(&distance_cs, cs_dob_do_filter, cs_dob_do_restart, &dob);
+ * @endcode
+ *
+ * When the control system skips iterations (adaptive rate, disabled
+ * control system), the feedback history is outdated: cs_dob_do_restart()
+ * measures the speed again from the next iteration, keeping the estimated
+ * disturbance in the meantime.
+ */
+
+#ifndef _CS_DOB_H_
+#define _CS_DOB_H_
+
+#include <stdint.h>
+#include <lowpass.h>
+
+/** A disturbance observer instance. */
+struct cs_dob {
+    float gain;         /**< Acceleration per unit of command, g. */
+    float damping;      /**< Fraction of the speed lost each period, c. */
+    float max;          /**< Maximal compensation, 0 to disable the limit. */
+
+    float y_prev;       /**< Feedback at the previous period. */
+    float v_prev;       /**< Speed at the previous period. */
+    uint8_t samples;    /**< Number of feedback samples received, up to 2. */
+    struct lowpass q1;  /**< First stage of the Q filter. */
+    struct lowpass q2;  /**< Second stage of the Q filter. */
+    float disturbance;  /**< Estimated disturbance, in command units. */
+};
+
+/** @brief Initializes the observer.
+ *
+ * The default model has a gain of 1 and no damping, with a Q filter at a
+ * twentieth of the sampling frequency.
+ * @param [in] dob The cs_dob instance.
+ */
+void cs_dob_init(struct cs_dob *dob);
+
+/** @brief Sets the nominal model of the process.
+ * @param [in] dob The cs_dob instance.
+ * @param [in] gain Acceleration given by one unit of command, in feedback
+ * units per period^2.
+ * @param [in] damping Fraction of the speed lost each period.
+ */
+void cs_dob_set_model(struct cs_dob *dob, float gain, float damping);
+
+/** @brief Sets the cutoff frequency of the Q filter.
+ *
+ * The Q filter is made of two identical first order low pass filters.
+ * @param [in] dob The cs_dob instance.
+ * @param [in] fc The cutoff frequency of each stage, in Hz.
+ * @param [in] fs The frequency of the control system, in Hz.
+ */
+void cs_dob_set_q_filter(struct cs_dob *dob, float fc, float fs);
+
+/** @brief Sets the maximal compensation, in command units (0 to disable). */
+void cs_dob_set_max(struct cs_dob *dob, float max);
+
+/** @brief Clears the estimation, for example when the load changed while
+ * the control system was disabled. */
+void cs_dob_reset(struct cs_dob *dob);
+
+/** @brief Measures the speed again from the next sample, keeping the
+ * estimated disturbance.
+ *
+ * \param [in] data A pointer to a cs_dob instance, casted to void *.
+ */
+void cs_dob_do_restart(void *data);
+
+/** @brief Returns the estimated disturbance, in command units. */
+float cs_dob_get_disturbance(struct cs_dob *dob);
+
+/** @brief Disturbance observer function for cs_set_disturbance_observer().
+ *
+ * \param [in] data A pointer to a cs_dob instance, casted to void *.
+ * \param [in] out The output of the corrector.
+ * \param [in] feedback The filtered feedback of this period.
+ * \param [in] prev_out The output sent to the process at the previous period.
+ * @returns The compensated output.
+ */
+float cs_dob_do_filter(void *data, float out, float feedback, float prev_out);
+
+#endif
@@ -0,0 +1,116 @@
+/** @file modules/coro/coro.c
+ * @author CVRA
+ * @brief Stackless coroutines to write the strategy without threads.
+ */
+
+#include <stddef.h>
+#include "coro.h"
+
+void coro_sched_init(struct coro_sched *sched, uint32_t (*get_time)(void))
+{
+    sched->head = NULL;
+    sched->get_time = get_time;
+    sched->now = get_time();
+    sched->running = 0;
+}
+
+void coro_init(struct coro *c)
+{
+    c->lc = 0;
+    c->state = CORO_ENDED;
+    c->timed_out = 0;
+    c->deadline = 0;
+    c->fn = NULL;
+    c->arg = NULL;
+    c->sched = NULL;
+    c->next = NULL;
+}
+
+void coro_start(struct coro_sched *sched, struct coro *c,
+                char (*fn)(struct coro *), void *arg)
+{
+    struct coro **pp;
+
+    c->lc = 0;
+    c->state = CORO_YIELDED;
+    c->timed_out = 0;
+    c->fn = fn;
+    c->arg = arg;
+
+    /* already in the run list */
+    if (c->sched == sched)
+        return;
+
+    c->sched = sched;
+    c->next = NULL;
+    for (pp = &sched->head; *pp != NULL; pp = &(*pp)->next);
+    *pp = c;
+}
+
+void coro_kill(struct coro *c)
+{
+    struct coro **pp;
+
+    if (c->sched == NULL)
+        return;
+
+    c->state = CORO_ENDED;
+    c->lc = 0;
+
+    /* coro_run() is walking the list, it will remove the coroutine */
+    if (c->sched->running)
+        return;
+
+    for (pp = &c->sched->head; *pp != c; pp = &(*pp)->next);
+    *pp = c->next;
+    c->sched = NULL;
+}
+
+uint8_t coro_is_done(struct coro *c)
+{
+    return c->sched == NULL || c->state == CORO_ENDED;
+}
+
+void coro_set_deadline(struct coro *c, uint32_t duration)
+{
+    c->deadline = c->sched->now + duration;
+}
+
+uint8_t coro_deadline_passed(struct coro *c)
+{
+    /* works across the wrap of the clock */
+    return (int32_t)(c->sched->now - c->deadline) >= 0;
+}
+
+uint8_t coro_run(struct coro_sched *sched)
+{
+    struct coro **pp = &sched->head;
+    struct coro *c;
+    uint8_t alive = 0;
+
+    sched->now = sched->get_time();
+    sched->running = 1;
+
+    while ((c = *pp) != NULL) {
+        if (c->state == CORO_SLEEPING && !coro_deadline_passed(c)) {
+            alive++;
+            pp = &c->next;
+            continue;
+        }
+
+        if (c->state != CORO_ENDED)
+            c->state = c->fn(c);
+
+        if (c->state == CORO_ENDED) {
+            *pp = c->next;
+            c->sched = NULL;
+            continue;
+        }
+
+        alive++;
+        pp = &c->next;
+    }
+
+    sched->running = 0;
+    return alive;
+}
@@ -0,0 +1,186 @@
+/** @file modules/coro/coro.h
+ * @author CVRA
+ * @brief Stackless coroutines to write the strategy without threads.
+ *
+ * A strategy sequence is a succession of moves and waits. Written as
+ * plain code, each wait is a loop polling trajectory_finished(), bd_get()
+ * or a timer, and every concurrent sequence needs a thread. With this
+ * module, a sequence is a coroutine: a function which returns to the
+ * scheduler when it has to wait, and continues after the wait the next
+ * time it is called. All the coroutines run on the same thread, from
+ * coro_run(), without any stack of their own (protothreads):
+ * @code
+ * static char drive(struct coro *c)
+ * {
+ *     struct drive_state *s = c->arg;
+ *
+ *     CORO_BEGIN(c);
+ *     trajectory_goto_xy_abs(&traj, 500, 300);
+ *     CORO_WAIT_UNTIL_TIMEOUT(c, trajectory_finished(&traj) || bd_get(&bd), 5000000);
+ *     if (CORO_TIMED_OUT(c) || bd_get(&bd))
+ *         CORO_EXIT(c);
+ *
+ *     s->path_id = planner_service_request(&planner, 500, 300, 2500, 1500);
+ *     CORO_WAIT_UNTIL(c, planner_service_get_result(&planner)->id == s->path_id);
+ *     ...
+ *     CORO_SLEEP(c, 200000);
+ *     CORO_END(c);
+ * }
+ *
+ * coro_sched_init(&sched, get_time_us);
+ * coro_init(&drive_coro);
+ * coro_init(&arm_coro);
+ * coro_start(&sched, &drive_coro, drive, &drive_state);
+ * coro_start(&sched, &arm_coro, arm, NULL);
+ *
+ * // in a periodic task, or a loop sleeping between the calls
+ * coro_run(&sched);
+ * @endcode
+ *
+ * A waiting coroutine only evaluates its condition once per coro_run(),
+ * and a sleeping one is not called before its deadline, so nothing spins.
+ *
+ * @warning The local variables of a coroutine are lost when it waits:
+ * keep the state in the structure given as arg. The wait macros expand to
+ * case labels named after their line, so there can be only one per line,
+ * and they cannot be used inside a switch statement of the coroutine.
+ */
+
+#ifndef _CORO_H_
+#define _CORO_H_
+
+#include <stdint.h>
+
+/** Return values of a coroutine function. */
+#define CORO_WAITING 0  /**< Waiting for a condition. */
+#define CORO_YIELDED 1  /**< Gave the hand to the other coroutines. */
+#define CORO_SLEEPING 2 /**< Must not be called before its deadline. */
+#define CORO_ENDED 3    /**< Finished. */
+
+struct coro;
+struct coro_sched;
+
+/** A coroutine. */
+struct coro {
+    uint16_t lc;       /**< Line where the coroutine resumes, 0 to start. */
+    uint8_t state;     /**< Last value returned by fn. */
+    uint8_t timed_out; /**< Set by CORO_WAIT_UNTIL_TIMEOUT() when it times out. */
+    uint32_t deadline; /**< End of a sleep or of a timeout, in us. */
+    char (*fn)(struct coro *); /**< Body of the coroutine. */
+    void *arg;         /**< Argument given to coro_start(). */
+    struct coro_sched *sched; /**< Scheduler running the coroutine. */
+    struct coro *next; /**< Next coroutine in the run list. */
+};
+
+/** The scheduler, a list of coroutines run in turn. */
+struct coro_sched {
+    struct coro *head;         /**< Run list. */
+    uint32_t (*get_time)(void); /**< Clock, in microseconds. */
+    uint32_t now;              /**< Time at the start of the current coro_run(). */
+    uint8_t running;           /**< 1 during coro_run(). */
+};
+
+/** Marks the expected fall through to the case label of a wait. */
+#if defined(__GNUC__) && __GNUC__ >= 7
+#define CORO_FALLTHROUGH __attribute__((fallthrough))
+#else
+#define CORO_FALLTHROUGH do { } while (0)
+#endif
+
+/** Starts the body of a coroutine. */
+#define CORO_BEGIN(c) switch ((c)->lc) { case 0:
+
+/** Ends the body of a coroutine. */
+#define CORO_END(c) } (c)->lc = 0; return CORO_ENDED
+
+/** Ends the coroutine now. */
+#define CORO_EXIT(c) do { (c)->lc = 0; return CORO_ENDED; } while (0)
+
+/** Lets the other coroutines run, and continues at the next coro_run(). */
+#define CORO_YIELD(c) do {                                      \
+        (c)->lc = __LINE__;                                     \
+        return CORO_YIELDED;                                    \
+    case __LINE__:;                                             \
+    } while (0)
+
+/** Waits until cond is true. cond is evaluated once per coro_run(). */
+#define CORO_WAIT_UNTIL(c, cond) do {                           \
+        (c)->lc = __LINE__;                                     \
+        CORO_FALLTHROUGH;                                       \
+    case __LINE__:                                              \
+        if (!(cond)) return CORO_WAITING;                       \
+    } while (0)
+
+/** Waits until cond is true, or during timeout us at most.
+ * CORO_TIMED_OUT() tells which one happened. */
+#define CORO_WAIT_UNTIL_TIMEOUT(c, cond, timeout) do {          \
+        coro_set_deadline((c), (timeout));                      \
+        (c)->lc = __LINE__;                                     \
+        CORO_FALLTHROUGH;                                       \
+    case __LINE__:                                              \
+        (c)->timed_out = 0;                                     \
+        if (!(cond)) {                                          \
+            if (!coro_deadline_passed(c)) return CORO_WAITING;  \
+            (c)->timed_out = 1;                                 \
+        }                                                       \
+    } while (0)
+
+/** 1 if the last CORO_WAIT_UNTIL_TIMEOUT() timed out. */
+#define CORO_TIMED_OUT(c) ((c)->timed_out)
+
+/** Sleeps during duration us. */
+#define CORO_SLEEP(c, duration) do {                            \
+        coro_set_deadline((c), (duration));                     \
+        (c)->lc = __LINE__;                                     \
+        return CORO_SLEEPING;                                   \
+    case __LINE__:;                                             \
+    } while (0)
+
+/** Waits for the end of another coroutine. */
+#define CORO_WAIT_CORO(c, other) CORO_WAIT_UNTIL((c), coro_is_done(other))
+
+/** Initializes a scheduler.
+ * @param [in] sched The coro_sched instance.
+ * @param [in] get_time Clock, in microseconds. It may wrap.
+ */
+void coro_sched_init(struct coro_sched *sched, uint32_t (*get_time)(void));
+
+/** Initializes a coroutine, which is then done and belongs to no
+ * scheduler. A zeroed coroutine (a static variable for instance) is
+ * initialized too.
+ */
+void coro_init(struct coro *c);
+
+/** Adds a coroutine to the scheduler, it starts at the next coro_run().
+ *
+ * A coroutine which is running is restarted from the beginning. A
+ * coroutine belongs to a single scheduler.
+ * @warning c must have been initialized with coro_init() once, before its
+ * first start: coro_start() uses its fields to know if it is already in
+ * the run list.
+ * @param [in] sched The coro_sched instance.
+ * @param [in] c The coroutine, which must stay valid until it ends.
+ * @param [in] fn Body of the coroutine.
+ * @param [in] arg Stored in c->arg.
+ */
+void coro_start(struct coro_sched *sched, struct coro *c,
+                char (*fn)(struct coro *), void *arg);
+
+/** Removes a coroutine from its scheduler, it will not be resumed. */
+void coro_kill(struct coro *c);
+
+/** Returns 1 if the coroutine ended (or was never started). */
+uint8_t coro_is_done(struct coro *c);
+
+/** Resumes each coroutine once, except those which are sleeping.
+ * @return The number of coroutines which did not end yet.
+ */
+uint8_t coro_run(struct coro_sched *sched);
+
+/** Sets the deadline of a coroutine, duration us from now. */
+void coro_set_deadline(struct coro *c, uint32_t duration);
+
+/** Returns 1 when the deadline of the coroutine is passed. */
+uint8_t coro_deadline_passed(struct coro *c);
+
+#endif
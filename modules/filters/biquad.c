@@ -0,0 +1,210 @@
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <biquad.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+void biquad_init(struct biquad *b) {
+    biquad_set_coefs(b, 1., 0., 0., 0., 0.);
+    biquad_reset(b);
+}
+
+void biquad_reset(struct biquad *b) {
+    b->z1 = 0.;
+    b->z2 = 0.;
+}
+
+void biquad_set_coefs(struct biquad *b, float b0, float b1, float b2,
+                      float a1, float a2) {
+    b->b0 = b0;
+    b->b1 = b1;
+    b->b2 = b2;
+    b->a1 = a1;
+    b->a2 = a2;
+}
+
+/** Sets the coefficients, dividing them by a0. */
+static void biquad_set_normalized(struct biquad *b, float b0, float b1, float b2,
+                                  float a0, float a1, float a2) {
+    biquad_set_coefs(b, b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0);
+}
+
+void biquad_design_lowpass(struct biquad *b, float fc, float fs, float q) {
+    float w0 = 2. * M_PI * fc / fs;
+    float cosw = cosf(w0);
+    float alpha = sinf(w0) / (2. * q);
+
+    biquad_set_normalized(b, (1. - cosw) / 2., 1. - cosw, (1. - cosw) / 2.,
+                          1. + alpha, -2. * cosw, 1. - alpha);
+}
+
+void biquad_design_highpass(struct biquad *b, float fc, float fs, float q) {
+    float w0 = 2. * M_PI * fc / fs;
+    float cosw = cosf(w0);
+    float alpha = sinf(w0) / (2. * q);
+
+    biquad_set_normalized(b, (1. + cosw) / 2., -(1. + cosw), (1. + cosw) / 2.,
+                          1. + alpha, -2. * cosw, 1. - alpha);
+}
+
+void biquad_design_notch(struct biquad *b, float f0, float fs, float q) {
+    float w0 = 2. * M_PI * f0 / fs;
+    float cosw = cosf(w0);
+    float alpha = sinf(w0) / (2. * q);
+
+    biquad_set_normalized(b, 1., -2. * cosw, 1.,
+                          1. + alpha, -2. * cosw, 1. - alpha);
+}
+
+void biquad_design_lowpass_1st_order(struct biquad *b, float fc, float fs) {
+    float k = tanf(M_PI * fc / fs);
+
+    biquad_set_normalized(b, k, k, 0., k + 1., k - 1., 0.);
+}
+
+float biquad_do_filter(void *data, float in) {
+    struct biquad *b = data;
+    float out;
+
+    out = b->b0 * in + b->z1;
+    b->z1 = b->b1 * in - b->a1 * out + b->z2;
+    b->z2 = b->b2 * in - b->a2 * out;
+
+    return out;
+}
+
+void biquad_cascade_init(struct biquad_cascade *c) {
+    c->n = 0;
+}
+
+void biquad_cascade_reset(struct biquad_cascade *c) {
+    uint8_t i;
+
+    for (i = 0; i < c->n; i++)
+        biquad_reset(&c->stages[i]);
+}
+
+struct biquad *biquad_cascade_add_stage(struct biquad_cascade *c) {
+    struct biquad *b;
+
+    if (c->n >= BIQUAD_CASCADE_MAX_STAGES)
+        return NULL;
+
+    b = &c->stages[c->n++];
+    biquad_init(b);
+    return b;
+}
+
+void biquad_cascade_design_butterworth(struct biquad_cascade *c, uint8_t order,
+                                       float fc, float fs) {
+    struct biquad *b;
+    uint8_t k;
+
+    if (order > 2 * BIQUAD_CASCADE_MAX_STAGES)
+        order = 2 * BIQUAD_CASCADE_MAX_STAGES;
+
+    biquad_cascade_init(c);
+
+    /* The poles of an analog Butterworth filter are on a circle, each
+     * pair of conjugate poles gives a section with
+     * Q = 1 / (2 sin((2k + 1) pi / 2N)). */
+    for (k = 0; k < order / 2; k++) {
+        b = biquad_cascade_add_stage(c);
+        biquad_design_lowpass(b, fc, fs, 1. / (2. * sinf((2 * k + 1) * M_PI / (2 * order))));
+    }
+
+    /* The real pole of odd orders. */
+    if (order % 2) {
+        b = biquad_cascade_add_stage(c);
+        biquad_design_lowpass_1st_order(b, fc, fs);
+    }
+}
+
+float biquad_cascade_do_filter(void *data, float in) {
+    struct biquad_cascade *c = data;
+    uint8_t i;
+
+    for (i = 0; i < c->n; i++)
+        in = biquad_do_filter(&c->stages[i], in);
+
+    return in;
+}
+
+void biquad_bank_init(struct biquad_bank *bank, uint8_t channels, uint8_t stages) {
+    uint8_t s, ch;
+
+    if (channels > BIQUAD_BANK_MAX_CHANNELS)
+        channels = BIQUAD_BANK_MAX_CHANNELS;
+    if (stages > BIQUAD_CASCADE_MAX_STAGES)
+        stages = BIQUAD_CASCADE_MAX_STAGES;
+
+    memset(bank, 0, sizeof(struct biquad_bank));
+    bank->channels = channels;
+    bank->stages = stages;
+
+    for (s = 0; s < BIQUAD_CASCADE_MAX_STAGES; s++)
+        for (ch = 0; ch < BIQUAD_BANK_MAX_CHANNELS; ch++)
+            bank->b0[s][ch] = 1.;
+}
+
+void biquad_bank_reset(struct biquad_bank *bank) {
+    memset(bank->z1, 0, sizeof(bank->z1));
+    memset(bank->z2, 0, sizeof(bank->z2));
+}
+
+void biquad_bank_set_channel(struct biquad_bank *bank, uint8_t channel,
+                             const struct biquad_cascade *c) {
+    const struct biquad *b;
+    uint8_t s;
+
+    if (channel >= bank->channels)
+        return;
+
+    for (s = 0; s < bank->stages; s++) {
+        if (s < c->n) {
+            b = &c->stages[s];
+            bank->b0[s][channel] = b->b0;
+            bank->b1[s][channel] = b->b1;
+            bank->b2[s][channel] = b->b2;
+            bank->a1[s][channel] = b->a1;
+            bank->a2[s][channel] = b->a2;
+        }
+        else {
+            bank->b0[s][channel] = 1.;
+            bank->b1[s][channel] = 0.;
+            bank->b2[s][channel] = 0.;
+            bank->a1[s][channel] = 0.;
+            bank->a2[s][channel] = 0.;
+        }
+        bank->z1[s][channel] = 0.;
+        bank->z2[s][channel] = 0.;
+    }
+}
+
+void biquad_bank_process(struct biquad_bank *bank, const float *in, float *out) {
+    float x[BIQUAD_BANK_MAX_CHANNELS];
+    float y;
+    uint8_t s, ch;
+
+    memcpy(x, in, bank->channels * sizeof(float));
+
+    /* Each stage is applied to all the channels before the next one:
+     * the inner loop has no dependency between iterations. */
+    for (s = 0; s < bank->stages; s++) {
+        float *b0 = bank->b0[s], *b1 = bank->b1[s], *b2 = bank->b2[s];
+        float *a1 = bank->a1[s], *a2 = bank->a2[s];
+        float *z1 = bank->z1[s], *z2 = bank->z2[s];
+
+        for (ch = 0; ch < bank->channels; ch++) {
+            y = b0[ch] * x[ch] + z1[ch];
+            z1[ch] = b1[ch] * x[ch] - a1[ch] * y + z2[ch];
+            z2[ch] = b2[ch] * x[ch] - a2[ch] * y;
+            x[ch] = y;
+        }
+    }
+
+    memcpy(out, x, bank->channels * sizeof(float));
+}
@@ -0,0 +1,179 @@
+/** @file modules/filters/biquad.h
+ * @author CVRA
+ * @brief Second order IIR filters (biquads) and cascades of them.
+ *
+ * The filters are computed in direct form II transposed, which needs only
+ * two state variables and behaves well with floats. The coefficients are
+ * normalized so that a0 = 1:
+ *
+ * \f$ H(z) = \frac{b_0 + b_1 z^{-1} + b_2 z^{-2}}{1 + a_1 z^{-1} + a_2 z^{-2}} \f$
+ *
+ * The design functions (RBJ audio EQ cookbook formulas) use trigonometric
+ * functions, they are meant to be called at setup time only. The
+ * do_filter functions are compatible with the feedback and output filters
+ * of control_system_manager, for example to notch out a mechanical
+ * resonance:
+ * @code
+ * biquad_design_notch(&notch, 45., 1000., 2.);
+ * cs_set_feedback_filter(&distance_cs, biquad_do_filter, &notch);
+ * @endcode
+ *
+ * Higher order filters are made by cascading second order sections (SOS).
+ * When several axes are filtered at the same time, biquad_bank evaluates
+ * all of them with a structure of arrays layout, so the compiler can
+ * vectorize the loop over the channels.
+ */
+
+#ifndef _BIQUAD_H_
+#define _BIQUAD_H_
+
+#include <stdint.h>
+
+/** Maximal number of sections of a cascade. */
+#define BIQUAD_CASCADE_MAX_STAGES 4
+
+/** Maximal number of channels of a bank. */
+#define BIQUAD_BANK_MAX_CHANNELS 8
+
+/** A second order section. */
+struct biquad {
+    float b0, b1, b2;   /**< Numerator coefficients. */
+    float a1, a2;       /**< Denominator coefficients (a0 = 1). */
+    float z1, z2;       /**< State. */
+};
+
+/** Second order sections in series. */
+struct biquad_cascade {
+    struct biquad stages[BIQUAD_CASCADE_MAX_STAGES]; /**< The sections, in order. */
+    uint8_t n;          /**< Number of sections in use. */
+};
+
+/** Several channels filtered by cascades of the same length.
+ *
+ * The coefficients and states are stored stage by stage, then channel by
+ * channel, so the inner loop of biquad_bank_process() reads contiguous
+ * arrays.
+ */
+struct biquad_bank {
+    float b0[BIQUAD_CASCADE_MAX_STAGES][BIQUAD_BANK_MAX_CHANNELS];
+    float b1[BIQUAD_CASCADE_MAX_STAGES][BIQUAD_BANK_MAX_CHANNELS];
+    float b2[BIQUAD_CASCADE_MAX_STAGES][BIQUAD_BANK_MAX_CHANNELS];
+    float a1[BIQUAD_CASCADE_MAX_STAGES][BIQUAD_BANK_MAX_CHANNELS];
+    float a2[BIQUAD_CASCADE_MAX_STAGES][BIQUAD_BANK_MAX_CHANNELS];
+    float z1[BIQUAD_CASCADE_MAX_STAGES][BIQUAD_BANK_MAX_CHANNELS];
+    float z2[BIQUAD_CASCADE_MAX_STAGES][BIQUAD_BANK_MAX_CHANNELS];
+    uint8_t channels;   /**< Number of channels in use. */
+    uint8_t stages;     /**< Number of sections in use. */
+};
+
+/** @brief Initializes a biquad as a pass through filter.
+ * @param [in] b The biquad instance.
+ */
+void biquad_init(struct biquad *b);
+
+/** @brief Sets the state to zero, keeping the coefficients. */
+void biquad_reset(struct biquad *b);
+
+/** @brief Sets the coefficients directly.
+ *
+ * The coefficients must already be divided by a0.
+ */
+void biquad_set_coefs(struct biquad *b, float b0, float b1, float b2,
+                      float a1, float a2);
+
+/** @brief Designs a second order low pass filter.
+ * @param [in] b The biquad instance.
+ * @param [in] fc The cutoff frequency, in Hz.
+ * @param [in] fs The sampling frequency, in Hz.
+ * @param [in] q The quality factor, 0.7071 for a Butterworth response.
+ */
+void biquad_design_lowpass(struct biquad *b, float fc, float fs, float q);
+
+/** @brief Designs a second order high pass filter.
+ * @param [in] b The biquad instance.
+ * @param [in] fc The cutoff frequency, in Hz.
+ * @param [in] fs The sampling frequency, in Hz.
+ * @param [in] q The quality factor, 0.7071 for a Butterworth response.
+ */
+void biquad_design_highpass(struct biquad *b, float fc, float fs, float q);
+
+/** @brief Designs a notch filter.
+ * @param [in] b The biquad instance.
+ * @param [in] f0 The rejected frequency, in Hz.
+ * @param [in] fs The sampling frequency, in Hz.
+ * @param [in] q The quality factor: f0 divided by the width of the notch.
+ */
+void biquad_design_notch(struct biquad *b, float f0, float fs, float q);
+
+/** @brief Designs a first order low pass filter, stored as a biquad.
+ *
+ * This is used for the odd orders of Butterworth cascades.
+ */
+void biquad_design_lowpass_1st_order(struct biquad *b, float fc, float fs);
+
+/** @brief Filters a sample.
+ *
+ * \param [in] data A pointer to a biquad instance, casted to void *.
+ * \param [in] in The input of the filter.
+ * @returns The output of the filter.
+ */
+float biquad_do_filter(void *data, float in);
+
+/** @brief Initializes an empty cascade (pass through). */
+void biquad_cascade_init(struct biquad_cascade *c);
+
+/** @brief Sets the state of all sections to zero. */
+void biquad_cascade_reset(struct biquad_cascade *c);
+
+/** @brief Adds a section at the end of the cascade.
+ * @returns The new section, initialized as a pass through, or NULL if the
+ * cascade is full.
+ */
+struct biquad *biquad_cascade_add_stage(struct biquad_cascade *c);
+
+/** @brief Designs a Butterworth low pass filter of any order.
+ *
+ * Replaces the sections of the cascade by (order + 1) / 2 sections.
+ * @param [in] c The cascade instance.
+ * @param [in] order The order of the filter, at most
+ * 2 * BIQUAD_CASCADE_MAX_STAGES.
+ * @param [in] fc The cutoff frequency, in Hz.
+ * @param [in] fs The sampling frequency, in Hz.
+ */
+void biquad_cascade_design_butterworth(struct biquad_cascade *c, uint8_t order,
+                                       float fc, float fs);
+
+/** @brief Filters a sample through all the sections.
+ *
+ * \param [in] data A pointer to a biquad_cascade instance, casted to void *.
+ * \param [in] in The input of the filter.
+ * @returns The output of the filter.
+ */
+float biquad_cascade_do_filter(void *data, float in);
+
+/** @brief Initializes a bank of pass through filters.
+ * @param [in] bank The bank instance.
+ * @param [in] channels Number of channels, at most BIQUAD_BANK_MAX_CHANNELS.
+ * @param [in] stages Number of sections per channel, at most
+ * BIQUAD_CASCADE_MAX_STAGES.
+ */
+void biquad_bank_init(struct biquad_bank *bank, uint8_t channels, uint8_t stages);
+
+/** @brief Sets the state of all channels to zero. */
+void biquad_bank_reset(struct biquad_bank *bank);
+
+/** @brief Copies the coefficients of a cascade to a channel.
+ *
+ * Missing sections are set as pass through.
+ */
+void biquad_bank_set_channel(struct biquad_bank *bank, uint8_t channel,
+                             const struct biquad_cascade *c);
+
+/** @brief Filters one sample of every channel.
+ * @param [in] bank The bank instance.
+ * @param [in] in The inputs, one per channel.
+ * @param [out] out The outputs, one per channel. Can be the same as in.
+ */
+void biquad_bank_process(struct biquad_bank *bank, const float *in, float *out);
+
+#endif
@@ -0,0 +1,39 @@
+#include <math.h>
+#include <lowpass.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+void lowpass_init(struct lowpass *lp) {
+    lowpass_set_alpha(lp, 1.);
+    lowpass_reset(lp);
+}
+
+void lowpass_reset(struct lowpass *lp) {
+    lp->out = 0.;
+    lp->started = 0;
+}
+
+void lowpass_set_cutoff(struct lowpass *lp, float fc, float fs) {
+    lowpass_set_alpha(lp, 1. - expf(-2. * M_PI * fc / fs));
+}
+
+void lowpass_set_alpha(struct lowpass *lp, float alpha) {
+    lp->alpha = alpha;
+}
+
+float lowpass_do_filter(void *data, float in) {
+    struct lowpass *lp = data;
+
+    /* Start from the first sample instead of 0 to avoid a slow rise. */
+    if (!lp->started) {
+        lp->out = in;
+        lp->started = 1;
+    }
+    else {
+        lp->out += lp->alpha * (in - lp->out);
+    }
+
+    return lp->out;
+}
@@ -0,0 +1,51 @@
+/** @file modules/filters/lowpass.h
+ * @author CVRA
+ * @brief First order low pass filter.
+ *
+ * Exponential smoothing: y += alpha * (x - y). It is the cheapest way to
+ * remove the noise of a measure, at the cost of some phase lag.
+ */
+
+#ifndef _LOWPASS_H_
+#define _LOWPASS_H_
+
+#include <stdint.h>
+
+/** A first order low pass filter. */
+struct lowpass {
+    float alpha;        /**< Smoothing factor, 1 to disable the filter. */
+    float out;          /**< Previous output. */
+    uint8_t started;    /**< 0 until the first sample, which sets the output. */
+};
+
+/** @brief Initializes the filter as a pass through.
+ * @param [in] lp The lowpass instance.
+ */
+void lowpass_init(struct lowpass *lp);
+
+/** @brief Restarts the filter from the next sample. */
+void lowpass_reset(struct lowpass *lp);
+
+/** @brief Sets the cutoff frequency.
+ * @param [in] lp The lowpass instance.
+ * @param [in] fc The cutoff frequency, in Hz.
+ * @param [in] fs The sampling frequency, in Hz.
+ */
+void lowpass_set_cutoff(struct lowpass *lp, float fc, float fs);
+
+/** @brief Sets the smoothing factor directly.
+ * @param [in] lp The lowpass instance.
+ * @param [in] alpha The smoothing factor, between 0 (output never changes)
+ * and 1 (no filtering).
+ */
+void lowpass_set_alpha(struct lowpass *lp, float alpha);
+
+/** @brief Filters a sample.
+ *
+ * \param [in] data A pointer to a lowpass instance, casted to void *.
+ * \param [in] in The input of the filter.
+ * @returns The output of the filter.
+ */
+float lowpass_do_filter(void *data, float in);
+
+#endif
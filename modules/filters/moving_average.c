@@ -0,0 +1,43 @@
+#include <moving_average.h>
+
+void moving_average_init(struct moving_average *ma, uint8_t size) {
+    if (size < 1)
+        size = 1;
+    if (size > MOVING_AVERAGE_MAX_SIZE)
+        size = MOVING_AVERAGE_MAX_SIZE;
+
+    ma->size = size;
+    moving_average_reset(ma);
+}
+
+void moving_average_reset(struct moving_average *ma) {
+    ma->sum = 0.;
+    ma->count = 0;
+    ma->index = 0;
+}
+
+float moving_average_do_filter(void *data, float in) {
+    struct moving_average *ma = data;
+    uint8_t i;
+
+    if (ma->count < ma->size)
+        ma->count++;
+    else
+        ma->sum -= ma->samples[ma->index];
+
+    ma->samples[ma->index] = in;
+    ma->sum += in;
+
+    ma->index++;
+    if (ma->index >= ma->size) {
+        ma->index = 0;
+
+        /* Recompute the sum once per turn so rounding errors do not
+         * accumulate. */
+        ma->sum = 0.;
+        for (i = 0; i < ma->count; i++)
+            ma->sum += ma->samples[i];
+    }
+
+    return ma->sum / ma->count;
+}
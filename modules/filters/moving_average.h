@@ -0,0 +1,48 @@
+/** @file modules/filters/moving_average.h
+ * @author CVRA
+ * @brief Moving average filter.
+ *
+ * Average of the last N samples, computed in constant time with a running
+ * sum. It completely removes any periodic noise whose period is N samples
+ * (or a divisor of it), for example the ripple of an encoder.
+ */
+
+#ifndef _MOVING_AVERAGE_H_
+#define _MOVING_AVERAGE_H_
+
+#include <stdint.h>
+
+/** Maximal number of averaged samples. */
+#define MOVING_AVERAGE_MAX_SIZE 32
+
+/** A moving average filter. */
+struct moving_average {
+    float samples[MOVING_AVERAGE_MAX_SIZE]; /**< Last samples (circular buffer). */
+    float sum;          /**< Sum of the samples in the buffer. */
+    uint8_t size;       /**< Number of averaged samples. */
+    uint8_t count;      /**< Number of samples in the buffer. */
+    uint8_t index;      /**< Position of the next sample in the buffer. */
+};
+
+/** @brief Initializes the filter.
+ * @param [in] ma The moving_average instance.
+ * @param [in] size Number of averaged samples, between 1 and
+ * MOVING_AVERAGE_MAX_SIZE.
+ */
+void moving_average_init(struct moving_average *ma, uint8_t size);
+
+/** @brief Empties the buffer. */
+void moving_average_reset(struct moving_average *ma);
+
+/** @brief Filters a sample.
+ *
+ * Until the buffer is full, the average of the samples received so far
+ * is returned.
+ *
+ * \param [in] data A pointer to a moving_average instance, casted to void *.
+ * \param [in] in The input of the filter.
+ * @returns The output of the filter.
+ */
+float moving_average_do_filter(void *data, float in);
+
+#endif
@@ -0,0 +1,465 @@
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <lidar_obstacles.h>
+
+#define HULL_START LIDAR_OBSTACLES_MAX_CLUSTER_PTS
+
+void lidar_obstacles_init(struct lidar_obstacles *lo, uint8_t max_tracks) {
+    uint8_t i;
+
+    memset(lo, 0, sizeof(struct lidar_obstacles));
+
+    lo->range_min = 50.;
+    lo->range_max = 4000.;
+    lo->x1 = 0;
+    lo->y1 = 0;
+    lo->x2 = 3000;
+    lo->y2 = 2000;
+    lo->cluster_gap = 60.;
+    lo->min_points = 3;
+    lo->circle_rmin = 20.;
+    lo->circle_rmax = 250.;
+    lo->circle_tolerance = 10.;
+    lo->inflate = 0.;
+    lo->match_dist = 300.;
+    lo->confirm_hits = 2;
+    lo->max_missed = 3;
+
+    if (max_tracks > LIDAR_OBSTACLES_MAX_TRACKS)
+        max_tracks = LIDAR_OBSTACLES_MAX_TRACKS;
+
+    for (i = 0; i < max_tracks; i++) {
+        lo->tracks[i].poly = oa_new_poly(LIDAR_OBSTACLES_POLY_PTS);
+        if (lo->tracks[i].poly == NULL)
+            break;
+        /* an empty polygon is not an obstacle */
+        oa_poly_remove(lo->tracks[i].poly);
+        lo->track_n++;
+    }
+}
+
+void lidar_obstacles_set_range(struct lidar_obstacles *lo, float min, float max) {
+    lo->range_min = min;
+    lo->range_max = max;
+}
+
+void lidar_obstacles_set_area(struct lidar_obstacles *lo,
+                              int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    lo->x1 = x1;
+    lo->y1 = y1;
+    lo->x2 = x2;
+    lo->y2 = y2;
+}
+
+void lidar_obstacles_set_clustering(struct lidar_obstacles *lo, float gap, uint8_t min_points) {
+    lo->cluster_gap = gap;
+    lo->min_points = min_points;
+}
+
+void lidar_obstacles_set_circle_fit(struct lidar_obstacles *lo,
+                                    float rmin, float rmax, float tolerance) {
+    lo->circle_rmin = rmin;
+    lo->circle_rmax = rmax;
+    lo->circle_tolerance = tolerance;
+}
+
+void lidar_obstacles_set_inflate(struct lidar_obstacles *lo, float margin) {
+    lo->inflate = margin;
+}
+
+void lidar_obstacles_set_tracking(struct lidar_obstacles *lo, float match_dist,
+                                  uint8_t confirm_hits, uint8_t max_missed) {
+    lo->match_dist = match_dist;
+    lo->confirm_hits = confirm_hits;
+    lo->max_missed = max_missed;
+}
+
+/** Converts a measure to table coordinates. Returns 0 if the measure
+ * must be ignored. */
+static uint8_t lidar_to_table(struct lidar_obstacles *lo, const struct lidar_point *m,
+                              float x, float y, float a, point_t *p) {
+    if (m->range < lo->range_min || m->range > lo->range_max)
+        return 0;
+
+    p->x = x + m->range * cosf(a + m->angle);
+    p->y = y + m->range * sinf(a + m->angle);
+
+    if (p->x < lo->x1 || p->x > lo->x2 || p->y < lo->y1 || p->y > lo->y2)
+        return 0;
+
+    return 1;
+}
+
+/** Returns 1 if two consecutive points belong to different clusters. */
+static uint8_t lidar_is_gap(struct lidar_obstacles *lo, const point_t *p, const point_t *q) {
+    float dx = q->x - p->x, dy = q->y - p->y;
+    return dx * dx + dy * dy > lo->cluster_gap * lo->cluster_gap;
+}
+
+/** > 0 if c is on the left of (a, b). */
+static float lidar_orient(const point_t *a, const point_t *b, const point_t *c) {
+    return (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+}
+
+static float lidar_dist2(const point_t *a, const point_t *b) {
+    return (b->x - a->x) * (b->x - a->x) + (b->y - a->y) * (b->y - a->y);
+}
+
+/** Adds a point to the convex hull of the cluster.
+ *
+ * Consecutive scan points form a simple polyline, so Melkman's algorithm
+ * gives the hull in linear time. The hull is stored in a deque, hull[bot]
+ * and hull[top] are both the last point added to it.
+ */
+static void lidar_hull_add(struct lidar_cluster *c, const point_t *p) {
+    point_t *h = c->hull;
+
+    /* wait for 3 points which are not aligned, keeping the ends of the
+     * segment in h[0] and h[1] */
+    if (c->hull_n < 2) {
+        h[c->hull_n++] = *p;
+        return;
+    }
+    if (c->hull_n == 2) {
+        float o = lidar_orient(&h[0], &h[1], p);
+
+        if (o == 0) {
+            float d01 = lidar_dist2(&h[0], &h[1]);
+            if (lidar_dist2(&h[0], p) > d01 && lidar_dist2(&h[0], p) >= lidar_dist2(&h[1], p))
+                h[1] = *p;
+            else if (lidar_dist2(&h[1], p) > d01)
+                h[0] = *p;
+            return;
+        }
+
+        c->bot = HULL_START;
+        c->top = HULL_START + 3;
+        h[c->bot] = *p;
+        h[c->top] = *p;
+        if (o > 0) {
+            h[c->bot + 1] = h[0];
+            h[c->bot + 2] = h[1];
+        } else {
+            h[c->bot + 1] = h[1];
+            h[c->bot + 2] = h[0];
+        }
+        c->hull_n = 3;
+        return;
+    }
+
+    /* inside the hull */
+    if (lidar_orient(&h[c->bot], &h[c->bot + 1], p) > 0 &&
+        lidar_orient(&h[c->top - 1], &h[c->top], p) > 0)
+        return;
+
+    while (lidar_orient(&h[c->top - 1], &h[c->top], p) <= 0)
+        c->top--;
+    h[++c->top] = *p;
+
+    while (lidar_orient(p, &h[c->bot], &h[c->bot + 1]) <= 0)
+        c->bot++;
+    h[--c->bot] = *p;
+}
+
+static void lidar_cluster_add(struct lidar_cluster *c, const point_t *p) {
+    double u, v;
+
+    if (c->n == 0) {
+        memset(c, 0, offsetof(struct lidar_cluster, hull));
+        c->first = *p;
+    }
+
+    u = p->x - c->first.x;
+    v = p->y - c->first.y;
+
+    c->su += u;
+    c->sv += v;
+    c->suu += u * u;
+    c->svv += v * v;
+    c->suv += u * v;
+    c->suuu += u * u * u;
+    c->svvv += v * v * v;
+    c->suuv += u * u * v;
+    c->suvv += u * v * v;
+    c->suuuu += u * u * u * u;
+    c->svvvv += v * v * v * v;
+    c->suuvv += u * u * v * v;
+
+    lidar_hull_add(c, p);
+
+    c->last = *p;
+    c->n++;
+}
+
+/** Least squares circle fit (Kasa's method) from the moments of the
+ * cluster. Returns 1 if the points are on a circle of acceptable radius,
+ * on the far side of the circle as seen from the sensor (sx, sy). */
+static uint8_t lidar_fit_circle(struct lidar_obstacles *lo, struct lidar_cluster *c,
+                                float sx, float sy, struct lidar_shape *s) {
+    double n = c->n;
+    double su = c->su, sv = c->sv, suu = c->suu, svv = c->svv, suv = c->suv;
+    double bu = -(c->suuu + c->suvv), bv = -(c->suuv + c->svvv), bz = -(suu + svv);
+    double det, d, e, f, cu, cv, r2, r, res, rms;
+    double mx, my;
+
+    if (c->n < 5 || c->hull_n < 3)
+        return 0;
+
+    /* Solves [suu suv su; suv svv sv; su sv n] [d e f]' = [bu bv bz]'
+     * for the circle u^2 + v^2 + d.u + e.v + f = 0 */
+    det = suu * (svv * n - sv * sv) - suv * (suv * n - sv * su) + su * (suv * sv - svv * su);
+    if (fabs(det) < 1e-9 * suu * svv * n)
+        return 0;
+
+    d = (bu * (svv * n - sv * sv) - suv * (bv * n - sv * bz) + su * (bv * sv - svv * bz)) / det;
+    e = (suu * (bv * n - sv * bz) - bu * (suv * n - sv * su) + su * (suv * bz - bv * su)) / det;
+    f = (suu * (svv * bz - bv * sv) - suv * (suv * bz - bv * su) + bu * (suv * sv - svv * su)) / det;
+
+    cu = -d / 2.;
+    cv = -e / 2.;
+    r2 = cu * cu + cv * cv - f;
+    if (r2 <= 0)
+        return 0;
+    r = sqrt(r2);
+    if (r < lo->circle_rmin || r > lo->circle_rmax)
+        return 0;
+
+    /* sum of (u^2 + v^2 + d.u + e.v + f)^2, which is about
+     * (2.r.distance)^2 for each point */
+    res = c->suuuu + 2 * c->suuvv + c->svvvv
+        + d * d * suu + e * e * svv + n * f * f
+        + 2 * d * (c->suuu + c->suvv) + 2 * e * (c->suuv + c->svvv) + 2 * f * (suu + svv)
+        + 2 * d * e * suv + 2 * d * f * su + 2 * e * f * sv;
+    if (res < 0)
+        res = 0;
+    rms = sqrt(res / n) / (2 * r);
+    if (rms > lo->circle_tolerance)
+        return 0;
+
+    /* the sensor sees the front of the obstacle, so the center is behind
+     * the points */
+    mx = c->first.x + su / n;
+    my = c->first.y + sv / n;
+    if ((c->first.x + cu - sx) * (c->first.x + cu - sx) + (c->first.y + cv - sy) * (c->first.y + cv - sy) <
+        (mx - sx) * (mx - sx) + (my - sy) * (my - sy))
+        return 0;
+
+    s->type = LIDAR_SHAPE_CIRCLE;
+    s->x = c->first.x + cu;
+    s->y = c->first.y + cv;
+    s->r = r + lo->inflate;
+    return 1;
+}
+
+/** Rectangle enclosing the hull, aligned on the principal axis of the
+ * points and grown by the margin. */
+static void lidar_fit_rect(struct lidar_obstacles *lo, struct lidar_cluster *c,
+                           struct lidar_shape *s) {
+    double n = c->n;
+    double mu = c->su / n, mv = c->sv / n;
+    double cuu = c->suu / n - mu * mu;
+    double cvv = c->svv / n - mv * mv;
+    double cuv = c->suv / n - mu * mv;
+    float th = 0.5 * atan2(2 * cuv, cuu - cvv);
+    float ex = cosf(th), ey = sinf(th);
+    float smin = 0, smax = 0, tmin = 0, tmax = 0, ps, pt, u, v;
+    uint16_t i, from, to;
+
+    if (c->hull_n == 3) {
+        from = c->bot;
+        to = c->top;
+    } else {
+        from = 0;
+        to = c->hull_n;
+    }
+
+    for (i = from; i < to; i++) {
+        u = c->hull[i].x - c->first.x;
+        v = c->hull[i].y - c->first.y;
+        ps = u * ex + v * ey;
+        pt = -u * ey + v * ex;
+        if (i == from || ps < smin) smin = ps;
+        if (i == from || ps > smax) smax = ps;
+        if (i == from || pt < tmin) tmin = pt;
+        if (i == from || pt > tmax) tmax = pt;
+    }
+
+    smin -= lo->inflate;
+    smax += lo->inflate;
+    tmin -= lo->inflate;
+    tmax += lo->inflate;
+
+    s->type = LIDAR_SHAPE_RECT;
+    s->corners[0].x = c->first.x + smin * ex - tmin * ey;
+    s->corners[0].y = c->first.y + smin * ey + tmin * ex;
+    s->corners[1].x = c->first.x + smax * ex - tmin * ey;
+    s->corners[1].y = c->first.y + smax * ey + tmin * ex;
+    s->corners[2].x = c->first.x + smax * ex - tmax * ey;
+    s->corners[2].y = c->first.y + smax * ey + tmax * ex;
+    s->corners[3].x = c->first.x + smin * ex - tmax * ey;
+    s->corners[3].y = c->first.y + smin * ey + tmax * ex;
+    s->x = c->first.x + (smin + smax) / 2 * ex - (tmin + tmax) / 2 * ey;
+    s->y = c->first.y + (smin + smax) / 2 * ey + (tmin + tmax) / 2 * ex;
+    s->r = 0;
+}
+
+/** Ends the current cluster and stores its shape. */
+static void lidar_close_cluster(struct lidar_obstacles *lo, float sx, float sy) {
+    struct lidar_shape *s;
+
+    if (lo->cur.n > 0 && lo->cur.n >= lo->min_points && lo->cluster_n < LIDAR_OBSTACLES_MAX_CLUSTERS) {
+        s = &lo->clusters[lo->cluster_n++];
+        if (!lidar_fit_circle(lo, &lo->cur, sx, sy, s))
+            lidar_fit_rect(lo, &lo->cur, s);
+    }
+    lo->cur.n = 0;
+}
+
+/** Writes the shape of a track in its obstacle avoidance polygon. */
+static void lidar_publish_track(struct lidar_track *t) {
+    uint8_t i;
+    float r, a;
+
+    if (t->shape.type == LIDAR_SHAPE_CIRCLE) {
+        /* polygon around the circle */
+        r = t->shape.r / cosf(M_PI / LIDAR_OBSTACLES_POLY_PTS);
+        t->poly->l = LIDAR_OBSTACLES_POLY_PTS;
+        for (i = 0; i < LIDAR_OBSTACLES_POLY_PTS; i++) {
+            a = 2 * M_PI * i / LIDAR_OBSTACLES_POLY_PTS;
+            oa_poly_set_point(t->poly, t->shape.x + r * cosf(a), t->shape.y + r * sinf(a), i);
+        }
+    } else {
+        t->poly->l = 4;
+        for (i = 0; i < 4; i++)
+            oa_poly_set_point(t->poly, t->shape.corners[i].x, t->shape.corners[i].y, i);
+    }
+}
+
+/** Matches the clusters of the scan with the tracked obstacles and
+ * updates the obstacle avoidance polygons. */
+static void lidar_update_tracks(struct lidar_obstacles *lo) {
+    uint8_t cluster_used[LIDAR_OBSTACLES_MAX_CLUSTERS];
+    uint8_t track_matched[LIDAR_OBSTACLES_MAX_TRACKS];
+    struct lidar_track *t;
+    struct lidar_shape *s;
+    uint8_t i, j;
+    int8_t bt, bc;
+    float best, d2, dx, dy;
+
+    memset(cluster_used, 0, sizeof(cluster_used));
+    memset(track_matched, 0, sizeof(track_matched));
+
+    /* greedy nearest neighbour matching, the closest pairs first */
+    while (1) {
+        best = lo->match_dist * lo->match_dist;
+        bt = -1;
+        bc = -1;
+        for (i = 0; i < lo->track_n; i++) {
+            t = &lo->tracks[i];
+            if (!t->used || track_matched[i])
+                continue;
+            for (j = 0; j < lo->cluster_n; j++) {
+                if (cluster_used[j])
+                    continue;
+                dx = lo->clusters[j].x - (t->shape.x + t->vx);
+                dy = lo->clusters[j].y - (t->shape.y + t->vy);
+                d2 = dx * dx + dy * dy;
+                if (d2 < best) {
+                    best = d2;
+                    bt = i;
+                    bc = j;
+                }
+            }
+        }
+        if (bt < 0)
+            break;
+
+        t = &lo->tracks[bt];
+        s = &lo->clusters[bc];
+        t->vx = (t->vx + (s->x - t->shape.x)) / 2;
+        t->vy = (t->vy + (s->y - t->shape.y)) / 2;
+        t->shape = *s;
+        t->missed = 0;
+        if (t->hits < 255)
+            t->hits++;
+        track_matched[bt] = 1;
+        cluster_used[bc] = 1;
+    }
+
+    /* forget the obstacles we did not see for too long */
+    for (i = 0; i < lo->track_n; i++) {
+        t = &lo->tracks[i];
+        if (!t->used || track_matched[i])
+            continue;
+        if (++t->missed > lo->max_missed)
+            t->used = 0;
+    }
+
+    /* new obstacles */
+    for (j = 0; j < lo->cluster_n; j++) {
+        if (cluster_used[j])
+            continue;
+        for (i = 0; i < lo->track_n && lo->tracks[i].used; i++);
+        if (i == lo->track_n)
+            break;
+        t = &lo->tracks[i];
+        t->used = 1;
+        t->hits = 1;
+        t->missed = 0;
+        t->vx = 0;
+        t->vy = 0;
+        t->shape = lo->clusters[j];
+    }
+
+    for (i = 0; i < lo->track_n; i++) {
+        t = &lo->tracks[i];
+        if (t->used && t->hits >= lo->confirm_hits)
+            lidar_publish_track(t);
+        else if (t->poly->l != 0)
+            oa_poly_remove(t->poly);
+    }
+}
+
+void lidar_obstacles_process_scan(struct lidar_obstacles *lo,
+                                  const struct lidar_point *scan, uint16_t n,
+                                  float x, float y, float a) {
+    uint16_t i, k, start = 0;
+    uint8_t valid, prev_valid;
+    point_t p, prev;
+
+    lo->cluster_n = 0;
+    lo->cur.n = 0;
+
+    if (n > 0) {
+        /* Start on a cluster boundary, so an obstacle seen at both ends
+         * of a full turn scan is not split in two. */
+        prev_valid = lidar_to_table(lo, &scan[n - 1], x, y, a, &prev);
+        for (i = 0; i < n; i++) {
+            valid = lidar_to_table(lo, &scan[i], x, y, a, &p);
+            if (!valid || !prev_valid || lidar_is_gap(lo, &prev, &p)) {
+                start = i;
+                break;
+            }
+            prev = p;
+        }
+    }
+
+    for (k = 0; k < n; k++) {
+        i = ((uint32_t)start + k) % n;
+
+        if (!lidar_to_table(lo, &scan[i], x, y, a, &p)) {
+            lidar_close_cluster(lo, x, y);
+            continue;
+        }
+
+        if (lo->cur.n > 0 && (lidar_is_gap(lo, &lo->cur.last, &p) ||
+                              lo->cur.n == LIDAR_OBSTACLES_MAX_CLUSTER_PTS))
+            lidar_close_cluster(lo, x, y);
+
+        lidar_cluster_add(&lo->cur, &p);
+    }
+    lidar_close_cluster(lo, x, y);
+
+    lidar_update_tracks(lo);
+}
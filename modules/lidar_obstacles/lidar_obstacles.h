@@ -0,0 +1,189 @@
+/** @file modules/lidar_obstacles/lidar_obstacles.h
+ * @author CVRA
+ * @brief Obstacle detection from 2D laser scans.
+ *
+ * This module turns a raw scan (an array of angle / range measures) into
+ * obstacle polygons for the obstacle_avoidance module. Each scan is
+ * processed in a single pass:
+ *  - The points are converted to table coordinates and split into
+ *    clusters where two consecutive points are too far from each other.
+ *  - For each cluster, a circle is fitted (least squares). If the points
+ *    are not on a circle of plausible radius, the cluster is represented
+ *    by a rectangle enclosing its convex hull instead.
+ *  - Clusters are matched with the obstacles seen in the previous scans,
+ *    so each tracked obstacle keeps its own polygon in the obstacle
+ *    avoidance, which is only rewritten when the obstacle is seen.
+ *
+ * Usage:
+ * @code
+ * oa_init();
+ * ... add static obstacles ...
+ * lidar_obstacles_init(&lidar, 4);
+ * lidar_obstacles_set_area(&lidar, 0, 0, 3000, 2000);
+ *
+ * // for each scan
+ * lidar_obstacles_process_scan(&lidar, scan, n, x, y, a);
+ * @endcode
+ *
+ * @note The polygons are reserved in the obstacle avoidance module by
+ * lidar_obstacles_init(), so it must be called again after oa_init().
+ */
+
+#ifndef _LIDAR_OBSTACLES_H_
+#define _LIDAR_OBSTACLES_H_
+
+#include <aversive.h>
+#include <obstacle_avoidance.h>
+
+/** Maximal number of tracked obstacles. */
+#define LIDAR_OBSTACLES_MAX_TRACKS 8
+
+/** Maximal number of clusters in a scan. */
+#define LIDAR_OBSTACLES_MAX_CLUSTERS 32
+
+/** Maximal number of points in a cluster. Longer clusters are split. */
+#define LIDAR_OBSTACLES_MAX_CLUSTER_PTS 64
+
+/** Number of vertices of the polygon approximating a circle. */
+#define LIDAR_OBSTACLES_POLY_PTS 8
+
+#define LIDAR_SHAPE_CIRCLE 0 /**< The obstacle is a circle. */
+#define LIDAR_SHAPE_RECT 1   /**< The obstacle is a rectangle. */
+
+/** A single measure of the scan. */
+struct lidar_point {
+    float angle; /**< Angle of the measure relative to the sensor, in radians. */
+    float range; /**< Measured distance, in mm. */
+};
+
+/** Shape of an obstacle, in table coordinates. */
+struct lidar_shape {
+    uint8_t type;         /**< LIDAR_SHAPE_CIRCLE or LIDAR_SHAPE_RECT. */
+    float x, y;           /**< Center, in mm. */
+    float r;              /**< Radius of a circle, in mm. */
+    point_t corners[4];   /**< Corners of a rectangle, counter clockwise. */
+};
+
+/** An obstacle tracked across scans. */
+struct lidar_track {
+    uint8_t used;         /**< 1 if this track follows an obstacle. */
+    uint8_t hits;         /**< Number of scans where the obstacle was seen. */
+    uint8_t missed;       /**< Number of consecutive scans without it. */
+    float vx, vy;         /**< Estimated displacement between two scans, in mm. */
+    struct lidar_shape shape; /**< Last measured shape, grown by the margin. */
+    poly_t *poly;         /**< Polygon reserved in the obstacle avoidance. */
+};
+
+/** Points of the cluster being built. */
+struct lidar_cluster {
+    uint16_t n;           /**< Number of points. */
+    point_t first;        /**< First point, origin of the sums below. */
+    point_t last;         /**< Last point, to detect gaps. */
+
+    /** Moments of the points relative to first, for the circle fit. */
+    double su, sv, suu, svv, suv;
+    double suuu, svvv, suuv, suvv;
+    double suuuu, svvvv, suuvv;
+
+    /** Number of points in the hull: 0 to 2 while the points are
+     * aligned (stored in hull[0] and hull[1]), 3 once it is a polygon. */
+    uint8_t hull_n;
+
+    /** Convex hull (Melkman's algorithm), points hull[bot] to hull[top]. */
+    point_t hull[2 * LIDAR_OBSTACLES_MAX_CLUSTER_PTS + 2];
+    uint16_t bot, top;
+};
+
+/** Instance of the lidar obstacle detection. */
+struct lidar_obstacles {
+    struct lidar_track tracks[LIDAR_OBSTACLES_MAX_TRACKS]; /**< Tracked obstacles. */
+    uint8_t track_n;      /**< Number of tracks with a reserved polygon. */
+
+    struct lidar_shape clusters[LIDAR_OBSTACLES_MAX_CLUSTERS]; /**< Clusters of the current scan. */
+    uint8_t cluster_n;    /**< Number of clusters in the current scan. */
+    struct lidar_cluster cur; /**< Cluster being built. */
+
+    float range_min, range_max; /**< Valid measures, in mm. */
+    int32_t x1, y1, x2, y2; /**< Area where points are kept, in mm. */
+    float cluster_gap;    /**< Maximal distance between two points of a cluster, in mm. */
+    uint8_t min_points;   /**< Minimal number of points of a cluster. */
+    float circle_rmin, circle_rmax; /**< Radii accepted by the circle fit, in mm. */
+    float circle_tolerance; /**< Maximal RMS distance of the points to the circle, in mm. */
+    float inflate;        /**< Margin added around obstacles, in mm. */
+    float match_dist;     /**< Maximal distance between a track and its cluster, in mm. */
+    uint8_t confirm_hits; /**< Number of scans before an obstacle is given to the obstacle avoidance. */
+    uint8_t max_missed;   /**< Number of scans before an unseen obstacle is removed. */
+};
+
+/** Initializes the module and reserves its polygons.
+ *
+ * Reserves one polygon of LIDAR_OBSTACLES_POLY_PTS points per track in
+ * the obstacle avoidance. Unused polygons have no points.
+ *
+ * @param [in] lo The lidar_obstacles instance.
+ * @param [in] max_tracks Number of obstacles to track (at most
+ * LIDAR_OBSTACLES_MAX_TRACKS). Fewer are reserved if the obstacle
+ * avoidance is full, see lo->track_n.
+ */
+void lidar_obstacles_init(struct lidar_obstacles *lo, uint8_t max_tracks);
+
+/** Sets the range of valid measures.
+ * @param [in] min, max Measures outside [min, max] are ignored, in mm.
+ */
+void lidar_obstacles_set_range(struct lidar_obstacles *lo, float min, float max);
+
+/** Sets the area where obstacles are searched.
+ *
+ * Points outside of this rectangle (the table borders, the audience...)
+ * are ignored.
+ * @param [in] x1, y1 Bottom-left corner, in mm.
+ * @param [in] x2, y2 Top-right corner, in mm.
+ */
+void lidar_obstacles_set_area(struct lidar_obstacles *lo,
+                              int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+
+/** Sets the clustering parameters.
+ * @param [in] gap Two consecutive points further than gap belong to
+ * different clusters, in mm.
+ * @param [in] min_points Smaller clusters are considered as noise.
+ */
+void lidar_obstacles_set_clustering(struct lidar_obstacles *lo, float gap, uint8_t min_points);
+
+/** Sets the circle fit parameters.
+ *
+ * A cluster is a circle if the fitted radius is in [rmin, rmax] and the
+ * RMS distance of its points to the circle is below tolerance.
+ * Otherwise it is represented by a rectangle.
+ */
+void lidar_obstacles_set_circle_fit(struct lidar_obstacles *lo,
+                                    float rmin, float rmax, float tolerance);
+
+/** Sets the margin added around obstacles (usually the robot radius), in mm. */
+void lidar_obstacles_set_inflate(struct lidar_obstacles *lo, float margin);
+
+/** Sets the tracking parameters.
+ * @param [in] match_dist Maximal distance between the predicted position
+ * of an obstacle and a cluster to match them, in mm.
+ * @param [in] confirm_hits Number of scans an obstacle must be seen in
+ * before it is given to the obstacle avoidance.
+ * @param [in] max_missed Number of consecutive scans without seeing an
+ * obstacle before it is removed.
+ */
+void lidar_obstacles_set_tracking(struct lidar_obstacles *lo, float match_dist,
+                                  uint8_t confirm_hits, uint8_t max_missed);
+
+/** Processes a scan and updates the obstacle avoidance polygons.
+ *
+ * The processing time is linear in the number of points.
+ *
+ * @param [in] lo The lidar_obstacles instance.
+ * @param [in] scan The measures, sorted by angle.
+ * @param [in] n Number of measures.
+ * @param [in] x, y Position of the sensor on the table, in mm.
+ * @param [in] a Orientation of the sensor on the table, in radians.
+ */
+void lidar_obstacles_process_scan(struct lidar_obstacles *lo,
+                                  const struct lidar_point *scan, uint16_t n,
+                                  float x, float y, float a);
+
+#endif
@@ -0,0 +1,97 @@
+#include <string.h>
+#include <lqr.h>
+
+void lqr_init(struct lqr *l, uint8_t n, uint8_t m) {
+    memset(l, 0, sizeof(struct lqr));
+
+    if (n > LQR_MAX_STATES)
+        n = LQR_MAX_STATES;
+    if (m > LQR_MAX_INPUTS)
+        m = LQR_MAX_INPUTS;
+
+    l->n = n;
+    l->m = m;
+}
+
+void lqr_set_gains(struct lqr *l, const float *k) {
+    uint8_t i, j;
+
+    for (i = 0; i < l->m; i++)
+        for (j = 0; j < l->n; j++)
+            l->k[i][j] = k[i * l->n + j];
+}
+
+void lqr_set_max_output(struct lqr *l, float max_out) {
+    l->max_out = max_out;
+}
+
+void lqr_compute(struct lqr *l, const float *x, float *u) {
+    uint8_t i, j;
+    float sum;
+
+    for (i = 0; i < l->m; i++) {
+        sum = 0.;
+        for (j = 0; j < l->n; j++)
+            sum -= l->k[i][j] * x[j];
+
+        if (l->max_out > 0.) {
+            if (sum > l->max_out)
+                sum = l->max_out;
+            else if (sum < -l->max_out)
+                sum = -l->max_out;
+        }
+
+        u[i] = sum;
+    }
+}
+
+void lqr_2wheels_init(struct lqr_2wheels *l) {
+    lqr_init(&l->lqr, 4, 2);
+    lqr_2wheels_reset(l);
+}
+
+void lqr_2wheels_reset(struct lqr_2wheels *l) {
+    memset(l->x, 0, sizeof(l->x));
+    l->prev_d = 0.;
+    l->prev_a = 0.;
+    l->out_d = 0.;
+    l->out_a = 0.;
+}
+
+/** Computes the wheel commands from the current state and converts them
+ * to distance and angle, as in rs_get_polar_from_wheels(). */
+static void lqr_2wheels_update(struct lqr_2wheels *l) {
+    float x[4], u[2];
+    uint8_t i;
+
+    /* The errors are consign - measure, i.e. the opposite of the state. */
+    for (i = 0; i < 4; i++)
+        x[i] = -l->x[i];
+
+    lqr_compute(&l->lqr, x, u);
+
+    l->out_d = (u[1] + u[0]) / 2;
+    l->out_a = (u[1] - u[0]) / 2;
+}
+
+float lqr_2wheels_do_filter_distance(void *data, float in) {
+    struct lqr_2wheels *l = data;
+
+    l->x[0] = in;
+    l->x[2] = in - l->prev_d;
+    l->prev_d = in;
+
+    lqr_2wheels_update(l);
+    return l->out_d;
+}
+
+float lqr_2wheels_do_filter_angle(void *data, float in) {
+    struct lqr_2wheels *l = data;
+
+    l->x[1] = in;
+    l->x[3] = in - l->prev_a;
+    l->prev_a = in;
+
+    lqr_2wheels_update(l);
+    return l->out_a;
+}
@@ -0,0 +1,119 @@
+/** @file modules/lqr/lqr.h
+ * @author CVRA
+ * @brief Discrete state feedback (LQR) controller.
+ *
+ * A state feedback controller computes all its outputs from the full state
+ * of the system: u = -K x. When K is the solution of the discrete LQR
+ * problem, it is the optimal gain for the chosen weights on the state
+ * errors (Q) and on the commands (R). Unlike two independent PIDs, it
+ * uses the coupling between the axes, for example the fact that each
+ * wheel of the robot acts on both the distance and the angle.
+ *
+ * The gains are computed offline by tools/lqr_design, so the runtime cost
+ * is a single n * m matrix-vector product.
+ *
+ * For a 2 wheeled robot, lqr_2wheels plugs the controller in the correct
+ * filter slot of the distance and angle control systems. The state is
+ * (distance error, angle error, distance error rate, angle error rate),
+ * the rates being the difference between two periods, and the outputs are
+ * the commands of the left and right wheels, converted back to distance
+ * and angle for robot_system:
+ * @code
+ * // generated by tools/lqr_design
+ * static const float k[2 * 4] = {...};
+ *
+ * lqr_2wheels_init(&lqr);
+ * lqr_set_gains(&lqr.lqr, k);
+ * lqr_set_max_output(&lqr.lqr, 4095);
+ * cs_set_correct_filter(&distance_cs, lqr_2wheels_do_filter_distance, &lqr);
+ * cs_set_correct_filter(&angle_cs, lqr_2wheels_do_filter_angle, &lqr);
+ * @endcode
+ *
+ * @note The two control systems are processed one after the other, so
+ * each axis uses the error of the other axis from the previous period
+ * when it is processed first.
+ */
+
+#ifndef _LQR_H_
+#define _LQR_H_
+
+#include <stdint.h>
+
+/** Maximal size of the state. */
+#define LQR_MAX_STATES 6
+
+/** Maximal number of commands. */
+#define LQR_MAX_INPUTS 2
+
+/** A state feedback controller. */
+struct lqr {
+    float k[LQR_MAX_INPUTS][LQR_MAX_STATES]; /**< Feedback gains. */
+    uint8_t n;          /**< Size of the state. */
+    uint8_t m;          /**< Number of commands. */
+    float max_out;      /**< Saturation of the commands, 0 to disable it. */
+};
+
+/** State feedback driving the two wheels from the distance and angle errors. */
+struct lqr_2wheels {
+    struct lqr lqr;     /**< Controller with 4 states and 2 commands. */
+    float x[4];         /**< Errors on distance, angle and their rates. */
+    float prev_d;       /**< Distance error at the previous period. */
+    float prev_a;       /**< Angle error at the previous period. */
+    float out_d;        /**< Last distance command. */
+    float out_a;        /**< Last angle command. */
+};
+
+/** @brief Initializes the controller with null gains.
+ * @param [in] l The lqr instance.
+ * @param [in] n Size of the state, at most LQR_MAX_STATES.
+ * @param [in] m Number of commands, at most LQR_MAX_INPUTS.
+ */
+void lqr_init(struct lqr *l, uint8_t n, uint8_t m);
+
+/** @brief Sets the gains.
+ * @param [in] l The lqr instance.
+ * @param [in] k The m * n gains, row by row (one row per command).
+ */
+void lqr_set_gains(struct lqr *l, const float *k);
+
+/** @brief Sets the saturation of the commands.
+ * @param [in] l The lqr instance.
+ * @param [in] max_out Maximal absolute value of each command, 0 to disable.
+ */
+void lqr_set_max_output(struct lqr *l, float max_out);
+
+/** @brief Computes the commands u = -K x.
+ * @param [in] l The lqr instance.
+ * @param [in] x The state, n values.
+ * @param [out] u The commands, m values.
+ */
+void lqr_compute(struct lqr *l, const float *x, float *u);
+
+/** @brief Initializes a 2 wheels controller, with 4 states and 2 commands.
+ *
+ * The gains are given as (left, right) rows over the states (distance,
+ * angle, distance rate, angle rate), with u = K e where e are the errors
+ * (consign - measure) given by the control systems.
+ */
+void lqr_2wheels_init(struct lqr_2wheels *l);
+
+/** @brief Resets the errors, to be called when the control systems restart. */
+void lqr_2wheels_reset(struct lqr_2wheels *l);
+
+/** @brief Correct filter of the distance control system.
+ *
+ * \param [in] data A pointer to a lqr_2wheels instance, casted to void *.
+ * \param [in] in The distance error.
+ * @returns The distance command.
+ */
+float lqr_2wheels_do_filter_distance(void *data, float in);
+
+/** @brief Correct filter of the angle control system.
+ *
+ * \param [in] data A pointer to a lqr_2wheels instance, casted to void *.
+ * \param [in] in The angle error.
+ * @returns The angle command.
+ */
+float lqr_2wheels_do_filter_angle(void *data, float in);
+
+#endif
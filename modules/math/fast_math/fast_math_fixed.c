@@ -0,0 +1,374 @@
+/** @file modules/math/fast_math/fast_math_fixed.c
+ * @author CVRA
+ * @brief Integer versions of the fast_math functions, for targets without FPU.
+ */
+
+#include "fast_math_fixed.h"
+#include "fast_math.h"
+
+#include <math.h>
+#include <stdio.h>  // printf()
+#include <stdlib.h> // srand() & rand()
+#include <time.h>   // clock()
+
+#ifdef COMPILE_ON_ROBOT
+ #include <uptime.h> /* for benchmark */
+ #include <aversive.h>
+#endif
+
+/** sin(i * pi / 512) in Q15, for i in [0, 256]. */
+static const int16_t fast_sin_q15_lut[257] = {
+         0,    201,    402,    603,    804,   1005,   1206,   1407,
+      1608,   1809,   2009,   2210,   2411,   2611,   2811,   3012,
+      3212,   3412,   3612,   3812,   4011,   4211,   4410,   4609,
+      4808,   5007,   5205,   5404,   5602,   5800,   5998,   6195,
+      6393,   6590,   6787,   6983,   7180,   7376,   7571,   7767,
+      7962,   8157,   8351,   8546,   8740,   8933,   9127,   9319,
+      9512,   9704,   9896,  10088,  10279,  10469,  10660,  10850,
+     11039,  11228,  11417,  11605,  11793,  11980,  12167,  12354,
+     12540,  12725,  12910,  13095,  13279,  13463,  13646,  13828,
+     14010,  14192,  14373,  14553,  14733,  14912,  15091,  15269,
+     15447,  15624,  15800,  15976,  16151,  16326,  16500,  16673,
+     16846,  17018,  17190,  17361,  17531,  17700,  17869,  18037,
+     18205,  18372,  18538,  18703,  18868,  19032,  19195,  19358,
+     19520,  19681,  19841,  20001,  20160,  20318,  20475,  20632,
+     20788,  20943,  21097,  21251,  21403,  21555,  21706,  21856,
+     22006,  22154,  22302,  22449,  22595,  22740,  22884,  23028,
+     23170,  23312,  23453,  23593,  23732,  23870,  24008,  24144,
+     24279,  24414,  24548,  24680,  24812,  24943,  25073,  25202,
+     25330,  25457,  25583,  25708,  25833,  25956,  26078,  26199,
+     26320,  26439,  26557,  26674,  26791,  26906,  27020,  27133,
+     27246,  27357,  27467,  27576,  27684,  27791,  27897,  28002,
+     28106,  28209,  28311,  28411,  28511,  28610,  28707,  28803,
+     28899,  28993,  29086,  29178,  29269,  29359,  29448,  29535,
+     29622,  29707,  29792,  29875,  29957,  30038,  30118,  30196,
+     30274,  30350,  30425,  30499,  30572,  30644,  30715,  30784,
+     30853,  30920,  30986,  31050,  31114,  31177,  31238,  31298,
+     31357,  31415,  31471,  31527,  31581,  31634,  31686,  31737,
+     31786,  31834,  31881,  31927,  31972,  32015,  32058,  32099,
+     32138,  32177,  32214,  32251,  32286,  32319,  32352,  32383,
+     32413,  32442,  32470,  32496,  32522,  32546,  32568,  32590,
+     32610,  32629,  32647,  32664,  32679,  32693,  32706,  32718,
+     32729,  32738,  32746,  32753,  32758,  32762,  32766,  32767,
+     32767,
+};
+
+/** atan(i / 256) in BAM16, for i in [0, 256]. */
+static const uint16_t fast_atan_bam16_lut[257] = {
+         0,     41,     81,    122,    163,    204,    244,    285,
+       326,    367,    407,    448,    489,    529,    570,    610,
+       651,    692,    732,    773,    813,    854,    894,    935,
+       975,   1015,   1056,   1096,   1136,   1177,   1217,   1257,
+      1297,   1337,   1377,   1417,   1457,   1497,   1537,   1577,
+      1617,   1656,   1696,   1736,   1775,   1815,   1854,   1894,
+      1933,   1973,   2012,   2051,   2090,   2129,   2168,   2207,
+      2246,   2285,   2324,   2363,   2401,   2440,   2478,   2517,
+      2555,   2594,   2632,   2670,   2708,   2746,   2784,   2822,
+      2860,   2897,   2935,   2973,   3010,   3047,   3085,   3122,
+      3159,   3196,   3233,   3270,   3307,   3344,   3380,   3417,
+      3453,   3490,   3526,   3562,   3599,   3635,   3670,   3706,
+      3742,   3778,   3813,   3849,   3884,   3920,   3955,   3990,
+      4025,   4060,   4095,   4129,   4164,   4199,   4233,   4267,
+      4302,   4336,   4370,   4404,   4438,   4471,   4505,   4539,
+      4572,   4605,   4639,   4672,   4705,   4738,   4771,   4803,
+      4836,   4869,   4901,   4933,   4966,   4998,   5030,   5062,
+      5094,   5125,   5157,   5188,   5220,   5251,   5282,   5313,
+      5344,   5375,   5406,   5437,   5467,   5498,   5528,   5559,
+      5589,   5619,   5649,   5679,   5708,   5738,   5768,   5797,
+      5826,   5856,   5885,   5914,   5943,   5972,   6000,   6029,
+      6058,   6086,   6114,   6142,   6171,   6199,   6227,   6254,
+      6282,   6310,   6337,   6365,   6392,   6419,   6446,   6473,
+      6500,   6527,   6554,   6580,   6607,   6633,   6660,   6686,
+      6712,   6738,   6764,   6790,   6815,   6841,   6867,   6892,
+      6917,   6943,   6968,   6993,   7018,   7043,   7068,   7092,
+      7117,   7141,   7166,   7190,   7214,   7238,   7262,   7286,
+      7310,   7334,   7358,   7381,   7405,   7428,   7451,   7475,
+      7498,   7521,   7544,   7566,   7589,   7612,   7635,   7657,
+      7679,   7702,   7724,   7746,   7768,   7790,   7812,   7834,
+      7856,   7877,   7899,   7920,   7942,   7963,   7984,   8005,
+      8026,   8047,   8068,   8089,   8110,   8131,   8151,   8172,
+      8192,
+};
+
+/** 1 / sqrt((i + 8.5) / 32) in Q30, first approximation of the reciprocal
+ * square root of a number normalized in [0.25, 1[. */
+static const uint32_t fast_invsqrt_q30_seed[24] = {
+    2083365155u, 1970666148u, 1874477404u, 1791125178u,
+    1717986918u, 1653133683u, 1595110809u, 1542797797u,
+    1495315679u, 1451963954u, 1412176548u, 1375490368u,
+    1341522400u, 1309952745u, 1280511845u, 1252970736u,
+    1227133513u, 1202831433u, 1179918260u, 1158266544u,
+    1137764631u, 1118314230u, 1099828424u, 1082230034u,
+};
+
+int16_t fast_sin_q15(uint16_t angle)
+{
+    uint16_t a = angle & 0x3fff;
+    uint16_t i, frac;
+    int32_t v;
+
+    /* the second and fourth quarters are mirrored */
+    if (angle & 0x4000)
+        a = 0x4000 - a;
+
+    /* 256 segments of 64 steps */
+    i = a >> 6;
+    frac = a & 63;
+    v = fast_sin_q15_lut[i];
+    if (frac)
+        v += ((fast_sin_q15_lut[i + 1] - v) * frac + 32) >> 6;
+
+    if (angle & 0x8000)
+        v = -v;
+
+    return v;
+}
+
+int16_t fast_cos_q15(uint16_t angle)
+{
+    return fast_sin_q15(angle + FAST_BAM16_PI_2);
+}
+
+int16_t fast_atan2_bam16(int32_t y, int32_t x)
+{
+    uint32_t ax, ay, t, tmp;
+    uint16_t i, frac, shift;
+    int32_t a;
+
+    if (x == 0 && y == 0)
+        return 0;
+
+    ax = x < 0 ? -(uint32_t)x : (uint32_t)x;
+    ay = y < 0 ? -(uint32_t)y : (uint32_t)y;
+
+    /* first octant: ay <= ax */
+    if (ay > ax) {
+        tmp = ax;
+        ax = ay;
+        ay = tmp;
+    }
+
+    /* keep the ratio in 32 bits, rounding the shifted values (a
+     * truncated ay is up to 1 / 32768 too small) */
+    shift = 0;
+    while ((ax >> shift) >= 0x10000)
+        shift++;
+    if (shift) {
+        ax = (ax >> shift) + ((ax >> (shift - 1)) & 1);
+        ay = (ay >> shift) + ((ay >> (shift - 1)) & 1);
+    }
+
+    /* ratio in Q16, 256 segments of 256 steps. After the rounding, ay
+     * may be 0x10000, but only when it equals ax. */
+    t = ay >= ax ? 0x10000 : (ay << 16) / ax;
+    i = t >> 8;
+    frac = t & 255;
+    a = fast_atan_bam16_lut[i];
+    if (frac)
+        a += ((fast_atan_bam16_lut[i + 1] - a) * (int32_t)frac + 128) >> 8;
+
+    if ((y < 0 ? -(uint32_t)y : (uint32_t)y) > (x < 0 ? -(uint32_t)x : (uint32_t)x))
+        a = FAST_BAM16_PI_2 - a;
+    if (x < 0)
+        a = FAST_BAM16_PI - a;
+    if (y < 0)
+        a = -a;
+
+    return (int16_t)(uint16_t)a;
+}
+
+uint16_t fast_isqrt32(uint32_t v)
+{
+    uint32_t res = 0;
+    uint32_t bit = 1ul << 30;
+
+    while (bit > v)
+        bit >>= 2;
+
+    /* one bit of the result per iteration */
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return res;
+}
+
+uint32_t fast_sqrt_q16(uint32_t v)
+{
+    uint64_t x = (uint64_t)v << 16;
+    uint64_t res = 0;
+    uint64_t bit = 1ull << 46;
+
+    while (bit > x)
+        bit >>= 2;
+
+    while (bit) {
+        if (x >= res + bit) {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return res;
+}
+
+uint32_t fast_invsqrt_q31(uint32_t v)
+{
+    uint32_t xn, e;
+    uint64_t r, r2, mr2;
+    int i;
+
+    /* v = xn / 4^e, with xn in [2^30, 2^32[, which is m in [0.25, 1[ */
+    e = __builtin_clz(v) >> 1;
+    xn = v << (2 * e);
+
+    /* 1 / sqrt(m), Q30 */
+    r = fast_invsqrt_q30_seed[(xn >> 27) - 8];
+    for (i = 0; i < 3; i++) {
+        r2 = (r * r + (1ull << 29)) >> 30;
+        mr2 = ((uint64_t)xn * r2 + (1ull << 31)) >> 32;
+        r = (r * ((3ull << 30) - mr2) + (1ull << 30)) >> 31;
+    }
+
+    /* 1 / sqrt(v) = 2^e / (2^16 sqrt(m)) */
+    if (e < 15)
+        r = (r + (1ul << (14 - e))) >> (15 - e);
+
+    return r;
+}
+
+void fast_fixed_benchmark(void)
+{
+    #ifdef COMPILE_ON_ROBOT
+     #define UPTIME_GET (uptime_get())
+     #define UT "us"
+     #define NL "\r"    // newline char
+    #else
+     #define UPTIME_GET ((uint32_t)clock())
+     #define UT "clk"
+     #define NL "\n"    // newline char
+    #endif
+
+    const int CNT = 10000;
+    const int32_t ATAN2_CNT = 1000000;
+    uint32_t t;
+    int32_t i, x, y;
+    volatile int32_t r_i = 0;
+    volatile float r_f = 0.0f;
+    double err, max_sin = 0, max_cos = 0, max_atan2 = 0, max_invsqrt = 0;
+    uint32_t bad_sqrt = 0;
+    int32_t vx[CNT], vy[CNT];
+    uint32_t vu[CNT];
+    float vf[CNT];
+
+    printf("***Start Fixed Point Benchmark***"NL);
+    printf(NL);
+
+    fast_math_init();
+    srand(time(0));
+    for (i = 0; i < CNT; i++) {
+        /* all the magnitudes of the int32_t range */
+        vx[i] = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand()) >> (rand() % 32);
+        vy[i] = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand()) >> (rand() % 32);
+        vu[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        if (vu[i] == 0)
+            vu[i] = 1;
+        vf[i] = ((float)rand() / (float)RAND_MAX - 0.5f) * 6.28f;
+    }
+
+    /* maximal errors, over all the angles for sin and cos */
+    for (i = 0; i < 65536; i++) {
+        err = fabs(fast_sin_q15(i) / 32768. - sin(i * M_PI / 32768.));
+        if (err > max_sin)
+            max_sin = err;
+        err = fabs(fast_cos_q15(i) / 32768. - cos(i * M_PI / 32768.));
+        if (err > max_cos)
+            max_cos = err;
+    }
+
+    /* more samples for atan2, whose worst cases are rare */
+    for (i = 0; i < ATAN2_CNT; i++) {
+        x = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand()) >> (rand() % 32);
+        y = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand()) >> (rand() % 32);
+        err = fast_atan2_bam16(y, x) * M_PI / 32768. - atan2(y, x);
+        if (err > M_PI)
+            err -= 2 * M_PI;
+        if (err < -M_PI)
+            err += 2 * M_PI;
+        if (fabs(err) > max_atan2)
+            max_atan2 = fabs(err);
+    }
+
+    for (i = 0; i < CNT; i++) {
+        if ((uint32_t)fast_isqrt32(vu[i]) != (uint32_t)floor(sqrt((double)vu[i])))
+            bad_sqrt++;
+        if (fast_sqrt_q16(vu[i]) != (uint32_t)floor(sqrt((double)vu[i] * 65536.)))
+            bad_sqrt++;
+
+        err = fabs(fast_invsqrt_q31(vu[i]) - 2147483648. / sqrt((double)vu[i]));
+        if (err > max_invsqrt)
+            max_invsqrt = err;
+    }
+
+    printf("max error fast_sin_q15      : %.3e"NL, max_sin);
+    printf("max error fast_cos_q15      : %.3e"NL, max_cos);
+    printf("max error fast_atan2_bam16  : %.3e rad"NL, max_atan2);
+    printf("wrong sqrt results          : %lu"NL, (unsigned long)bad_sqrt);
+    printf("max error fast_invsqrt_q31  : %.3f LSB"NL, max_invsqrt);
+    printf(NL);
+
+    /* timings, compared to the float versions */
+    t = UPTIME_GET;
+    for (i = 0; i < CNT; i++)
+        r_i += fast_sin_q15(vx[i]);
+    printf("fast_sin_q15     : %lu "UT NL, (unsigned long)(UPTIME_GET - t));
+
+    t = UPTIME_GET;
+    for (i = 0; i < CNT; i++)
+        r_f += fast_sinf(vf[i]);
+    printf("fast_sinf        : %lu "UT NL, (unsigned long)(UPTIME_GET - t));
+
+    t = UPTIME_GET;
+    for (i = 0; i < CNT; i++)
+        r_i += fast_atan2_bam16(vy[i], vx[i]);
+    printf("fast_atan2_bam16 : %lu "UT NL, (unsigned long)(UPTIME_GET - t));
+
+    t = UPTIME_GET;
+    for (i = 0; i < CNT; i++)
+        r_f += fast_atan2f(vy[i], vx[i]);
+    printf("fast_atan2f      : %lu "UT NL, (unsigned long)(UPTIME_GET - t));
+
+    t = UPTIME_GET;
+    for (i = 0; i < CNT; i++)
+        r_i += fast_isqrt32(vu[i]);
+    printf("fast_isqrt32     : %lu "UT NL, (unsigned long)(UPTIME_GET - t));
+
+    t = UPTIME_GET;
+    for (i = 0; i < CNT; i++)
+        r_f += fast_sqrtf(vu[i]);
+    printf("fast_sqrtf       : %lu "UT NL, (unsigned long)(UPTIME_GET - t));
+
+    t = UPTIME_GET;
+    for (i = 0; i < CNT; i++)
+        r_i += fast_invsqrt_q31(vu[i]);
+    printf("fast_invsqrt_q31 : %lu "UT NL, (unsigned long)(UPTIME_GET - t));
+
+    t = UPTIME_GET;
+    for (i = 0; i < CNT; i++)
+        r_f += fast_invsqrtf(vu[i]);
+    printf("fast_invsqrtf    : %lu "UT NL, (unsigned long)(UPTIME_GET - t));
+
+    printf(NL);
+    printf("***End Fixed Point Benchmark***"NL);
+}
@@ -0,0 +1,95 @@
+/** @file modules/math/fast_math/fast_math_fixed.h
+ * @author CVRA
+ * @brief Integer versions of the fast_math functions, for targets without FPU.
+ *
+ * On a NIOS II without floating point unit, each fast_sinf() is a chain of
+ * soft-float calls. These functions only use integer operations (32 bits,
+ * and 64 bits products for the square roots), with constant lookup tables
+ * which do not need fast_math_init().
+ *
+ * Formats:
+ *  - Angles are binary angles (BAM16): a full turn is 65536, so the angle
+ *    arithmetic wraps naturally on 16 bits. As a uint16_t, the range is
+ *    [0, 2pi[, as an int16_t it is [-pi, pi[.
+ *  - Q15 values are int16_t in [-1, 1[, 1.0 being 32768 (sin and cos of
+ *    quarter turns saturate to 32767).
+ *  - Q16 values are unsigned 16.16 fixed point numbers, Q31 values are
+ *    unsigned 1.31 fixed point numbers.
+ *
+ * Error bounds, measured by fast_fixed_benchmark() against libm:
+ *  - fast_sin_q15(), fast_cos_q15(): 1 LSB (3.1e-5).
+ *  - fast_atan2_bam16(): 1.3 LSB (1.22e-4 rad, 1 LSB = 9.6e-5 rad), over
+ *    the whole int32_t range.
+ *  - fast_isqrt32(), fast_sqrt_q16(): exact (rounded down).
+ *  - fast_invsqrt_q31(): 1 LSB. As the result shrinks with v, the
+ *    relative error is 5e-10 for small v but 3e-5 around 2^32.
+ */
+
+#ifndef _FAST_MATH_FIXED_H_
+#define _FAST_MATH_FIXED_H_
+
+#include <stdint.h>
+
+/** BAM16 value of a quarter turn (pi/2). */
+#define FAST_BAM16_PI_2 16384
+
+/** BAM16 value of a half turn (pi). */
+#define FAST_BAM16_PI 32768
+
+/** Converts an angle in radians to BAM16, for constants. */
+#define FAST_BAM16_FROM_RAD(r) ((uint16_t)(int32_t)((r) * 10430.378350470453f))
+
+/** Converts a BAM16 angle to radians, for debugging. */
+#define FAST_BAM16_TO_RAD(b) ((int16_t)(b) * 9.587379924285257e-05f)
+
+/** Converts a number to Q15, for constants. */
+#define FAST_Q15(x) ((int16_t)((x) * 32768.f))
+
+/** Computes the sine of a binary angle.
+ *
+ * Quarter wave lookup table of 257 entries with linear interpolation.
+ * @param [in] angle The angle, BAM16.
+ * @return The sine, Q15.
+ */
+int16_t fast_sin_q15(uint16_t angle);
+
+/** Computes the cosine of a binary angle.
+ * @param [in] angle The angle, BAM16.
+ * @return The cosine, Q15.
+ */
+int16_t fast_cos_q15(uint16_t angle);
+
+/** Computes the angle of a vector.
+ *
+ * The components are reduced to the first octant, and the arctangent of
+ * their ratio is interpolated in a lookup table of 257 entries.
+ * @param [in] y, x The vector, in any unit.
+ * @return The angle of the vector, BAM16 in [-pi, pi[. 0 for the null vector.
+ */
+int16_t fast_atan2_bam16(int32_t y, int32_t x);
+
+/** Computes the integer square root of an integer.
+ * @return floor(sqrt(v)).
+ */
+uint16_t fast_isqrt32(uint32_t v);
+
+/** Computes the square root of a Q16 number.
+ * @return sqrt(v), Q16, rounded down.
+ */
+uint32_t fast_sqrt_q16(uint32_t v);
+
+/** Computes the reciprocal of the square root of an integer.
+ *
+ * The value is normalized, a first approximation is read in a table and
+ * refined by Newton iterations. This is useful to normalize a vector from
+ * its squared norm. For a Qn input, the result must be multiplied by
+ * 2^(n/2).
+ * @param [in] v The integer, must not be 0.
+ * @return 1/sqrt(v), Q31.
+ */
+uint32_t fast_invsqrt_q31(uint32_t v);
+
+/** Benchmarks the integer functions, and prints their maximal errors. */
+void fast_fixed_benchmark(void);
+
+#endif
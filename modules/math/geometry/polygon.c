@@ -23,6 +23,7 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <vect_base.h>
 #include <lines.h>
@@ -42,6 +43,8 @@ static int32_t bbox_y1 = 0;
 static int32_t bbox_x2 = 100;
 static int32_t bbox_y2 = 100;
 
+/* tangent graph pruning in calc_rays() */
+static uint8_t tangent_pruning = 1;
 
 void polygon_set_boundingbox(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
 {
@@ -51,6 +54,24 @@ void polygon_set_boundingbox(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
 	bbox_y2 = y2;
 }
 
+void polygon_get_boundingbox(int32_t *x1, int32_t *y1, int32_t *x2, int32_t *y2)
+{
+	*x1 = bbox_x1;
+	*y1 = bbox_y1;
+	*x2 = bbox_x2;
+	*y2 = bbox_y2;
+}
+
+void polygon_set_tangent_pruning(uint8_t enable)
+{
+	tangent_pruning = enable;
+}
+
+uint8_t polygon_get_tangent_pruning(void)
+{
+	return tangent_pruning;
+}
+
 uint8_t is_in_boundingbox(const point_t *p)
 {
 	if (p->x >= bbox_x1 &&
@@ -61,13 +82,66 @@ uint8_t is_in_boundingbox(const point_t *p)
 	return 0;
 }
 
-/* Test if a point is in a polygon (including edges)
+/* Test if a point is in a simple polygon (including edges), with its
+ * winding number: the number of times the edges turn around the point.
  *  0 not inside
  *  1 inside
  *  2 on edge
  */
-uint8_t 
+uint8_t
 is_in_poly(const point_t *p, poly_t *pol)
+{
+	uint8_t i, n;
+	int16_t wn = 0;
+	float c;
+	const point_t *a, *b;
+
+	for (i=0; i<pol->l; i++) {
+		/* is a polygon point */
+		if (p->x == pol->pts[i].x && p->y == pol->pts[i].y)
+			return 2;
+	}
+
+	for (i=0; i<pol->l; i++) {
+		n = (i+1)%pol->l;
+		a = &pol->pts[i];
+		b = &pol->pts[n];
+
+		/* sign of the position of p relative to the edge */
+		c = (b->x - a->x) * (p->y - a->y) - (p->x - a->x) * (b->y - a->y);
+
+		if (a->y <= p->y) {
+			/* upward edge crossing the horizontal of p */
+			if (b->y > p->y) {
+				if (c == 0)
+					return 2;
+				if (c > 0)
+					wn++;
+			}
+			else if (a->y == p->y && b->y == p->y &&
+				 (p->x - a->x) * (p->x - b->x) < 0)
+				return 2;
+		}
+		else if (b->y <= p->y) {
+			/* downward edge */
+			if (c == 0)
+				return 2;
+			if (c < 0)
+				wn--;
+		}
+	}
+
+	return wn != 0;
+}
+
+/* Test if a point is in a counter clockwise convex polygon (including
+ * edges), with the signs of consecutive cross products.
+ *  0 not inside
+ *  1 inside
+ *  2 on edge
+ */
+uint8_t 
+is_in_convex_poly(const point_t *p, poly_t *pol)
 {
 	uint8_t i;
 	uint8_t ii;
@@ -75,6 +149,10 @@ is_in_poly(const point_t *p, poly_t *pol)
 	uint8_t ret=1;
 	vect_t v, w;
 
+	/* an empty polygon contains nothing */
+	if (pol->l == 0)
+		return 0;
+
 	for (i=0;i<pol->l;i++) {
 		/* is a polygon point */
 		if (p->x == pol->pts[i].x && p->y == pol->pts[i].y)
@@ -98,6 +176,123 @@ is_in_poly(const point_t *p, poly_t *pol)
 	return ret;
 }
 
+/* x of the edge e of the polygon at the ordinate y */
+static float
+edge_x_at(poly_t *pol, uint8_t e, float y)
+{
+	const point_t *a = &pol->pts[e];
+	const point_t *b = &pol->pts[(e+1)%pol->l];
+
+	return a->x + (b->x - a->x) * (y - a->y) / (b->y - a->y);
+}
+
+int8_t
+poly_slabs_build(poly_slabs_t *s, poly_t *pol, void *buf, uint32_t size)
+{
+	uint8_t i, j, e, n;
+	uint16_t k, edge_n = 0;
+	float y, ylo, yhi, ym, x;
+
+	if (size < POLY_SLABS_SIZE(pol->l))
+		return -1;
+
+	s->poly = pol;
+	s->ys = buf;
+	s->first = (uint16_t *)(s->ys + pol->l);
+	s->edges = (uint8_t *)(s->first + pol->l + 1);
+
+	/* sorted distinct ordinates of the vertices */
+	n = 0;
+	for (i=0; i<pol->l; i++) {
+		y = pol->pts[i].y;
+		for (j=0; j<n && s->ys[j] < y; j++);
+		if (j < n && s->ys[j] == y)
+			continue;
+		for (k=n; k>j; k--)
+			s->ys[k] = s->ys[k-1];
+		s->ys[j] = y;
+		n++;
+	}
+	s->n = n > 0 ? n - 1 : 0;
+
+	for (i=0; i<s->n; i++) {
+		s->first[i] = edge_n;
+		ym = (s->ys[i] + s->ys[i+1]) / 2;
+
+		for (e=0; e<pol->l; e++) {
+			ylo = pol->pts[e].y;
+			yhi = pol->pts[(e+1)%pol->l].y;
+			if (ylo > yhi) {
+				y = ylo; ylo = yhi; yhi = y;
+			}
+			if (ylo > s->ys[i] || yhi < s->ys[i+1])
+				continue;
+
+			/* insertion by x in the middle of the slab */
+			x = edge_x_at(pol, e, ym);
+			for (k=edge_n; k>s->first[i] &&
+				     edge_x_at(pol, s->edges[k-1], ym) > x; k--)
+				s->edges[k] = s->edges[k-1];
+			s->edges[k] = e;
+			edge_n++;
+		}
+	}
+	s->first[s->n] = edge_n;
+
+	return 0;
+}
+
+uint8_t
+poly_slabs_is_in(const poly_slabs_t *s, const point_t *p)
+{
+	uint16_t lo, hi, mid, start;
+	const point_t *a, *b;
+	poly_t *pol = s->poly;
+	float c;
+
+	if (s->n == 0 || p->y < s->ys[0] || p->y > s->ys[s->n])
+		return 0;
+
+	/* slab containing p */
+	lo = 0;
+	hi = s->n;
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (s->ys[mid] <= p->y)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	/* on the line of a vertex, horizontal edges and vertices make it
+	 * a special case */
+	if (p->y == s->ys[lo] || p->y == s->ys[hi])
+		return is_in_poly(p, pol);
+
+	/* number of edges on the left of p */
+	start = lo = s->first[lo];
+	hi = s->first[hi];
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		a = &pol->pts[s->edges[mid]];
+		b = &pol->pts[(s->edges[mid]+1)%pol->l];
+		if (a->y > b->y) {
+			a = b;
+			b = &pol->pts[s->edges[mid]];
+		}
+		/* sign of p relative to the upward edge */
+		c = (b->x - a->x) * (p->y - a->y) - (p->x - a->x) * (b->y - a->y);
+		if (c == 0)
+			return 2;
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* each edge crossing the slab on the left toggles inside */
+	return (lo - start) & 1;
+}
+
 /* public wrapper for is_in_poly() */
 uint8_t is_point_in_poly(poly_t *pol, int16_t x, int16_t y)
 {
@@ -107,92 +302,174 @@ uint8_t is_point_in_poly(poly_t *pol, int16_t x, int16_t y)
 	return is_in_poly(&p, pol);
 }
 
+/* Twice the signed area of the triangle (a, b, c), > 0 if c is on the
+ * left of (a, b). Exact for coordinates in mm. */
+static double
+orient(const point_t *a, const point_t *b, const point_t *c)
+{
+	return ((double)b->x - a->x) * ((double)c->y - a->y) -
+		((double)b->y - a->y) * ((double)c->x - a->x);
+}
+
+/* Is c, on the line (a, b), between a and b (included)? */
+static uint8_t
+is_between(const point_t *a, const point_t *b, const point_t *c)
+{
+	return ((double)c->x - a->x) * ((double)c->x - b->x) +
+		((double)c->y - a->y) * ((double)c->y - b->y) <= 0;
+}
+
+/* Returns 1 if a piece of the segment (p1, p2) between two contacts
+ * with the boundary of the polygon is inside it. The segment must not
+ * properly cross any edge. */
+static uint8_t
+is_touching_poly_inside(const point_t *p1, const point_t *p2, poly_t *pol)
+{
+	float t[pol->l + 2];
+	float tt, len;
+	uint8_t i, j, n = 0;
+	vect_t d, w;
+	point_t m;
+
+	d.x = p2->x - p1->x;
+	d.y = p2->y - p1->y;
+	len = d.x * d.x + d.y * d.y;
+	if (len == 0)
+		return 0;
+
+	/* position along the segment of the vertices on it */
+	t[n++] = 0;
+	for (i=0; i<pol->l; i++) {
+		if (orient(p1, p2, &pol->pts[i]) != 0)
+			continue;
+		w.x = pol->pts[i].x - p1->x;
+		w.y = pol->pts[i].y - p1->y;
+		tt = (w.x * d.x + w.y * d.y) / len;
+		if (tt <= 0 || tt >= 1)
+			continue;
+		/* insertion sort */
+		for (j=n; j>0 && t[j-1] > tt; j--)
+			t[j] = t[j-1];
+		t[j] = tt;
+		n++;
+	}
+	t[n++] = 1;
+
+	for (i=0; i+1<n; i++) {
+		m.x = p1->x + d.x * (t[i] + t[i+1]) / 2;
+		m.y = p1->y + d.y * (t[i] + t[i+1]) / 2;
+		if (is_in_poly(&m, pol) == 1)
+			return 1;
+	}
+	return 0;
+}
+
 /* Is segment crossing polygon? (including edges)
  *  0 don't cross
  *  1 cross
- *  2 on a side
+ *  2 on a side (runs along an edge, without entering the polygon)
  *  3 touch out (a segment boundary is on a polygon edge, 
  *  and the second segment boundary is out of the polygon)
+ *
+ * The contacts are found with exact orientation tests: a segment
+ * touching a vertex or running along an edge is never taken for a
+ * proper crossing, nor the opposite.
  */
 uint8_t 
 is_crossing_poly(point_t p1, point_t p2, point_t *intersect_pt,
 		 poly_t *pol)
 {
 	uint8_t i;
-	uint8_t ret;
-	point_t p;
+	const point_t *a, *b;
+	double d1, d2, d3, d4, len, ta, tb;
 	uint8_t ret1, ret2;
-	uint8_t cpt=0;
+	uint8_t cpt=0, overlap=0;
 	
 	debug_printf("%" PRIi32 " %" PRIi32 " -> %" PRIi32 " %" PRIi32 " crossing poly %p ?\n", 
 	       p1.x, p1.y, p2.x, p2.y, pol);
-	debug_printf("poly is : ");
-	for (i=0; i<pol->l; i++) {
-		debug_printf("%" PRIi32 ",%" PRIi32 " ", pol->pts[i].x, pol->pts[i].y);
-	}
-	debug_printf("\n");
 
 	for (i=0;i<pol->l;i++) {
-		ret = intersect_segment(&p1, &p2, &pol->pts[i], &pol->pts[(i+1)%pol->l], &p);
-		debug_printf("%" PRIi32 ",%" PRIi32 " -> %" PRIi32 ",%" PRIi32 
-			     " return %d\n", pol->pts[i].x, pol->pts[i].y, 
-		       pol->pts[(i+1)%pol->l].x, pol->pts[(i+1)%pol->l].y, ret);
+		a = &pol->pts[i];
+		b = &pol->pts[(i+1)%pol->l];
+		d1 = orient(a, b, &p1);
+		d2 = orient(a, b, &p2);
+		d3 = orient(&p1, &p2, a);
+		d4 = orient(&p1, &p2, b);
 
-
-		switch(ret) {
-		case 0:
-			break;
-		case 1:
-			if (intersect_pt)
-				*intersect_pt = p;
+		/* proper crossing */
+		if (((d1 < 0 && d2 > 0) || (d1 > 0 && d2 < 0)) &&
+		    ((d3 < 0 && d4 > 0) || (d3 > 0 && d4 < 0))) {
+			if (intersect_pt) {
+				intersect_pt->x = p1.x + (p2.x - p1.x) * d1 / (d1 - d2);
+				intersect_pt->y = p1.y + (p2.y - p1.y) * d1 / (d1 - d2);
+			}
 			return 1;
-			break;
-		case 2:
-			cpt++;
-			if (intersect_pt)
-				*intersect_pt = p;
+		}
 
-			break;
-		case 3:
+		if (d1 == 0 && d2 == 0) {
+			/* on the line of the edge: the other edges may
+			 * still be crossed, the ends of the overlap are
+			 * vertices or ends of the segment, seen as contacts
+			 * by is_touching_poly_inside() */
+			len = ((double)p2.x - p1.x) * (p2.x - p1.x) +
+				((double)p2.y - p1.y) * (p2.y - p1.y);
+			if (len == 0)
+				continue;
+			ta = (((double)a->x - p1.x) * (p2.x - p1.x) +
+			      ((double)a->y - p1.y) * (p2.y - p1.y)) / len;
+			tb = (((double)b->x - p1.x) * (p2.x - p1.x) +
+			      ((double)b->y - p1.y) * (p2.y - p1.y)) / len;
+			if (ta > tb) {
+				len = ta; ta = tb; tb = len;
+			}
+			if (tb < 0 || ta > 1)
+				continue;
+			if (tb > 0 && ta < 1)
+				overlap = 1;
+			else
+				cpt++;
 			if (intersect_pt)
-				*intersect_pt = p;
-			return 2;
-			break;
+				*intersect_pt = ta > 0 ? *a : p1;
+			continue;
 		}
-	}
 
-	if (cpt==3 ||cpt==4)
-		return 1;
+		/* contact at a vertex or at an end of the segment */
+		if ((d1 == 0 && is_between(a, b, &p1)) ||
+		    (d2 == 0 && is_between(a, b, &p2)) ||
+		    (d3 == 0 && is_between(&p1, &p2, a)) ||
+		    (d4 == 0 && is_between(&p1, &p2, b))) {
+			cpt++;
+			if (intersect_pt) {
+				if (d1 == 0)
+					*intersect_pt = p1;
+				else if (d2 == 0)
+					*intersect_pt = p2;
+				else
+					*intersect_pt = d3 == 0 ? *a : *b;
+			}
+		}
+	}
 
 	ret1 = is_in_poly(&p1, pol);
 	ret2 = is_in_poly(&p2, pol);
 
-	debug_printf("is in poly: p1 %d p2: %d cpt %d\r\n", ret1, ret2, cpt);
-
-	debug_printf("p intersect: %"PRIi32" %"PRIi32"\r\n", p.x, p.y);
+	debug_printf("is in poly: p1 %d p2: %d cpt %d overlap %d\r\n",
+		     ret1, ret2, cpt, overlap);
 
+	if (ret1==1 || ret2==1)
+		return 1;
 
-	if (cpt==0) {
-		if (ret1==1 || ret2==1)
-			return 1;
+	/* no contact: the segment is all inside or all outside */
+	if (cpt==0 && !overlap)
 		return 0;
-	}
-
 
-	if (cpt==1) {
-		if (ret1==1 || ret2==1)
-			return 1;
-		return 3;
-	}
-	if (cpt==2) {
-		if (ret1==1 || ret2==1)
-			return 1;
-		if (ret1==0 || ret2==0)
-			return 3;
+	/* the segment only touches the boundary, at vertices or at its
+	 * ends: it crosses the polygon if one of the pieces between the
+	 * contacts is inside, which a chord of a concave polygon may not */
+	if (is_touching_poly_inside(&p1, &p2, pol))
 		return 1;
-	}
-	
-	return 1;
+
+	return overlap ? 2 : 3;
 }
 
 /* Giving the list of poygons, compute the graph of "visibility rays".
@@ -211,17 +488,78 @@ is_crossing_poly(point_t p1, point_t p2, point_t *intersect_pt,
  *  are used to compute visibility to start/stop points)
  */
 
-uint8_t 
-calc_rays(poly_t *polys, uint8_t npolys, uint8_t *rays)
+/* Sign of the area of the polygon: 1 if its vertices are counter
+ * clockwise, -1 if clockwise. */
+static int8_t
+poly_orientation(poly_t *pol)
+{
+	uint8_t i, n;
+	float area = 0;
+
+	for (i=0; i<pol->l; i++) {
+		n = (i+1)%pol->l;
+		area += pol->pts[i].x * pol->pts[n].y - pol->pts[n].x * pol->pts[i].y;
+	}
+	return area < 0 ? -1 : 1;
+}
+
+/* Returns 1 if a shortest path can go through the vertex pt of the
+ * polygon pol in direction of p: the vertex must not be concave (a
+ * path never bends around it), and the line (vertex, p) must not enter
+ * the polygon, so both neighbours of the vertex are on the same side
+ * of it. orient is the result of poly_orientation(pol). */
+static uint8_t
+is_tangent_vertex(poly_t *pol, uint8_t pt, int8_t orient, const point_t *p)
+{
+	const point_t *v = &pol->pts[pt];
+	const point_t *prev = &pol->pts[(pt + pol->l - 1) % pol->l];
+	const point_t *next = &pol->pts[(pt + 1) % pol->l];
+	float turn, s1, s2;
+
+	/* segments and points have no inside */
+	if (pol->l <= 2)
+		return 1;
+
+	turn = (v->x - prev->x) * (next->y - v->y) -
+		(v->y - prev->y) * (next->x - v->x);
+	if (turn * orient < 0)
+		return 0;
+
+	s1 = (p->x - v->x) * (prev->y - v->y) - (p->y - v->y) * (prev->x - v->x);
+	s2 = (p->x - v->x) * (next->y - v->y) - (p->y - v->y) * (next->x - v->x);
+	if ((s1 < 0 && s2 > 0) || (s1 > 0 && s2 < 0))
+		return 0;
+
+	return 1;
+}
+
+/* adds a ray, or returns max_ray_n + 1 if rays is full */
+#define ADD_RAY(p1, pt1, p2, pt2) do {			\
+		if (ray_n + 4 > max_ray_n)		\
+			return max_ray_n + 1;		\
+		rays[ray_n++] = (p1);			\
+		rays[ray_n++] = (pt1);			\
+		rays[ray_n++] = (p2);			\
+		rays[ray_n++] = (pt2);			\
+	} while (0)
+
+uint32_t 
+calc_rays(poly_t *polys, uint8_t npolys, uint8_t *rays, uint32_t max_ray_n)
 {
 	uint8_t i, ii, index;
-	uint8_t ray_n=0;
+	uint32_t ray_n=0;
 	uint8_t is_ok;
 	uint8_t n;
 	uint8_t pt1, pt2;
+	int8_t orient[npolys];
 
 	/* !\\first poly is the start stop point */
 
+	if (tangent_pruning) {
+		for (i=1; i<npolys; i++)
+			orient[i] = poly_orientation(&polys[i]);
+	}
+
 	/* 1: calc inner polygon rays 
 	 * compute for each polygon edges, if the vertices can see each others 
 	 * (usefull if interlaced polygons)
@@ -239,6 +577,12 @@ calc_rays(poly_t *polys, uint8_t npolys, uint8_t *rays)
 			if (!(is_in_boundingbox(&polys[i].pts[n])))
 				continue;
 
+			/* an edge is tangent to its polygon, only the
+			 * convexity of its vertices matters */
+			if (tangent_pruning && i != 0 &&
+			    (!is_tangent_vertex(&polys[i], ii, orient[i], &polys[i].pts[n]) ||
+			     !is_tangent_vertex(&polys[i], n, orient[i], &polys[i].pts[ii])))
+				continue;
 
 			/* check if a polygon cross our ray */
 			for (index=1; index<npolys; index++) {
@@ -254,12 +598,8 @@ calc_rays(poly_t *polys, uint8_t npolys, uint8_t *rays)
 				}				    
 			}
 			/* if ray is not crossed, add it */
-			if (is_ok) {
-				rays[ray_n++] = i;
-				rays[ray_n++] = ii;
-				rays[ray_n++] = i;
-				rays[ray_n++] = n;
-			}
+			if (is_ok)
+				ADD_RAY(i, ii, i, n);
 		}
 	}
 
@@ -281,6 +621,18 @@ calc_rays(poly_t *polys, uint8_t npolys, uint8_t *rays)
 					if (!(is_in_boundingbox(&polys[ii].pts[pt2])))
 						continue;
 
+					/* the ray must be bitangent, this
+					 * test is much cheaper than the
+					 * crossing ones */
+					if (tangent_pruning && i != 0 &&
+					    !is_tangent_vertex(&polys[i], pt1, orient[i],
+							       &polys[ii].pts[pt2]))
+						continue;
+					if (tangent_pruning &&
+					    !is_tangent_vertex(&polys[ii], pt2, orient[ii],
+							       &polys[i].pts[pt1]))
+						continue;
+
 					is_ok=1;
 					/* test if a poly cross */
 					for (index=1;index<npolys;index++) {
@@ -292,12 +644,8 @@ calc_rays(poly_t *polys, uint8_t npolys, uint8_t *rays)
 						}
 					}
 					/* if not crossed, we found a vilisity ray */
-					if (is_ok) {
-						rays[ray_n++] = i;
-						rays[ray_n++] = pt1;
-						rays[ray_n++] = ii;
-						rays[ray_n++] = pt2;
-					}			
+					if (is_ok)
+						ADD_RAY(i, pt1, ii, pt2);
 				}
 			}
 		}	
@@ -307,25 +655,792 @@ calc_rays(poly_t *polys, uint8_t npolys, uint8_t *rays)
 	return ray_n;
 }
 
-/* Compute the weight of every rays: the length of the rays is used
- * here. 
+/* Returns 1 if none of the polygons first to npolys-1 (except skip)
+ * crosses the segment (p1, p2). The polygons below nbounds whose
+ * bounding box does not meet the one of the segment are not tested. */
+static uint8_t
+is_ray_free(poly_t *polys, uint8_t first, uint8_t npolys, uint8_t skip,
+	    point_t p1, point_t p2, const float *bounds, uint8_t nbounds)
+{
+	uint8_t index;
+	float xmin = p1.x < p2.x ? p1.x : p2.x;
+	float xmax = p1.x < p2.x ? p2.x : p1.x;
+	float ymin = p1.y < p2.y ? p1.y : p2.y;
+	float ymax = p1.y < p2.y ? p2.y : p1.y;
+
+	for (index=first; index<npolys; index++) {
+		if (index == skip)
+			continue;
+
+		if (index < nbounds &&
+		    (xmax < bounds[index] ||
+		     ymax < bounds[nbounds + index] ||
+		     xmin > bounds[2*nbounds + index] ||
+		     ymin > bounds[3*nbounds + index]))
+			continue;
+
+		if (is_crossing_poly(p1, p2, NULL, &polys[index]) == 1)
+			return 0;
+	}
+	return 1;
+}
+
+
+uint16_t
+calc_rays_static(poly_t *polys, uint8_t npolys, uint8_t nstatic,
+		 const uint8_t *static_rays, uint16_t static_ray_n,
+		 const float *bounds, uint8_t *rays, uint16_t max_ray_n)
+{
+	uint8_t i, ii, n, pt1, pt2;
+	uint16_t k, ray_n = 0;
+	int8_t orient[npolys];
+	uint8_t nbounds = bounds ? nstatic : 0;
+
+	if (tangent_pruning) {
+		for (i=1; i<npolys; i++)
+			orient[i] = poly_orientation(&polys[i]);
+	}
+
+	/* 1: the static rays can only be hidden by the other polygons */
+	for (k=0; k<static_ray_n; k+=4) {
+		if (!is_ray_free(polys, nstatic, npolys, 0,
+				 polys[static_rays[k]].pts[static_rays[k+1]],
+				 polys[static_rays[k+2]].pts[static_rays[k+3]],
+				 NULL, 0))
+			continue;
+		ADD_RAY(static_rays[k], static_rays[k+1],
+			static_rays[k+2], static_rays[k+3]);
+	}
+
+	/* 2: edges of the start/stop polygon and of the other polygons,
+	 * as in calc_rays() */
+	for (i=0; i<npolys; i = (i == 0 ? nstatic : i+1)) {
+		for (ii=0; ii<polys[i].l; ii++) {
+			n = (ii+1)%polys[i].l;
+			if (!is_in_boundingbox(&polys[i].pts[ii]) ||
+			    !is_in_boundingbox(&polys[i].pts[n]))
+				continue;
+
+			if (tangent_pruning && i != 0 &&
+			    (!is_tangent_vertex(&polys[i], ii, orient[i], &polys[i].pts[n]) ||
+			     !is_tangent_vertex(&polys[i], n, orient[i], &polys[i].pts[ii])))
+				continue;
+
+			if (is_ray_free(polys, 1, npolys, i, polys[i].pts[ii],
+					polys[i].pts[n], bounds, nbounds))
+				ADD_RAY(i, ii, i, n);
+		}
+	}
+
+	/* 3: inter polygon rays with at least one end which is not static */
+	for (i=0; i<npolys-1; i++) {
+		for (pt1=0; pt1<polys[i].l; pt1++) {
+			if (!is_in_boundingbox(&polys[i].pts[pt1]))
+				continue;
+
+			for (ii=(i == 0 || i >= nstatic) ? i+1 : nstatic; ii<npolys; ii++) {
+				for (pt2=0; pt2<polys[ii].l; pt2++) {
+					if (!is_in_boundingbox(&polys[ii].pts[pt2]))
+						continue;
+
+					if (tangent_pruning && i != 0 &&
+					    !is_tangent_vertex(&polys[i], pt1, orient[i],
+							       &polys[ii].pts[pt2]))
+						continue;
+					if (tangent_pruning &&
+					    !is_tangent_vertex(&polys[ii], pt2, orient[ii],
+							       &polys[i].pts[pt1]))
+						continue;
+
+					if (is_ray_free(polys, 1, npolys, 0, polys[i].pts[pt1],
+							polys[ii].pts[pt2], bounds, nbounds))
+						ADD_RAY(i, pt1, ii, pt2);
+				}
+			}
+		}
+	}
+
+	return ray_n;
+}
+
+/*
+ * Rotational sweep construction of the visibility graph (Lee's
+ * algorithm).
+ *
+ * For each vertex a, the other vertices are sorted by angle around a,
+ * then a half line starting from a turns around it, stopping on each
+ * vertex. The obstacle edges crossed by the half line are kept in a
+ * balanced tree sorted by their distance to a, so a vertex is visible if
+ * the nearest edge is behind it. When the edges of two polygons cross,
+ * this order changes during the sweep, so all the crossed edges are
+ * tested instead of the nearest one.
  *
- * Note the +1 is a little hack to introduce a preference between to
- * possiblity path: If we have 3 checpoint aligned in a path (say A,
- * B, C) the algorithm will prefer (A, C) instead of (A, B, C) */
+ * Vertices are numbered from 0 to n-1, in polygon order. Edge number v
+ * goes from vertex v to the next vertex of its polygon.
+ */
+
+/* sweep state, shared with the qsort() callback */
+static const point_t *sweep_origin;
+static point_t **sweep_vpts;
+
+/* 0 for the angles in [0, pi[, 1 for [pi, 2pi[ */
+static uint8_t
+sweep_half(float dx, float dy)
+{
+	return (dy < 0 || (dy == 0 && dx < 0));
+}
+
+/* sort vertices by angle around sweep_origin, then by distance */
+static int
+sweep_cmp(const void *a, const void *b)
+{
+	const point_t *p = sweep_vpts[*(const uint16_t *)a];
+	const point_t *q = sweep_vpts[*(const uint16_t *)b];
+	float px = p->x - sweep_origin->x, py = p->y - sweep_origin->y;
+	float qx = q->x - sweep_origin->x, qy = q->y - sweep_origin->y;
+	uint8_t hp = sweep_half(px, py), hq = sweep_half(qx, qy);
+	float c;
+
+	if (hp != hq)
+		return hp - hq;
+	c = px * qy - py * qx;
+	if (c > 0)
+		return -1;
+	if (c < 0)
+		return 1;
+	c = (px * px + py * py) - (qx * qx + qy * qy);
+	if (c < 0)
+		return -1;
+	return c > 0;
+}
+
+/* > 0 if c is on the left of (a, b), < 0 on the right, 0 if aligned */
+static float
+sweep_orient(const point_t *a, const point_t *b, const point_t *c)
+{
+	return (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+}
+
+/* Position of the intersection of the ray (o, o + d) with the line of
+ * the edge (p, q), as a multiple of d. */
+static float
+sweep_edge_t(const point_t *o, float dx, float dy,
+	     const point_t *p, const point_t *q)
+{
+	float ex = q->x - p->x, ey = q->y - p->y;
+	float den = dx * ey - dy * ex;
+
+	if (den == 0)
+		return 1e30;
+	return ((p->x - o->x) * ey - (p->y - o->y) * ex) / den;
+}
+
+/* Returns 1 if the direction (dx, dy) from the vertex pt of pol goes
+ * strictly inside the polygon. */
+static uint8_t
+sweep_enters_poly(poly_t *pol, uint8_t pt, int8_t orient, float dx, float dy)
+{
+	const point_t *v = &pol->pts[pt];
+	const point_t *prev = &pol->pts[(pt + pol->l - 1) % pol->l];
+	const point_t *next = &pol->pts[(pt + 1) % pol->l];
+	float e1x, e1y, e2x, e2y, tmp;
+
+	if (pol->l <= 2)
+		return 0;
+
+	/* the inside of the polygon is the sector going counter
+	 * clockwise from e1 to e2 */
+	e1x = next->x - v->x; e1y = next->y - v->y;
+	e2x = prev->x - v->x; e2y = prev->y - v->y;
+	if (orient < 0) {
+		tmp = e1x; e1x = e2x; e2x = tmp;
+		tmp = e1y; e1y = e2y; e2y = tmp;
+	}
+
+	/* convex vertex, the sector is smaller than pi */
+	if (e1x * e2y - e1y * e2x >= 0)
+		return (e1x * dy - e1y * dx > 0) && (dx * e2y - dy * e2x > 0);
+
+	/* concave vertex: not in the (closed) outside sector */
+	return !((e2x * dy - e2y * dx >= 0) && (dx * e1y - dy * e1x >= 0));
+}
+
+/* Edges crossed by the sweep ray, in a treap ordered by their distance
+ * along the ray. The nodes are the edge numbers, nil (the number of
+ * vertices) is the empty child, and a node out of the tree has up set
+ * to nil + 1. The priorities are a hash of the node numbers. */
+struct sweep_tree {
+	uint16_t *left;
+	uint16_t *right;
+	uint16_t *up;
+	uint16_t root;
+	uint16_t nil;
+};
+
+static uint16_t
+sweep_prio(uint16_t x)
+{
+	return ((uint32_t)x * 2654435761u) >> 16;
+}
+
+/* rotates x above its parent */
+static void
+sweep_tree_rotate(struct sweep_tree *t, uint16_t x)
+{
+	uint16_t p = t->up[x], g = t->up[p];
+
+	if (t->left[p] == x) {
+		t->left[p] = t->right[x];
+		if (t->right[x] != t->nil)
+			t->up[t->right[x]] = p;
+		t->right[x] = p;
+	}
+	else {
+		t->right[p] = t->left[x];
+		if (t->left[x] != t->nil)
+			t->up[t->left[x]] = p;
+		t->left[x] = p;
+	}
+	t->up[p] = x;
+	t->up[x] = g;
+	if (g == t->nil)
+		t->root = x;
+	else if (t->left[g] == p)
+		t->left[g] = x;
+	else
+		t->right[g] = x;
+}
+
+/* inserts x as a child of parent (nil for the root), on its right side
+ * if right is 1 */
+static void
+sweep_tree_link(struct sweep_tree *t, uint16_t x, uint16_t parent, uint8_t right)
+{
+	t->left[x] = t->right[x] = t->nil;
+	t->up[x] = parent;
+	if (parent == t->nil)
+		t->root = x;
+	else if (right)
+		t->right[parent] = x;
+	else
+		t->left[parent] = x;
+
+	while (t->up[x] != t->nil && sweep_prio(x) > sweep_prio(t->up[x]))
+		sweep_tree_rotate(t, x);
+}
+
+static void
+sweep_tree_remove(struct sweep_tree *t, uint16_t x)
+{
+	uint16_t c, p;
+
+	/* push x down to a leaf */
+	while (t->left[x] != t->nil || t->right[x] != t->nil) {
+		if (t->left[x] == t->nil)
+			c = t->right[x];
+		else if (t->right[x] == t->nil)
+			c = t->left[x];
+		else if (sweep_prio(t->left[x]) > sweep_prio(t->right[x]))
+			c = t->left[x];
+		else
+			c = t->right[x];
+		sweep_tree_rotate(t, c);
+	}
+
+	p = t->up[x];
+	if (p == t->nil)
+		t->root = t->nil;
+	else if (t->left[p] == x)
+		t->left[p] = t->nil;
+	else
+		t->right[p] = t->nil;
+	t->up[x] = t->nil + 1;
+}
+
+/* nearest edge, nil if the tree is empty */
+static uint16_t
+sweep_tree_first(const struct sweep_tree *t)
+{
+	uint16_t x = t->root;
+
+	if (x == t->nil)
+		return x;
+	while (t->left[x] != t->nil)
+		x = t->left[x];
+	return x;
+}
+
+/* edge following x, nil at the end */
+static uint16_t
+sweep_tree_next(const struct sweep_tree *t, uint16_t x)
+{
+	if (t->right[x] != t->nil) {
+		x = t->right[x];
+		while (t->left[x] != t->nil)
+			x = t->left[x];
+		return x;
+	}
+	while (t->up[x] != t->nil && t->right[t->up[x]] == x)
+		x = t->up[x];
+	return t->up[x];
+}
+
+/* Returns 1 if two obstacle edges of different polygons touch or cross */
+static uint8_t
+sweep_edges_cross(const point_t *p, const point_t *q,
+		  const point_t *r, const point_t *s)
+{
+	float o1, o2, o3, o4;
+
+	if ((p->x < r->x && p->x < s->x && q->x < r->x && q->x < s->x) ||
+	    (p->x > r->x && p->x > s->x && q->x > r->x && q->x > s->x) ||
+	    (p->y < r->y && p->y < s->y && q->y < r->y && q->y < s->y) ||
+	    (p->y > r->y && p->y > s->y && q->y > r->y && q->y > s->y))
+		return 0;
+
+	o1 = sweep_orient(p, q, r);
+	o2 = sweep_orient(p, q, s);
+	o3 = sweep_orient(r, s, p);
+	o4 = sweep_orient(r, s, q);
+
+	if ((o1 > 0 && o2 > 0) || (o1 < 0 && o2 < 0))
+		return 0;
+	if ((o3 > 0 && o4 > 0) || (o3 < 0 && o4 < 0))
+		return 0;
+	return 1;
+}
+
+uint16_t
+calc_rays_sweep(poly_t *polys, uint8_t npolys, uint8_t *rays, uint16_t max_ray_n)
+{
+	uint16_t n = 0, i, j, k;
+	uint16_t ray_n = 0;
+
+	for (i=0; i<npolys; i++)
+		n += polys[i].l;
+
+	if (n == 0)
+		return 0;
+
+	{
+	uint8_t vpoly[n];      /* polygon of each vertex */
+	uint8_t vpt[n];        /* index of each vertex in its polygon */
+	uint16_t vfirst[n];    /* first vertex of the polygon of each vertex */
+	point_t *vpts[n];
+	uint8_t inside[n];     /* vertex strictly inside another obstacle */
+	uint16_t events[n];    /* vertices sorted by angle */
+	uint16_t tleft[n], tright[n], tup[n]; /* edges crossed by the sweep ray */
+	struct sweep_tree status;
+	int8_t orient[npolys];
+	uint16_t nev, a, v, w, u, e, prev, skip;
+	uint8_t ordered = 1, vis, prev_vis, blocked, pa, target, right;
+	uint16_t f, parent;
+	float dx, dy, t;
+
+#define NEXT(v) (vfirst[v] + (vpt[v] + 1) % polys[vpoly[v]].l)
+#define PREV(v) (vfirst[v] + (vpt[v] + polys[vpoly[v]].l - 1) % polys[vpoly[v]].l)
+	/* edge v exists if v belongs to an obstacle with at least 2
+	 * points, only one edge is used for segments */
+#define IS_EDGE(v) (vpoly[v] != 0 && polys[vpoly[v]].l >= 2 &&		\
+		    (polys[vpoly[v]].l > 2 || vpt[v] == 0))
+#define EDGE_T(e) sweep_edge_t(vpts[a], dx, dy, vpts[e], vpts[NEXT(e)])
+#define INCIDENT(e, v) ((e) == (v) || NEXT(e) == (v))
+
+	v = 0;
+	for (i=0; i<npolys; i++) {
+		orient[i] = poly_orientation(&polys[i]);
+		for (j=0; j<polys[i].l; j++) {
+			vpoly[v] = i;
+			vpt[v] = j;
+			vfirst[v] = v - j;
+			vpts[v] = &polys[i].pts[j];
+			v++;
+		}
+	}
+
+	for (v=0; v<n; v++) {
+		inside[v] = 0;
+		for (i=1; i<npolys; i++) {
+			if (i == vpoly[v])
+				continue;
+			if (is_in_poly(vpts[v], &polys[i]) == 1) {
+				inside[v] = 1;
+				break;
+			}
+		}
+	}
+
+	/* the order of the edges along the ray only stays valid if the
+	 * polygons do not overlap */
+	for (e=0; e<n && ordered; e++) {
+		if (!IS_EDGE(e))
+			continue;
+		for (k=e+1; k<n; k++) {
+			if (!IS_EDGE(k) || vpoly[k] == vpoly[e])
+				continue;
+			if (sweep_edges_cross(vpts[e], vpts[NEXT(e)],
+					      vpts[k], vpts[NEXT(k)])) {
+				ordered = 0;
+				break;
+			}
+		}
+	}
+
+	sweep_vpts = vpts;
+	status.left = tleft;
+	status.right = tright;
+	status.up = tup;
+	status.nil = n;
+
+	for (a=0; a<n; a++) {
+		i = vpoly[a];
+		pa = vpt[a];
+
+		/* the same filters as calc_rays() on the first end of
+		 * the rays */
+		if (!is_in_boundingbox(vpts[a]))
+			continue;
+		if (inside[a])
+			continue;
+		/* no ray starts from a concave vertex */
+		if (tangent_pruning && i != 0 &&
+		    !is_tangent_vertex(&polys[i], pa, orient[i], vpts[PREV(a)]))
+			continue;
+
+		/* sort the other vertices by angle */
+		nev = 0;
+		for (v=0; v<n; v++) {
+			if (v == a)
+				continue;
+			if (vpts[v]->x == vpts[a]->x && vpts[v]->y == vpts[a]->y)
+				continue;
+			events[nev++] = v;
+		}
+		sweep_origin = vpts[a];
+		qsort(events, nev, sizeof(uint16_t), sweep_cmp);
+
+		/* edges crossed by the initial half line (angle 0) */
+		status.root = n;
+		for (e=0; e<n; e++)
+			tup[e] = n + 1;
+		dx = 1;
+		dy = 0;
+		for (e=0; e<n; e++) {
+			const point_t *p, *q;
+
+			if (!IS_EDGE(e) || INCIDENT(e, a))
+				continue;
+			p = vpts[e];
+			q = vpts[NEXT(e)];
+			if ((p->x == vpts[a]->x && p->y == vpts[a]->y) ||
+			    (q->x == vpts[a]->x && q->y == vpts[a]->y))
+				continue;
+			/* it must go from the strictly lower half plane
+			 * to the upper one, or end on the half line */
+			if (!((p->y < vpts[a]->y && q->y >= vpts[a]->y) ||
+			      (q->y < vpts[a]->y && p->y >= vpts[a]->y)))
+				continue;
+			t = EDGE_T(e);
+			if (t <= 0)
+				continue;
+			parent = n;
+			right = 0;
+			for (f=status.root; f!=n; f=right ? tright[f] : tleft[f]) {
+				parent = f;
+				right = EDGE_T(f) <= t;
+			}
+			sweep_tree_link(&status, e, parent, right);
+		}
+
+		prev = 0;
+		prev_vis = 0;
+		for (j=0; j<nev; j++) {
+			w = events[j];
+			dx = vpts[w]->x - vpts[a]->x;
+			dy = vpts[w]->y - vpts[a]->y;
+
+			/* 1: is w visible from a ? */
+			skip = n;
+			vis = 1;
+			if (inside[w])
+				vis = 0;
+			else if (i != 0 && sweep_enters_poly(&polys[i], pa, orient[i], dx, dy))
+				vis = 0;
+			else if (vpoly[w] != 0 &&
+				 sweep_enters_poly(&polys[vpoly[w]], vpt[w], orient[vpoly[w]], -dx, -dy))
+				vis = 0;
+			/* the previous vertex is on the segment [a, w] */
+			else if (j > 0 && sweep_orient(vpts[a], vpts[prev], vpts[w]) == 0 &&
+				 sweep_half(vpts[prev]->x - vpts[a]->x, vpts[prev]->y - vpts[a]->y) ==
+				 sweep_half(dx, dy)) {
+				/* its edges do not hide w */
+				skip = prev;
+				if (!prev_vis)
+					vis = 0;
+				else if (vpoly[prev] != 0 &&
+					 sweep_enters_poly(&polys[vpoly[prev]], vpt[prev], orient[vpoly[prev]], dx, dy))
+					vis = 0;
+			}
+
+			if (vis) {
+				blocked = 0;
+				for (e=sweep_tree_first(&status); e!=n;
+				     e=sweep_tree_next(&status, e)) {
+					if (INCIDENT(e, w) || (skip != n && INCIDENT(e, skip)))
+						continue;
+					if (EDGE_T(e) < 1 - 1e-5)
+						blocked = 1;
+					/* the other edges are further */
+					if (ordered)
+						break;
+				}
+				if (blocked)
+					vis = 0;
+			}
+
+			/* 2: add the ray if w is a wanted end */
+			if (vpoly[w] == i) {
+				/* edge of the polygon, computed once for
+				 * segments */
+				target = (w == NEXT(a)) && (polys[i].l > 2 || pa == 0);
+				if (target && tangent_pruning && i != 0 &&
+				    !is_tangent_vertex(&polys[i], vpt[w], orient[i], vpts[a]))
+					target = 0;
+			}
+			else {
+				target = vpoly[w] > i;
+				if (target && tangent_pruning && i != 0 &&
+				    !is_tangent_vertex(&polys[i], pa, orient[i], vpts[w]))
+					target = 0;
+				if (target && tangent_pruning &&
+				    !is_tangent_vertex(&polys[vpoly[w]], vpt[w], orient[vpoly[w]], vpts[a]))
+					target = 0;
+			}
+			if (target && vis && is_in_boundingbox(vpts[w]))
+				ADD_RAY(i, pa, vpoly[w], vpt[w]);
+
+			/* 3: update the edges crossed by the ray: the
+			 * ones on the clockwise side of the ray end on
+			 * w, the ones on the other side start here */
+			for (k=0; k<2; k++) {
+				e = k ? PREV(w) : w;
+				if (!IS_EDGE(e) || INCIDENT(e, a))
+					continue;
+				u = (e == w) ? NEXT(e) : e;
+				if (vpts[u]->x == vpts[a]->x && vpts[u]->y == vpts[a]->y)
+					continue;
+				if (sweep_orient(vpts[a], vpts[w], vpts[u]) >= 0)
+					continue;
+
+				if (tup[e] == n + 1)
+					continue;
+				sweep_tree_remove(&status, e);
+			}
+			for (k=0; k<2; k++) {
+				e = k ? PREV(w) : w;
+				if (!IS_EDGE(e) || INCIDENT(e, a))
+					continue;
+				u = (e == w) ? NEXT(e) : e;
+				if (vpts[u]->x == vpts[a]->x && vpts[u]->y == vpts[a]->y)
+					continue;
+				if (sweep_orient(vpts[a], vpts[w], vpts[u]) <= 0)
+					continue;
+
+				/* the order is not used when the
+				 * edges cross */
+				if (!ordered) {
+					sweep_tree_link(&status, e, sweep_tree_first(&status), 0);
+					continue;
+				}
+
+				/* search of the position of e; between
+				 * two edges starting at w, the nearest
+				 * one is on the same side of the other
+				 * as a */
+				parent = n;
+				right = 0;
+				for (f=status.root; f!=n; f=right ? tright[f] : tleft[f]) {
+					parent = f;
+					t = EDGE_T(f);
+					right = t < 1 - 1e-5 ||
+						(t <= 1 + 1e-5 && INCIDENT(f, w) &&
+						 (sweep_orient(vpts[w], vpts[u], vpts[f == w ? NEXT(w) : f]) > 0) ==
+						 (sweep_orient(vpts[w], vpts[u], vpts[a]) > 0));
+				}
+				sweep_tree_link(&status, e, parent, right);
+			}
+
+			prev = w;
+			prev_vis = vis;
+		}
+	}
+
+#undef NEXT
+#undef PREV
+#undef IS_EDGE
+#undef EDGE_T
+#undef INCIDENT
+	}
+
+	return ray_n;
+}
+
+#undef ADD_RAY
+
+/* Compute the weight of every rays: the length of the rays is used
+ * here. */
 void 
 calc_rays_weight(poly_t *polys, __attribute__((unused)) uint8_t npolys,
-		 uint8_t *rays, uint8_t ray_n, uint16_t *weight)
+		 uint8_t *rays, uint16_t ray_n, float *weight)
 {
-	uint8_t i;
+	uint16_t i;
 	vect_t v;
 
 	for (i=0;i<ray_n;i+=4) {
 	        v.x = polys[rays[i]].pts[rays[i+1]].x - polys[rays[i+2]].pts[rays[i+3]].x;
 	        v.y = polys[rays[i]].pts[rays[i+1]].y - polys[rays[i+2]].pts[rays[i+3]].y;
-		weight[i/4] = vect_norm(&v) + 1;
+		weight[i/4] = vect_norm(&v);
 	}	
 }
 
+/* Number of sign changes of a coordinate along the boundary, 2 for a
+ * convex polygon. */
+static uint8_t
+direction_changes(poly_t *pol, uint8_t y)
+{
+	uint8_t i, n = 0;
+	int8_t sign = 0, s;
+	float d;
+
+	for (i=0; i<pol->l; i++) {
+		d = y ? pol->pts[(i+1)%pol->l].y - pol->pts[i].y :
+			pol->pts[(i+1)%pol->l].x - pol->pts[i].x;
+		if (d == 0)
+			continue;
+		s = d > 0 ? 1 : -1;
+		if (sign != 0 && s != sign)
+			n++;
+		sign = s;
+	}
+	/* wrap around, with the first non zero direction */
+	for (i=0; i<pol->l; i++) {
+		d = y ? pol->pts[(i+1)%pol->l].y - pol->pts[i].y :
+			pol->pts[(i+1)%pol->l].x - pol->pts[i].x;
+		if (d != 0) {
+			if ((d > 0 ? 1 : -1) != sign)
+				n++;
+			break;
+		}
+	}
+	return n;
+}
+
+int8_t
+cost_region_update(cost_region_t *r)
+{
+	uint8_t i;
+	double o;
+
+	r->orient = poly_orientation(&r->poly);
+
+	/* convex: every vertex turns the same way, and the boundary goes
+	 * around only once (not a star) */
+	for (i=0; i<r->poly.l; i++) {
+		o = orient(&r->poly.pts[i], &r->poly.pts[(i+1)%r->poly.l],
+			   &r->poly.pts[(i+2)%r->poly.l]);
+		if (o * r->orient < 0)
+			return -1;
+	}
+	if (direction_changes(&r->poly, 0) > 2 ||
+	    direction_changes(&r->poly, 1) > 2)
+		return -1;
+
+	r->xmin = r->xmax = r->poly.pts[0].x;
+	r->ymin = r->ymax = r->poly.pts[0].y;
+	for (i=1; i<r->poly.l; i++) {
+		if (r->poly.pts[i].x < r->xmin) r->xmin = r->poly.pts[i].x;
+		if (r->poly.pts[i].x > r->xmax) r->xmax = r->poly.pts[i].x;
+		if (r->poly.pts[i].y < r->ymin) r->ymin = r->poly.pts[i].y;
+		if (r->poly.pts[i].y > r->ymax) r->ymax = r->poly.pts[i].y;
+	}
+	return 0;
+}
+
+float
+cost_region_overlap(const cost_region_t *r, point_t p1, point_t p2)
+{
+	uint8_t i, n;
+	float t_in = 0, t_out = 1, t;
+	float num, den, nx, ny;
+	vect_t d;
+
+	d.x = p2.x - p1.x;
+	d.y = p2.y - p1.y;
+
+	for (i=0; i<r->poly.l; i++) {
+		n = (i+1)%r->poly.l;
+		/* inward normal of the edge */
+		nx = -(r->poly.pts[n].y - r->poly.pts[i].y) * r->orient;
+		ny = (r->poly.pts[n].x - r->poly.pts[i].x) * r->orient;
+
+		/* the point p1 + t.d is inside the edge when num + t.den >= 0 */
+		num = nx * (p1.x - r->poly.pts[i].x) + ny * (p1.y - r->poly.pts[i].y);
+		den = nx * d.x + ny * d.y;
+
+		if (den == 0) {
+			/* parallel to the edge */
+			if (num < 0)
+				return 0;
+			continue;
+		}
+
+		t = -num / den;
+		if (den > 0) {
+			if (t > t_in)
+				t_in = t;
+		}
+		else if (t < t_out)
+			t_out = t;
+
+		if (t_in >= t_out)
+			return 0;
+	}
+
+	return (t_out - t_in) * vect_norm(&d);
+}
+
+void
+calc_rays_weight_regions(poly_t *polys, uint8_t npolys, uint8_t *rays,
+			 uint16_t ray_n, const cost_region_t *regions,
+			 uint8_t nregions, float *weight)
+{
+	uint16_t i;
+	uint8_t r;
+	point_t p1, p2;
+	float xmin, xmax, ymin, ymax;
+
+	calc_rays_weight(polys, npolys, rays, ray_n, weight);
+	if (nregions == 0)
+		return;
+
+	for (i=0;i<ray_n;i+=4) {
+		p1 = polys[rays[i]].pts[rays[i+1]];
+		p2 = polys[rays[i+2]].pts[rays[i+3]];
+		xmin = p1.x < p2.x ? p1.x : p2.x;
+		xmax = p1.x < p2.x ? p2.x : p1.x;
+		ymin = p1.y < p2.y ? p1.y : p2.y;
+		ymax = p1.y < p2.y ? p2.y : p1.y;
+
+		for (r=0; r<nregions; r++) {
+			if (regions[r].poly.l < 3 ||
+			    xmax < regions[r].xmin || xmin > regions[r].xmax ||
+			    ymax < regions[r].ymin || ymin > regions[r].ymax)
+				continue;
+			weight[i/4] += (regions[r].factor - 1) *
+				cost_region_overlap(&regions[r], p1, p2);
+		}
+	}
+}
+
 
 
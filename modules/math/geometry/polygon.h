@@ -35,7 +35,19 @@ typedef struct _poly {
 	uint8_t l;      /**< Length of the array of points */
 } poly_t;
 
+/** A convex region where the cost of a ray is its length scaled by a
+ * factor, instead of an obstacle. */
+typedef struct _cost_region {
+	poly_t poly;    /**< Convex polygon of the region. */
+	float factor;   /**< Cost of 1 mm inside the region, in mm. */
+	int8_t orient;  /**< Orientation of the polygon, set by cost_region_update(). */
+	float xmin, ymin, xmax, ymax; /**< Bounding box, set by cost_region_update(). */
+} cost_region_t;
+
 /** Checks if a point belongs to a polygon
+ *
+ * Winding number test, the polygon can be concave and in any
+ * orientation, but its edges must not cross each other.
  * @param [in] *p Point to check
  * @param [in] *pol Polygon to check
  * @return 0 if outside, 1 if inside, 2 if on edge.
@@ -43,6 +55,56 @@ typedef struct _poly {
  */
 uint8_t is_in_poly(const point_t *p, poly_t *pol);
 
+/** Checks if a point belongs to a convex polygon
+ *
+ * Faster than is_in_poly() as it returns at the first edge having the
+ * point outside, but only valid for convex polygons whose vertices are
+ * counter clockwise.
+ * @param [in] *p Point to check
+ * @param [in] *pol Polygon to check
+ * @return 0 if outside, 1 if inside, 2 if on edge.
+ */
+uint8_t is_in_convex_poly(const point_t *p, poly_t *pol);
+
+/** Slab decomposition of a polygon, for O(log n) point queries.
+ *
+ * The horizontal lines through the vertices cut the plane into slabs.
+ * Inside a slab no edge ends, so the edges crossing it can be sorted
+ * from left to right once: a query finds the slab, then the number of
+ * edges on the left of the point, by two binary searches. */
+typedef struct _poly_slabs {
+	poly_t *poly;     /**< Decomposed polygon. */
+	float *ys;        /**< Limits of the slabs, increasing, n + 1 values. */
+	uint16_t *first;  /**< Offset in edges of the edges of each slab, n + 1 values. */
+	uint8_t *edges;   /**< Edges crossing the slabs from left to right, edge i
+			   * going from vertex i to vertex i + 1. */
+	uint8_t n;        /**< Number of slabs. */
+} poly_slabs_t;
+
+/** Size of the buffer needed by poly_slabs_build() for a polygon of l
+ * vertices, in bytes. It grows as l^2, 66 kB for 255 vertices. */
+#define POLY_SLABS_SIZE(l) (4UL * (l) + 2UL * ((l) + 1) + (unsigned long)(l) * (l) + 4)
+
+/** Builds the slab decomposition of a polygon.
+ *
+ * The polygon must not change while the decomposition is used. This
+ * takes O(n^2 log n) time, it is worth it for big polygons tested many
+ * times (a concave table element in a distance map for example).
+ * @param [out] *s The decomposition
+ * @param [in] *pol Polygon, see is_in_poly()
+ * @param [in] *buf Storage of the decomposition, aligned on 4 bytes
+ * @param [in] size Size of buf, at least POLY_SLABS_SIZE(pol->l)
+ * @return 0 on success, -1 if buf is too small
+ */
+int8_t poly_slabs_build(poly_slabs_t *s, poly_t *pol, void *buf, uint32_t size);
+
+/** Same as is_in_poly(), with a slab decomposition.
+ * @param [in] *s The decomposition, see poly_slabs_build()
+ * @param [in] *p Point to check
+ * @return 0 if outside, 1 if inside, 2 if on edge.
+ */
+uint8_t poly_slabs_is_in(const poly_slabs_t *s, const point_t *p);
+
 /** Checks if a point belongs to a polygon
  * @param [in] *pol Polygon to check
  * @param [in] *x x-coordinate of point to check
@@ -56,9 +118,10 @@ uint8_t is_point_in_poly(poly_t *pol, int16_t x, int16_t y);
   * @param [in] p1, p2 The two points defining the segment.
   * @param [in] pol The polygon to check.
   * @param [out] intersect_pt Contains the intersection point.
-  * @returns 0 dont cross, 1 cross, 2 on a side,
-  *  3 touch out (a segment boundary is on a polygon edge, 
-  *  and the second segment boundary is out of the polygon) */
+  * @returns 0 dont cross, 1 cross (including through the inside of a
+  *  concave polygon after running along an edge), 2 on a side (along
+  *  an edge, without entering), 3 touch out (a segment boundary is on a
+  *  polygon edge, and the second segment boundary is out of the polygon) */
 uint8_t 
 is_crossing_poly(point_t p1, point_t p2, point_t *intersect_pt,
 		 poly_t *pol);
@@ -71,6 +134,24 @@ is_crossing_poly(point_t p1, point_t p2, point_t *intersect_pt,
  */
 void polygon_set_boundingbox(int32_t x1, int32_t y1, int32_t x2, int32_t y2);
 
+/** Get coordinates of bounding box, see polygon_set_boundingbox(). */
+void polygon_get_boundingbox(int32_t *x1, int32_t *y1, int32_t *x2, int32_t *y2);
+
+/** Enables or disables the tangent graph pruning in calc_rays().
+ *
+ * When enabled (default), calc_rays() only keeps the rays that can be
+ * part of a shortest path: rays starting from non concave vertices and
+ * tangent to the polygons at both ends. When the weight of a ray is its
+ * length, it does not change the shortest path but gives a much smaller
+ * graph. With other weights (cost regions), the best path may bend where
+ * a ray is not tangent, so the pruning must be disabled.
+ * @param [in] enable 1 to enable the pruning, 0 to keep all the rays.
+ */
+void polygon_set_tangent_pruning(uint8_t enable);
+
+/** Returns 1 if the tangent graph pruning is enabled. */
+uint8_t polygon_get_tangent_pruning(void);
+
 /** Checks if a point is in the bounding box.
  * @param [in] *p Point to check
  * @return 1 if p is in the bounding box. */
@@ -96,18 +177,69 @@ uint8_t is_in_boundingbox(const point_t *p);
  * @param [in] *polys List of polygons
  * @param [in] npolys Number of polygons in the list
  * @param [out] *rays Rays (WTFBBQ?)
- * @return Number of rays
+ * @param [in] max_ray_n Size of rays, in bytes.
+ * @return Number of bytes written in rays (4 per ray), or max_ray_n + 1
+ * if the rays do not fit
  */
 
-uint8_t 
-calc_rays(poly_t *polys, uint8_t npolys, uint8_t *rays);
+uint32_t 
+calc_rays(poly_t *polys, uint8_t npolys, uint8_t *rays, uint32_t max_ray_n);
+
+/** @brief Constructs the visibility ray graph with a rotational sweep.
+ *
+ * Gives the same rays as calc_rays() (same format, but not the same
+ * order) in O(n^2 log(n)) instead of O(n^3), where n is the total
+ * number of vertices: the edges crossed by the sweep ray are kept in a
+ * treap, whose operations take O(log(n)) on average. When obstacles
+ * overlap, each visibility test is linear in the number of edges
+ * crossing the ray instead of logarithmic, so the bound is O(n^3).
+ *
+ * Work arrays are allocated on the stack, about 20 bytes per vertex.
+ *
+ * @param [in] *polys List of polygons
+ * @param [in] npolys Number of polygons in the list
+ * @param [out] *rays Rays, see calc_rays()
+ * @param [in] max_ray_n Size of rays, in bytes, see calc_rays()
+ * @return Number of bytes written in rays (4 per ray), or max_ray_n + 1
+ * if the rays do not fit
+ */
+uint16_t
+calc_rays_sweep(poly_t *polys, uint8_t npolys, uint8_t *rays, uint16_t max_ray_n);
+
+/** @brief Constructs the visibility ray graph from precomputed static rays.
+ *
+ * The polygons 1 to nstatic-1 are static obstacles, whose rays
+ * static_rays were computed once with calc_rays() (see the oa_map
+ * module). Only the rays having an end on the start/stop polygon or on
+ * the other polygons are computed, and the static rays are only tested
+ * against the polygons nstatic to npolys-1. The result contains the
+ * same rays as calc_rays() with the same tangent pruning and bounding
+ * box, in another order.
+ *
+ * @param [in] *polys List of polygons
+ * @param [in] npolys Number of polygons in the list
+ * @param [in] nstatic Index of the first polygon which is not static
+ * @param [in] *static_rays Rays between the static polygons, see calc_rays()
+ * @param [in] static_ray_n Number of bytes in static_rays (4 per ray)
+ * @param [in] *bounds Bounding boxes of the polygons 0 to nstatic-1, as 4
+ * arrays of nstatic floats: xmin, ymin, xmax, ymax. Only used to skip the
+ * crossing tests, can be NULL.
+ * @param [out] *rays Rays, see calc_rays()
+ * @param [in] max_ray_n Size of rays, in bytes
+ * @return Number of bytes written in rays (4 per ray), or max_ray_n + 1
+ * if the rays do not fit
+ */
+uint16_t
+calc_rays_static(poly_t *polys, uint8_t npolys, uint8_t nstatic,
+		 const uint8_t *static_rays, uint16_t static_ray_n,
+		 const float *bounds, uint8_t *rays, uint16_t max_ray_n);
 
 /** Compute the weight of every rays: the length of the rays is used
  * here. 
  *
- * @note The +1 is a little hack to introduce a preference between two
- * possiblity path: If we have 3 checkpoints aligned in a path (say A,
- * B, C) the algorithm will prefer (A, C) instead of (A, B, C) 
+ * @note The weight is the plain length in mm. Costs that do not depend
+ * only on the ray (number of checkpoints, turns) are added by the path
+ * search.
  * @param [in] *polys Array of polygons
  * @param [in] npolys Number of polygons in the array
  * @param [in] *rays Array of the rays
@@ -116,7 +248,37 @@ calc_rays(poly_t *polys, uint8_t npolys, uint8_t *rays);
  * */
 void 
 calc_rays_weight(poly_t *polys, uint8_t npolys, uint8_t *rays, 
-		 uint8_t ray_n, uint16_t *weight);
+		 uint16_t ray_n, float *weight);
+
+/** Precomputes the orientation and the bounding box of a cost region,
+ * to call after its vertices changed.
+ * @return 0 on success, -1 if the polygon is not convex: the overlap
+ * computed by cost_region_overlap() would be wrong. */
+int8_t cost_region_update(cost_region_t *r);
+
+/** Length of the part of the segment (p1, p2) inside a cost region.
+ *
+ * Cyrus-Beck clipping of the segment against the edges of the convex
+ * polygon.
+ * @param [in] *r The region, see cost_region_update()
+ * @return The length in mm, 0 if the segment does not cross the region
+ */
+float cost_region_overlap(const cost_region_t *r, point_t p1, point_t p2);
+
+/** Same as calc_rays_weight(), the part of each ray inside a cost
+ * region being weighted by the factor of the region. The overlaps of
+ * regions add up.
+ *
+ * The path still only turns at the vertices of the obstacles, so it
+ * goes around a region when an obstacle vertex allows it, but does not
+ * follow the region boundaries.
+ * @param [in] *regions Array of regions, see cost_region_update()
+ * @param [in] nregions Number of regions
+ */
+void
+calc_rays_weight_regions(poly_t *polys, uint8_t npolys, uint8_t *rays,
+			 uint16_t ray_n, const cost_region_t *regions,
+			 uint8_t nregions, float *weight);
  
 /** @} */
 #endif
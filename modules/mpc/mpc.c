@@ -0,0 +1,294 @@
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <mpc.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/** Number of power iterations per period to update the step size. */
+#define MPC_POWER_ITERATIONS 3
+
+/** Margin on the estimated Lipschitz constant. */
+#define MPC_LIPSCHITZ_MARGIN 1.25
+
+static float mpc_wrap(float a) {
+    while (a > M_PI)
+        a -= 2 * M_PI;
+    while (a < -M_PI)
+        a += 2 * M_PI;
+    return a;
+}
+
+void mpc_init(struct mpc *m, uint8_t horizon, float period) {
+    memset(m, 0, sizeof(struct mpc));
+
+    if (horizon > MPC_MAX_HORIZON)
+        horizon = MPC_MAX_HORIZON;
+    if (horizon < 1)
+        horizon = 1;
+
+    m->horizon = horizon;
+    m->period = period;
+    m->iterations = 20;
+
+    mpc_set_weights(m, 1., 1000., 1e-4, 1e-1);
+    mpc_set_limits(m, 1000., 2 * M_PI, 1000.);
+    mpc_set_consign_scale(m, 1., 1.);
+    mpc_start(m, 0., 0.);
+}
+
+void mpc_set_weights(struct mpc *m, float q_pos, float q_angle, float r_v, float r_w) {
+    m->q_pos = q_pos;
+    m->q_angle = q_angle;
+    m->r_v = r_v;
+    m->r_w = r_w;
+}
+
+void mpc_set_limits(struct mpc *m, float v_max, float w_max, float acc) {
+    m->v_max = v_max;
+    m->w_max = w_max;
+    m->acc = acc;
+}
+
+void mpc_set_iterations(struct mpc *m, uint8_t iterations) {
+    m->iterations = iterations;
+}
+
+void mpc_set_consign_scale(struct mpc *m, float d_scale, float a_scale) {
+    m->d_scale = d_scale;
+    m->a_scale = a_scale;
+}
+
+void mpc_set_path(struct mpc *m, const point_t *path, uint8_t n, float speed) {
+    uint8_t i;
+
+    m->path = path;
+    m->path_len = n;
+    m->path_speed = speed;
+    m->s = 0.;
+    m->seg = 0;
+    m->seg_s = 0.;
+
+    m->path_total = 0.;
+    for (i = 1; i < n; i++)
+        m->path_total += hypotf(path[i].x - path[i - 1].x, path[i].y - path[i - 1].y);
+}
+
+void mpc_start(struct mpc *m, float d_consign, float a_consign) {
+    uint8_t k;
+
+    m->d_consign = d_consign;
+    m->a_consign = a_consign;
+    m->v = 0.;
+    m->w = 0.;
+
+    for (k = 0; k < MPC_MAX_HORIZON; k++) {
+        m->u[k][0] = 0.;
+        m->u[k][1] = 0.;
+        m->power[k][0] = 1.;
+        m->power[k][1] = 1.;
+    }
+    m->lipschitz = 0.;
+}
+
+uint8_t mpc_path_finished(struct mpc *m) {
+    return m->path == NULL || m->s >= m->path_total;
+}
+
+/** Fills the reference over the horizon by moving along the path. */
+static void mpc_fill_reference(struct mpc *m) {
+    const point_t *p = m->path;
+    uint8_t seg = m->seg, k;
+    float seg_s = m->seg_s, s = m->s;
+    float len, t, v, heading = 0.;
+
+    for (k = 0; k <= m->horizon; k++) {
+        /* Find the segment containing s, skipping empty ones. */
+        for (;;) {
+            len = hypotf(p[seg + 1].x - p[seg].x, p[seg + 1].y - p[seg].y);
+            if (seg_s + len >= s || seg + 2 >= m->path_len)
+                break;
+            seg_s += len;
+            seg++;
+        }
+
+        if (len > 0.)
+            heading = atan2f(p[seg + 1].y - p[seg].y, p[seg + 1].x - p[seg].x);
+
+        t = (len > 0.) ? (s - seg_s) / len : 1.;
+        if (t > 1.)
+            t = 1.;
+
+        m->ref[k].x = p[seg].x + t * (p[seg + 1].x - p[seg].x);
+        m->ref[k].y = p[seg].y + t * (p[seg + 1].y - p[seg].y);
+        m->ref[k].a = heading;
+
+        /* Cruise speed, then decelerate to stop on the last point. */
+        v = m->path_speed;
+        if (s >= m->path_total)
+            v = 0.;
+        else if (2 * m->acc * (m->path_total - s) < v * v)
+            v = sqrtf(2 * m->acc * (m->path_total - s));
+        m->ref[k].v = v;
+
+        if (k == 0) {
+            m->seg = seg;
+            m->seg_s = seg_s;
+        }
+
+        s += v * m->period;
+        if (s > m->path_total)
+            s = m->path_total;
+    }
+
+    for (k = 0; k < m->horizon; k++)
+        m->ref[k].w = mpc_wrap(m->ref[k + 1].a - m->ref[k].a) / m->period;
+    m->ref[m->horizon].w = 0.;
+}
+
+/** Computes the gradient of the cost for the corrections u, starting from
+ * the error e0 (forward simulation of the linearized model, then backward
+ * propagation of the adjoint state). */
+static void mpc_gradient(struct mpc *m, float (*u)[2], const float *e0, float (*g)[2]) {
+    float T = m->period, vt;
+    float lx, ly, la;
+    int8_t k;
+
+    m->e[0][0] = e0[0];
+    m->e[0][1] = e0[1];
+    m->e[0][2] = e0[2];
+
+    for (k = 0; k < m->horizon; k++) {
+        vt = m->ref[k].v * T;
+        m->e[k + 1][0] = m->e[k][0] - vt * m->sin_a[k] * m->e[k][2] + T * m->cos_a[k] * u[k][0];
+        m->e[k + 1][1] = m->e[k][1] + vt * m->cos_a[k] * m->e[k][2] + T * m->sin_a[k] * u[k][0];
+        m->e[k + 1][2] = m->e[k][2] + T * u[k][1];
+    }
+
+    lx = m->q_pos * m->e[m->horizon][0];
+    ly = m->q_pos * m->e[m->horizon][1];
+    la = m->q_angle * m->e[m->horizon][2];
+
+    for (k = m->horizon - 1; k >= 0; k--) {
+        g[k][0] = m->r_v * u[k][0] + T * (m->cos_a[k] * lx + m->sin_a[k] * ly);
+        g[k][1] = m->r_w * u[k][1] + T * la;
+
+        if (k > 0) {
+            vt = m->ref[k].v * T;
+            la += vt * (m->cos_a[k] * ly - m->sin_a[k] * lx) + m->q_angle * m->e[k][2];
+            lx += m->q_pos * m->e[k][0];
+            ly += m->q_pos * m->e[k][1];
+        }
+    }
+}
+
+/** Updates the estimate of the largest eigenvalue of the Hessian, which
+ * gives the step of the gradient iterations. */
+static void mpc_update_lipschitz(struct mpc *m) {
+    const float zero[3] = {0., 0., 0.};
+    float norm, hnorm = 0.;
+    uint8_t i, k;
+
+    for (i = 0; i < MPC_POWER_ITERATIONS; i++) {
+        /* Without the initial error, the gradient is the Hessian times u. */
+        mpc_gradient(m, m->power, zero, m->grad);
+
+        norm = 0.;
+        hnorm = 0.;
+        for (k = 0; k < m->horizon; k++) {
+            norm += m->power[k][0] * m->power[k][0] + m->power[k][1] * m->power[k][1];
+            hnorm += m->grad[k][0] * m->grad[k][0] + m->grad[k][1] * m->grad[k][1];
+        }
+        if (hnorm == 0.)
+            break;
+
+        hnorm = sqrtf(hnorm / norm);
+        for (k = 0; k < m->horizon; k++) {
+            m->power[k][0] = m->grad[k][0] / hnorm;
+            m->power[k][1] = m->grad[k][1] / hnorm;
+        }
+    }
+
+    m->lipschitz = MPC_LIPSCHITZ_MARGIN * hnorm;
+}
+
+static float mpc_clamp(float x, float lo, float hi) {
+    if (x < lo)
+        return lo;
+    if (x > hi)
+        return hi;
+    return x;
+}
+
+/** Solves the QP with a fixed number of fast projected gradient steps. */
+static void mpc_solve(struct mpc *m, const float *e0) {
+    float t = 1., tn, beta, un, step;
+    uint8_t it, k, j;
+    float lo[2], hi[2];
+
+    /* Warm start: the previous solution, one period later. */
+    for (k = 0; k + 1 < m->horizon; k++) {
+        m->u[k][0] = m->u[k + 1][0];
+        m->u[k][1] = m->u[k + 1][1];
+    }
+
+    for (k = 0; k < m->horizon; k++) {
+        m->cos_a[k] = cosf(m->ref[k].a);
+        m->sin_a[k] = sinf(m->ref[k].a);
+    }
+
+    mpc_update_lipschitz(m);
+    if (m->lipschitz <= 0.)
+        return;
+    step = 1. / m->lipschitz;
+
+    memcpy(m->ua, m->u, sizeof(m->u));
+
+    for (it = 0; it < m->iterations; it++) {
+        mpc_gradient(m, m->ua, e0, m->grad);
+
+        tn = (1. + sqrtf(1. + 4. * t * t)) / 2.;
+        beta = (t - 1.) / tn;
+        t = tn;
+
+        for (k = 0; k < m->horizon; k++) {
+            lo[0] = -m->v_max - m->ref[k].v;
+            hi[0] = m->v_max - m->ref[k].v;
+            lo[1] = -m->w_max - m->ref[k].w;
+            hi[1] = m->w_max - m->ref[k].w;
+
+            for (j = 0; j < 2; j++) {
+                un = mpc_clamp(m->ua[k][j] - step * m->grad[k][j], lo[j], hi[j]);
+                m->ua[k][j] = un + beta * (un - m->u[k][j]);
+                m->u[k][j] = un;
+            }
+        }
+    }
+}
+
+void mpc_update(struct mpc *m, float x, float y, float a) {
+    float e0[3];
+
+    if (m->path != NULL && m->path_len >= 2)
+        mpc_fill_reference(m);
+
+    e0[0] = x - m->ref[0].x;
+    e0[1] = y - m->ref[0].y;
+    e0[2] = mpc_wrap(a - m->ref[0].a);
+
+    mpc_solve(m, e0);
+
+    m->v = mpc_clamp(m->ref[0].v + m->u[0][0], -m->v_max, m->v_max);
+    m->w = mpc_clamp(m->ref[0].w + m->u[0][1], -m->w_max, m->w_max);
+
+    m->d_consign += m->v * m->period * m->d_scale;
+    m->a_consign += m->w * m->period * m->a_scale;
+
+    if (m->path != NULL && m->path_len >= 2) {
+        m->s += m->ref[0].v * m->period;
+        if (m->s > m->path_total)
+            m->s = m->path_total;
+    }
+}
@@ -0,0 +1,178 @@
+/** @file modules/mpc/mpc.h
+ * @author CVRA
+ * @brief Model predictive path tracking for a 2 wheeled robot.
+ *
+ * The feedback of trajectory_manager_xy_event() only looks at the current
+ * target point, so the robot overshoots when the path turns. This module
+ * looks a few periods ahead: at each period it computes the speeds which
+ * minimize the tracking error over the next N periods, applies the first
+ * one, and starts again at the next period.
+ *
+ * The robot is modelled as a unicycle, linearized around the reference
+ * trajectory (x_r, y_r, a_r, v_r, w_r):
+ *
+ * e(k+1) = A(k) e(k) + B(k) u(k)
+ *
+ * where e is the position and angle error and u the deviation from the
+ * reference speeds. The cost is the sum of q_pos (ex^2 + ey^2) +
+ * q_angle ea^2 + r_v uv^2 + r_w uw^2 over the horizon, and the speeds are
+ * bounded by v_max and w_max.
+ *
+ * This box constrained QP is solved by a fixed number of accelerated
+ * projected gradient iterations. Each gradient is computed by simulating
+ * the model forward and its adjoint backward, in O(N), so the work per
+ * period is O(iterations * N) and does not depend on the data. The
+ * previous solution, shifted by one period, is used as the starting point,
+ * which is usually close to the optimum. All the memory is in the
+ * struct mpc instance.
+ *
+ * The outputs are the absolute distance and angle consigns of the control
+ * systems, integrated from the commanded speeds:
+ * @code
+ * mpc_init(&mpc, 15, 0.01);
+ * mpc_set_limits(&mpc, 1000., 6., 1500.);
+ * mpc_set_path(&mpc, path, path_len, 800.);
+ * mpc_start(&mpc, rs_get_distance(&rs), rs_get_angle(&rs));
+ *
+ * // every period
+ * mpc_update(&mpc, x, y, a);
+ * cs_set_consign(&csm_distance, mpc.d_consign);
+ * cs_set_consign(&csm_angle, mpc.a_consign);
+ * @endcode
+ *
+ * The consigns already respect the speed limits, so the quadramps of the
+ * control systems must be set to a higher limit, or disabled.
+ *
+ * @sa tools/mpc_bench for the execution time.
+ */
+
+#ifndef _MPC_H_
+#define _MPC_H_
+
+#include <stdint.h>
+#include <vect_base.h>
+
+/** Maximal number of periods of the horizon. */
+#define MPC_MAX_HORIZON 20
+
+/** A point of the reference trajectory. */
+struct mpc_ref {
+    float x, y;         /**< Position, in mm. */
+    float a;            /**< Heading, in rad. */
+    float v;            /**< Speed, in mm/s. */
+    float w;            /**< Angular speed, in rad/s. */
+};
+
+/** A model predictive tracker instance. */
+struct mpc {
+    uint8_t horizon;    /**< Number of periods predicted. */
+    float period;       /**< Control period, in s. */
+    uint8_t iterations; /**< Number of gradient iterations per period. */
+
+    float q_pos;        /**< Weight of the position errors, in 1/mm^2. */
+    float q_angle;      /**< Weight of the angle error, in 1/rad^2. */
+    float r_v;          /**< Weight of the speed corrections, in s^2/mm^2. */
+    float r_w;          /**< Weight of the angular speed corrections, in s^2/rad^2. */
+
+    float v_max;        /**< Maximal speed, in mm/s. */
+    float w_max;        /**< Maximal angular speed, in rad/s. */
+    float acc;          /**< Deceleration of the reference at the end of the path, in mm/s^2. */
+
+    float d_scale;      /**< Distance consign units per mm. */
+    float a_scale;      /**< Angle consign units per rad. */
+
+    const point_t *path; /**< Path to follow, NULL if there is none. */
+    uint8_t path_len;   /**< Number of points of the path. */
+    float path_speed;   /**< Cruise speed on the path, in mm/s. */
+    float path_total;   /**< Length of the path, in mm. */
+    float s;            /**< Curvilinear abscissa of the reference, in mm. */
+    uint8_t seg;        /**< Segment of the path containing s. */
+    float seg_s;        /**< Curvilinear abscissa of the start of seg, in mm. */
+
+    /** Reference trajectory over the horizon, filled by mpc_update() from
+     * the path, or by the user when there is no path. */
+    struct mpc_ref ref[MPC_MAX_HORIZON + 1];
+
+    float u[MPC_MAX_HORIZON][2];     /**< Solution, kept as warm start. */
+    float lipschitz;    /**< Estimated largest eigenvalue of the Hessian. */
+    float power[MPC_MAX_HORIZON][2]; /**< Eigenvector estimate, kept between periods. */
+
+    /* Work memory of the solver. */
+    float ua[MPC_MAX_HORIZON][2];    /**< Extrapolated point of the fast gradient. */
+    float grad[MPC_MAX_HORIZON][2];  /**< Gradient. */
+    float e[MPC_MAX_HORIZON + 1][3]; /**< Predicted errors. */
+    float cos_a[MPC_MAX_HORIZON];    /**< Cosine of the reference headings. */
+    float sin_a[MPC_MAX_HORIZON];    /**< Sine of the reference headings. */
+
+    float v;            /**< Last speed command, in mm/s. */
+    float w;            /**< Last angular speed command, in rad/s. */
+    float d_consign;    /**< Distance consign for the control system. */
+    float a_consign;    /**< Angle consign for the control system. */
+};
+
+/** @brief Initializes the tracker.
+ * @param [in] m The mpc instance.
+ * @param [in] horizon Number of predicted periods, at most MPC_MAX_HORIZON.
+ * @param [in] period Control period, in s.
+ */
+void mpc_init(struct mpc *m, uint8_t horizon, float period);
+
+/** @brief Sets the weights of the cost function. */
+void mpc_set_weights(struct mpc *m, float q_pos, float q_angle, float r_v, float r_w);
+
+/** @brief Sets the speed limits.
+ * @param [in] m The mpc instance.
+ * @param [in] v_max Maximal speed, in mm/s.
+ * @param [in] w_max Maximal angular speed, in rad/s.
+ * @param [in] acc Deceleration used to stop the reference at the end of
+ * the path, in mm/s^2.
+ */
+void mpc_set_limits(struct mpc *m, float v_max, float w_max, float acc);
+
+/** @brief Sets the number of solver iterations per period.
+ *
+ * The execution time is proportional to iterations * horizon.
+ */
+void mpc_set_iterations(struct mpc *m, uint8_t iterations);
+
+/** @brief Sets the units of the consigns.
+ * @param [in] m The mpc instance.
+ * @param [in] d_scale Distance consign units per mm.
+ * @param [in] a_scale Angle consign units per rad.
+ */
+void mpc_set_consign_scale(struct mpc *m, float d_scale, float a_scale);
+
+/** @brief Sets the path to follow.
+ *
+ * The path is not copied, it must stay valid while it is followed. The
+ * reference starts at the first point and moves along the path at the
+ * given speed, slowing down to stop at the last point.
+ * @param [in] m The mpc instance.
+ * @param [in] path The points of the path, the first one being the
+ * current position of the robot.
+ * @param [in] n Number of points.
+ * @param [in] speed Cruise speed, in mm/s.
+ */
+void mpc_set_path(struct mpc *m, const point_t *path, uint8_t n, float speed);
+
+/** @brief Starts the tracking from the current consigns.
+ * @param [in] m The mpc instance.
+ * @param [in] d_consign Current distance consign (or position).
+ * @param [in] a_consign Current angle consign (or position).
+ */
+void mpc_start(struct mpc *m, float d_consign, float a_consign);
+
+/** @brief Computes the commands for the current period.
+ *
+ * Fills the reference from the path (if any), solves the QP and updates
+ * v, w, d_consign and a_consign.
+ * @param [in] m The mpc instance.
+ * @param [in] x, y Position of the robot, in mm.
+ * @param [in] a Heading of the robot, in rad.
+ */
+void mpc_update(struct mpc *m, float x, float y, float a);
+
+/** @brief Returns 1 when the reference reached the end of the path. */
+uint8_t mpc_path_finished(struct mpc *m);
+
+#endif
@@ -0,0 +1,236 @@
+/** @file modules/oa_map/oa_map.c
+ * @author CVRA
+ * @brief Precomputed maps of the static obstacles.
+ */
+
+#include <string.h>
+#include "oa_map.h"
+
+#ifndef COMPILE_ON_ROBOT
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/** Returns the section of the given type, or NULL if there is none.
+ * elem_size is the size of an element, checked against the section size. */
+static const struct oa_map_section *
+oa_map_find_section(const struct oa_map_header *header, uint32_t type, uint32_t elem_size)
+{
+    const struct oa_map_section *sections = (const struct oa_map_section *)(header + 1);
+    uint16_t i;
+
+    for (i = 0; i < header->section_n; i++) {
+        if (sections[i].type != type)
+            continue;
+        if ((uint64_t)sections[i].count * elem_size > sections[i].size)
+            return NULL;
+        return &sections[i];
+    }
+    return NULL;
+}
+
+int8_t oa_map_open(struct oa_map *map, const void *blob, uint32_t size)
+{
+    const struct oa_map_header *header = blob;
+    const struct oa_map_section *sections, *s;
+    const uint8_t *base = blob;
+    uint32_t i, j;
+
+    memset(map, 0, sizeof(struct oa_map));
+
+    if (size < sizeof(struct oa_map_header))
+        return OA_MAP_ERR_SIZE;
+    if (header->magic != OA_MAP_MAGIC)
+        return OA_MAP_ERR_MAGIC;
+    if (header->version != OA_MAP_VERSION)
+        return OA_MAP_ERR_VERSION;
+    if (header->size > size ||
+        sizeof(struct oa_map_header) +
+        (uint32_t)header->section_n * sizeof(struct oa_map_section) > header->size)
+        return OA_MAP_ERR_SIZE;
+
+    sections = (const struct oa_map_section *)(header + 1);
+    for (i = 0; i < header->section_n; i++) {
+        if ((sections[i].offset & 3) ||
+            sections[i].offset > header->size ||
+            sections[i].size > header->size - sections[i].offset)
+            return OA_MAP_ERR_SIZE;
+    }
+
+    s = oa_map_find_section(header, OA_MAP_SECTION_BBOX, sizeof(int32_t));
+    if (s == NULL || s->count != 4)
+        return OA_MAP_ERR_SECTION;
+    map->bbox = (const int32_t *)(base + s->offset);
+
+    s = oa_map_find_section(header, OA_MAP_SECTION_POINTS, sizeof(point_t));
+    if (s == NULL || s->count > 0xffff)
+        return OA_MAP_ERR_SECTION;
+    map->points = (const point_t *)(base + s->offset);
+    map->point_n = s->count;
+
+    /* the polygon 0 of the obstacle avoidance is the start/stop one */
+    s = oa_map_find_section(header, OA_MAP_SECTION_POLYS, sizeof(struct oa_map_poly));
+    if (s == NULL || s->count > 254)
+        return OA_MAP_ERR_SECTION;
+    map->polys = (const struct oa_map_poly *)(base + s->offset);
+    map->poly_n = s->count;
+    for (i = 0; i < map->poly_n; i++) {
+        if ((uint32_t)map->polys[i].first + map->polys[i].len > map->point_n)
+            return OA_MAP_ERR_SECTION;
+    }
+
+    s = oa_map_find_section(header, OA_MAP_SECTION_RAYS, 4);
+    if (s == NULL || s->count > 0x3fff)
+        return OA_MAP_ERR_SECTION;
+    map->rays = base + s->offset;
+    map->ray_n = s->count * 4;
+    for (i = 0; i < map->ray_n; i += 4) {
+        for (j = i; j < i + 4; j += 2) {
+            if (map->rays[j] == 0 || map->rays[j] > map->poly_n ||
+                map->rays[j+1] >= map->polys[map->rays[j] - 1].len)
+                return OA_MAP_ERR_SECTION;
+        }
+    }
+
+    s = oa_map_find_section(header, OA_MAP_SECTION_BOUNDS, 4 * sizeof(float));
+    if (s != NULL) {
+        if (s->count != map->poly_n + 1u)
+            return OA_MAP_ERR_SECTION;
+        map->bounds = (const float *)(base + s->offset);
+    }
+
+    s = oa_map_find_section(header, OA_MAP_SECTION_DISTANCE, 1);
+    if (s != NULL) {
+        map->distance = (const struct oa_map_distance *)(base + s->offset);
+        if (s->size < sizeof(struct oa_map_distance) ||
+            (uint64_t)map->distance->w * map->distance->h * sizeof(uint16_t) >
+            s->size - sizeof(struct oa_map_distance) ||
+            !(map->distance->cell > 0))
+            return OA_MAP_ERR_SECTION;
+        map->distance_data = (const uint16_t *)(map->distance + 1);
+    }
+
+    s = oa_map_find_section(header, OA_MAP_SECTION_WAYPOINTS, sizeof(point_t));
+    if (s != NULL) {
+        if (s->count > 255)
+            return OA_MAP_ERR_SECTION;
+        map->waypoints = (const point_t *)(base + s->offset);
+        map->waypoint_n = s->count;
+
+        s = oa_map_find_section(header, OA_MAP_SECTION_PATH_POINTS, sizeof(uint16_t));
+        if (s == NULL)
+            return OA_MAP_ERR_SECTION;
+        map->path_points = (const uint16_t *)(base + s->offset);
+        for (i = 0; i < s->count; i++) {
+            if (map->path_points[i] >= map->point_n)
+                return OA_MAP_ERR_SECTION;
+        }
+        j = s->count;
+
+        s = oa_map_find_section(header, OA_MAP_SECTION_PATHS, sizeof(struct oa_map_path));
+        if (s == NULL || s->count != (uint32_t)map->waypoint_n * map->waypoint_n)
+            return OA_MAP_ERR_SECTION;
+        map->paths = (const struct oa_map_path *)(base + s->offset);
+        for (i = 0; i < s->count; i++) {
+            if ((uint32_t)map->paths[i].first + map->paths[i].len > j)
+                return OA_MAP_ERR_SECTION;
+        }
+    }
+
+    map->header = header;
+    return 0;
+}
+
+#ifndef COMPILE_ON_ROBOT
+int8_t oa_map_mmap(struct oa_map *map, const char *path)
+{
+    struct stat st;
+    void *addr;
+    int8_t ret;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return OA_MAP_ERR_IO;
+
+    if (fstat(fd, &st) < 0 || st.st_size == 0 || st.st_size > UINT32_MAX) {
+        close(fd);
+        return OA_MAP_ERR_IO;
+    }
+
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return OA_MAP_ERR_IO;
+
+    ret = oa_map_open(map, addr, st.st_size);
+    if (ret < 0) {
+        munmap(addr, st.st_size);
+        return ret;
+    }
+
+    map->mapped = addr;
+    map->mapped_size = st.st_size;
+    return 0;
+}
+#endif
+
+void oa_map_close(struct oa_map *map)
+{
+#ifndef COMPILE_ON_ROBOT
+    if (map->mapped != NULL)
+        munmap(map->mapped, map->mapped_size);
+#endif
+    memset(map, 0, sizeof(struct oa_map));
+}
+
+uint16_t oa_map_get_distance(const struct oa_map *map, float x, float y)
+{
+    const struct oa_map_distance *d = map->distance;
+    int32_t i, j;
+
+    if (d == NULL)
+        return OA_MAP_DISTANCE_UNKNOWN;
+
+    x = (x - d->x0) / d->cell;
+    y = (y - d->y0) / d->cell;
+    if (x < 0 || y < 0)
+        return OA_MAP_DISTANCE_UNKNOWN;
+
+    i = x;
+    j = y;
+    if (i >= d->w || j >= d->h)
+        return OA_MAP_DISTANCE_UNKNOWN;
+
+    return map->distance_data[j * d->w + i];
+}
+
+int8_t oa_map_get_path(const struct oa_map *map, uint8_t from, uint8_t to,
+                       point_t *path, uint8_t max)
+{
+    const struct oa_map_path *p;
+    uint8_t i;
+
+    if (from >= map->waypoint_n || to >= map->waypoint_n)
+        return -1;
+
+    p = &map->paths[from * map->waypoint_n + to];
+    if (p->length < 0 || p->len + 1 > max)
+        return -1;
+
+    for (i = 0; i < p->len; i++)
+        path[i] = map->points[map->path_points[p->first + i]];
+    path[i] = map->waypoints[to];
+
+    return p->len + 1;
+}
+
+float oa_map_get_path_length(const struct oa_map *map, uint8_t from, uint8_t to)
+{
+    if (from >= map->waypoint_n || to >= map->waypoint_n)
+        return -1;
+
+    return map->paths[from * map->waypoint_n + to].length;
+}
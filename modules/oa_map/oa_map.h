@@ -0,0 +1,190 @@
+/** @file modules/oa_map/oa_map.h
+ * @author CVRA
+ * @brief Precomputed maps of the static obstacles.
+ *
+ * Building the table obstacles at boot takes dozens of oa_new_poly() and
+ * oa_poly_set_point() calls, and the visibility rays between these
+ * obstacles are recomputed by each oa_process() although they never
+ * change. A map file holds these obstacles and their rays, computed
+ * offline by tools/oa_mapc. It is used where it lies: mapped by
+ * oa_map_mmap() on the host, or linked in the firmware as a const array
+ * and opened by oa_map_open(). oa_load_map() then gives it to the
+ * obstacle avoidance.
+ *
+ * File format (version 2), all fields little endian:
+ *  - A struct oa_map_header.
+ *  - header.section_n struct oa_map_section, describing the sections.
+ *  - The sections, each one aligned on 4 bytes.
+ *
+ * Sections:
+ *  - OA_MAP_SECTION_BBOX (required): 4 int32_t, the playground bounding
+ *    box x1, y1, x2, y2 in mm.
+ *  - OA_MAP_SECTION_POLYS (required): count struct oa_map_poly.
+ *  - OA_MAP_SECTION_POINTS (required): count point_t, the polygon vertices.
+ *  - OA_MAP_SECTION_RAYS (required): count rays between the vertices of
+ *    the static polygons, 4 bytes each, in the format of calc_rays().
+ *    The polygons are numbered from 1, 0 being the start/stop polygon
+ *    of the obstacle avoidance.
+ *  - OA_MAP_SECTION_BOUNDS (optional): bounding boxes of the polygons,
+ *    as 4 float arrays (xmin, ymin, xmax, ymax) of count = polygons + 1
+ *    entries, the first one being the empty start/stop polygon.
+ *  - OA_MAP_SECTION_DISTANCE (optional): a struct oa_map_distance
+ *    followed by w * h uint16_t, the distance field.
+ *  - OA_MAP_SECTION_WAYPOINTS (optional): count point_t, key positions of
+ *    the table (start area, actions...).
+ *  - OA_MAP_SECTION_PATHS (with the waypoints): count = waypoints^2
+ *    struct oa_map_path, the shortest path from waypoint i to waypoint j
+ *    being at index i * waypoints + j.
+ *  - OA_MAP_SECTION_PATH_POINTS (with the waypoints): count uint16_t,
+ *    indexes in the points section of the checkpoints of the paths.
+ * Unknown sections are ignored, so new ones do not need a new version.
+ */
+
+#ifndef _OA_MAP_H_
+#define _OA_MAP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vect_base.h>
+
+#define OA_MAP_MAGIC 0x50414d4f /**< "OMAP" */
+#define OA_MAP_VERSION 2        /**< Version of the format described above. */
+
+#define OA_MAP_FLAG_TANGENT_PRUNING 1 /**< The rays were computed with tangent pruning. */
+
+#define OA_MAP_SECTION_BBOX 1     /**< Playground bounding box. */
+#define OA_MAP_SECTION_POLYS 2    /**< Static polygons. */
+#define OA_MAP_SECTION_POINTS 3   /**< Vertices of the static polygons. */
+#define OA_MAP_SECTION_RAYS 4     /**< Visibility rays between the static polygons. */
+#define OA_MAP_SECTION_BOUNDS 5   /**< Bounding boxes of the polygons (SoA). */
+#define OA_MAP_SECTION_DISTANCE 6 /**< Distance to the nearest static obstacle. */
+#define OA_MAP_SECTION_WAYPOINTS 7 /**< Key positions of the table. */
+#define OA_MAP_SECTION_PATHS 8    /**< Shortest paths between the waypoints. */
+#define OA_MAP_SECTION_PATH_POINTS 9 /**< Checkpoints of the paths. */
+
+#define OA_MAP_ERR_SIZE -1     /**< The blob is truncated or a section is out of it. */
+#define OA_MAP_ERR_MAGIC -2    /**< Not a map. */
+#define OA_MAP_ERR_VERSION -3  /**< Unsupported version. */
+#define OA_MAP_ERR_SECTION -4  /**< A required section is missing or invalid. */
+#define OA_MAP_ERR_IO -5       /**< The file could not be mapped. */
+
+/** Value of oa_map_get_distance() outside of the field. */
+#define OA_MAP_DISTANCE_UNKNOWN 0xffff
+
+/** Beginning of a map file. */
+struct oa_map_header {
+    uint32_t magic;      /**< OA_MAP_MAGIC. */
+    uint16_t version;    /**< OA_MAP_VERSION. */
+    uint16_t flags;      /**< OA_MAP_FLAG_* values. */
+    uint32_t size;       /**< Size of the file, in bytes. */
+    uint16_t section_n;  /**< Number of sections. */
+    uint16_t reserved;   /**< 0. */
+    float checkpoint_cost; /**< Checkpoint cost of the paths, see oa_set_checkpoint_cost(). */
+};
+
+/** Entry of the section table. */
+struct oa_map_section {
+    uint32_t type;       /**< One of the OA_MAP_SECTION_* values. */
+    uint32_t offset;     /**< Position from the beginning of the file, multiple of 4. */
+    uint32_t size;       /**< Size, in bytes. */
+    uint32_t count;      /**< Number of elements. */
+};
+
+/** A polygon of the OA_MAP_SECTION_POLYS section. */
+struct oa_map_poly {
+    uint16_t first;      /**< Index of its first vertex in the points section. */
+    uint8_t len;         /**< Number of vertices. */
+    uint8_t reserved;    /**< 0. */
+};
+
+/** Header of the distance field. Cell (i, j) covers the square of side
+ * cell starting at (x0 + i * cell, y0 + j * cell). */
+struct oa_map_distance {
+    float x0, y0;        /**< Corner of the field, in mm. */
+    float cell;          /**< Size of a cell, in mm. */
+    uint16_t w, h;       /**< Number of columns and of rows. */
+};
+
+/** A path of the OA_MAP_SECTION_PATHS section. */
+struct oa_map_path {
+    float length;        /**< Length of the path in mm, < 0 if there is none. */
+    uint16_t first;      /**< Index of its first checkpoint in the path points section. */
+    uint8_t len;         /**< Number of checkpoints between the two waypoints. */
+    uint8_t reserved;    /**< 0. */
+};
+
+/** An opened map, pointing into the file. */
+struct oa_map {
+    const struct oa_map_header *header; /**< Beginning of the file. */
+    const int32_t *bbox;                /**< Bounding box x1, y1, x2, y2. */
+    const struct oa_map_poly *polys;    /**< Static polygons. */
+    uint8_t poly_n;                     /**< Number of static polygons. */
+    const point_t *points;              /**< Vertices of the static polygons. */
+    uint16_t point_n;                   /**< Number of vertices. */
+    const uint8_t *rays;                /**< Static rays, see calc_rays(). */
+    uint16_t ray_n;                     /**< Number of bytes in rays (4 per ray). */
+    const float *bounds;                /**< Polygon bounding boxes, NULL if none. */
+    const struct oa_map_distance *distance; /**< Distance field, NULL if none. */
+    const uint16_t *distance_data;      /**< Distances in mm, row after row. */
+    const point_t *waypoints;           /**< Waypoints, NULL if none. */
+    uint8_t waypoint_n;                 /**< Number of waypoints. */
+    const struct oa_map_path *paths;    /**< Paths between the waypoints. */
+    const uint16_t *path_points;        /**< Checkpoints of the paths. */
+
+    void *mapped;                       /**< Mapping done by oa_map_mmap(). */
+    size_t mapped_size;                 /**< Size of the mapping. */
+};
+
+/** Opens a map from memory, without copying it.
+ *
+ * The blob must be aligned on 4 bytes and stay valid while the map is
+ * used.
+ * @param [out] map The map.
+ * @param [in] blob The content of a map file.
+ * @param [in] size Size of the blob, in bytes.
+ * @return 0 on success, an OA_MAP_ERR_* code otherwise.
+ */
+int8_t oa_map_open(struct oa_map *map, const void *blob, uint32_t size);
+
+#ifndef COMPILE_ON_ROBOT
+/** Opens a map file by mapping it in memory (read only).
+ * @return 0 on success, an OA_MAP_ERR_* code otherwise.
+ */
+int8_t oa_map_mmap(struct oa_map *map, const char *path);
+#endif
+
+/** Releases a map, unmapping it if it was opened by oa_map_mmap(). */
+void oa_map_close(struct oa_map *map);
+
+/** Returns the distance from a point to the nearest static obstacle.
+ * @param [in] x, y The point, in mm.
+ * @return The distance of the cell containing the point, in mm, or
+ * OA_MAP_DISTANCE_UNKNOWN if the map has no distance field or if the
+ * point is outside of it.
+ */
+uint16_t oa_map_get_distance(const struct oa_map *map, float x, float y);
+
+/** Returns the precomputed shortest path between two waypoints.
+ *
+ * The path only avoids the static obstacles, see oa_process_waypoints()
+ * to also avoid the others.
+ * @param [in] map The map.
+ * @param [in] from, to Indexes of the waypoints.
+ * @param [out] path The checkpoints, in the format of oa_get_path(): the
+ * start point is not included, the last checkpoint is the destination.
+ * @param [in] max Size of path.
+ * @return The number of checkpoints, or -1 if the map has no such path
+ * or if it is longer than max.
+ */
+int8_t oa_map_get_path(const struct oa_map *map, uint8_t from, uint8_t to,
+                       point_t *path, uint8_t max);
+
+/** Returns the length of the shortest path between two waypoints.
+ *
+ * This is the travel distance around the static obstacles, to choose the
+ * next action of the strategy without any path search.
+ * @return The length in mm, or -1 if the map has no such path.
+ */
+float oa_map_get_path_length(const struct oa_map *map, uint8_t from, uint8_t to);
+
+#endif
@@ -32,11 +32,20 @@
 #include <vect_base.h>
 #include <lines.h>
 #include <polygon.h>
+#include <trace.h>
+#include <oa_map.h>
 
 #include <obstacle_avoidance.h>
 
 #define GET_PT(a) (&(a) - &(oa.points[0]))
 
+/* index in oa.points of the point pt of polygon p */
+#define PT_IDX(p, pt) GET_PT(oa.polys[p].pts[pt])
+
+#define BIT_SET(tab, n) ((tab)[(n)/8] |= (1 << ((n)%8)))
+#define BIT_CLR(tab, n) ((tab)[(n)/8] &= ~(1 << ((n)%8)))
+#define BIT_TEST(tab, n) ((tab)[(n)/8] & (1 << ((n)%8)))
+
 #define DEBUG_OA 0
 
 #if DEBUG_OA == 1
@@ -55,7 +64,8 @@ void oa_reset(void)
 {
 	DEBUG_OA_PRINTF("%s()\r", __FUNCTION__);
 
-	memset(oa.valid, 0, sizeof(oa.valid));
+	memset(oa.reached, 0, sizeof(oa.reached));
+	memset(oa.todo, 0, sizeof(oa.todo));
 	memset(oa.pweight, 0, sizeof(oa.pweight));
 	memset(oa.weight, 0, sizeof(oa.weight));
 	memset(oa.p, 0, sizeof(oa.p));
@@ -77,6 +87,37 @@ void oa_init(void)
 	__oa_start_end_points(0, 0, 100, 100);
 	oa.cur_pt_idx = 2;
 	oa.cur_poly_idx = 1;
+	oa.search_mode = OA_SEARCH_EARLY_EXIT;
+	oa.checkpoint_cost = 1.;
+	oa.turn_cost = 0.;
+	memset(oa.grid_box, 0xff, sizeof(oa.grid_box));
+}
+
+void oa_set_search_mode(uint8_t mode)
+{
+	oa.search_mode = mode;
+}
+
+void oa_set_rays_sweep(uint8_t enable)
+{
+	oa.rays_sweep = enable;
+}
+
+void oa_set_checkpoint_cost(float mm)
+{
+	oa.checkpoint_cost = mm;
+}
+
+void oa_set_turn_cost(float mm_per_rad)
+{
+	oa.turn_cost = mm_per_rad;
+}
+
+void oa_poly_set_turn_cost(poly_t *pol, uint8_t i, float mm_per_rad)
+{
+	oa.point_turn_cost[GET_PT(pol->pts[i])] = mm_per_rad;
+	if (mm_per_rad != 0.)
+		oa.point_turn_costs = 1;
 }
 
 /** 
@@ -89,20 +130,19 @@ static void __oa_start_end_points(int32_t st_x, int32_t st_y,
 	oa.points[0].x = en_x;
 	oa.points[0].y = en_y;
 
-    /* Each point processed by Dijkstra is marked as valid. If we
+    /* Each point processed by Dijkstra is marked as reached. If we
 	 * have unreachable points (out of playground or points inside
-	 * polygons) Disjkstra won't mark them as valid. At the end of
+	 * polygons) Disjkstra won't mark them as reached. At the end of
 	 * the algorithm, if the destination point is not marked as
-	 * valid, there's no valid path to reach it. */
+	 * reached, there's no valid path to reach it. */
 
-	oa.valid[GET_PT(oa.points[0])] = 0;
-	/* the real dest is the start point for the algorithm */
-	oa.pweight[GET_PT(oa.points[0])] = 1;
+	BIT_CLR(oa.reached, GET_PT(oa.points[0]));
+	BIT_CLR(oa.todo, GET_PT(oa.points[0]));
 
 	oa.points[1].x = st_x;
 	oa.points[1].y = st_y;
-	oa.valid[GET_PT(oa.points[1])] = 0;
-	oa.pweight[GET_PT(oa.points[1])] = 0;
+	BIT_CLR(oa.reached, GET_PT(oa.points[1]));
+	BIT_CLR(oa.todo, GET_PT(oa.points[1]));
 }
 
 /** 
@@ -131,10 +171,73 @@ poly_t *oa_new_poly(uint8_t size)
 	oa.polys[oa.cur_poly_idx].l = size;
 	oa.polys[oa.cur_poly_idx].pts = &oa.points[oa.cur_pt_idx];
 	oa.cur_pt_idx += size;
+	BIT_SET(oa.grid_dirty, oa.cur_poly_idx);
 
 	return &oa.polys[oa.cur_poly_idx++];
 }
 
+int8_t oa_load_map(const struct oa_map *map)
+{
+	poly_t *pol;
+	uint8_t i;
+
+	DEBUG_OA_PRINTF("%s() %d polys\r", __FUNCTION__, map->poly_n);
+
+	if (oa.cur_poly_idx != 1 || oa.cur_pt_idx + map->point_n > MAX_PTS ||
+	    1 + map->poly_n > MAX_POLY)
+		return -1;
+
+	for (i=0; i<map->poly_n; i++) {
+		pol = oa_new_poly(map->polys[i].len);
+		memcpy(pol->pts, &map->points[map->polys[i].first],
+		       map->polys[i].len * sizeof(point_t));
+	}
+
+	polygon_set_boundingbox(map->bbox[0], map->bbox[1],
+				map->bbox[2], map->bbox[3]);
+	polygon_set_tangent_pruning(!!(map->header->flags & OA_MAP_FLAG_TANGENT_PRUNING));
+
+	oa.map = map;
+	oa.static_poly_n = oa.cur_poly_idx;
+	return 0;
+}
+
+int8_t oa_process_waypoints(uint8_t from, uint8_t to)
+{
+	const point_t *wp;
+	point_t prev;
+	int8_t n, i;
+	uint8_t p;
+
+	if (oa.map == NULL || from >= oa.map->waypoint_n || to >= oa.map->waypoint_n)
+		return -1;
+
+	/* the table ignores the cost regions and the turn costs, and its
+	 * paths were searched with the checkpoint cost of oa_mapc */
+	n = -1;
+	if (oa.region_n == 0 && oa.turn_cost == 0. && !oa.point_turn_costs &&
+	    oa.checkpoint_cost == oa.map->header->checkpoint_cost)
+		n = oa_map_get_path(oa.map, from, to, oa.u.res, MAX_CHKPOINTS);
+
+	/* only the polygons which are not in the map can block it */
+	prev = oa.map->waypoints[from];
+	for (i=0; i<n; i++) {
+		for (p=oa.static_poly_n; p<oa.cur_poly_idx; p++) {
+			if (is_crossing_poly(prev, oa.u.res[i], NULL, &oa.polys[p]) == 1)
+				break;
+		}
+		if (p != oa.cur_poly_idx)
+			break;
+		prev = oa.u.res[i];
+	}
+	if (n > 0 && i == n)
+		return n;
+
+	wp = oa.map->waypoints;
+	oa_start_end_points(wp[from].x, wp[from].y, wp[to].x, wp[to].y);
+	return oa_process();
+}
+
 int oa_segment_intersect_obstacle(point_t p1, point_t p2) {
 	int i;
 	point_t dummy;
@@ -155,8 +258,249 @@ void oa_poly_set_point(poly_t *pol,
 	
 	pol->pts[i].x = x;
 	pol->pts[i].y = y;
-	oa.valid[GET_PT(pol->pts[i])] = 0;
-	oa.pweight[GET_PT(pol->pts[i])] = 0;
+	BIT_CLR(oa.reached, GET_PT(pol->pts[i]));
+	BIT_CLR(oa.todo, GET_PT(pol->pts[i]));
+	BIT_SET(oa.grid_dirty, pol - oa.polys);
+}
+
+void oa_poly_moved(poly_t *pol)
+{
+	BIT_SET(oa.grid_dirty, pol - oa.polys);
+}
+
+void oa_poly_remove(poly_t *pol)
+{
+	pol->l = 0;
+	BIT_SET(oa.grid_dirty, pol - oa.polys);
+}
+
+/* Column or row of the grid containing v, clamped to the grid */
+static uint8_t oa_grid_cell(float v, int32_t min, int32_t max, uint8_t n)
+{
+	int32_t c;
+
+	if (max <= min)
+		return 0;
+	c = (int32_t)floorf((v - min) * n / (max - min));
+	if (c < 0)
+		return 0;
+	if (c >= n)
+		return n - 1;
+	return c;
+}
+
+/* Indexes the polygons modified since the last query. */
+static void oa_grid_update(void)
+{
+	int32_t x1, y1, x2, y2;
+	uint8_t i, j, cx, cy;
+	uint8_t *box;
+	float xmin, ymin, xmax, ymax;
+
+	/* a new bounding box moves all the cells */
+	polygon_get_boundingbox(&x1, &y1, &x2, &y2);
+	if (x1 != oa.grid_x1 || y1 != oa.grid_y1 || x2 != oa.grid_x2 || y2 != oa.grid_y2) {
+		oa.grid_x1 = x1;
+		oa.grid_y1 = y1;
+		oa.grid_x2 = x2;
+		oa.grid_y2 = y2;
+		memset(oa.grid, 0, sizeof(oa.grid));
+		memset(oa.grid_box, 0xff, sizeof(oa.grid_box));
+		memset(oa.grid_dirty, 0xff, sizeof(oa.grid_dirty));
+	}
+
+	for (i=1; i<oa.cur_poly_idx; i++) {
+		if (!BIT_TEST(oa.grid_dirty, i))
+			continue;
+		BIT_CLR(oa.grid_dirty, i);
+		box = oa.grid_box[i];
+
+		if (box[0] != 0xff) {
+			for (cy=box[1]; cy<=box[3]; cy++)
+				for (cx=box[0]; cx<=box[2]; cx++)
+					BIT_CLR(oa.grid[cy*OA_GRID_W + cx], i);
+			box[0] = 0xff;
+		}
+		if (oa.polys[i].l == 0)
+			continue;
+
+		xmin = xmax = oa.polys[i].pts[0].x;
+		ymin = ymax = oa.polys[i].pts[0].y;
+		for (j=1; j<oa.polys[i].l; j++) {
+			xmin = fminf(xmin, oa.polys[i].pts[j].x);
+			xmax = fmaxf(xmax, oa.polys[i].pts[j].x);
+			ymin = fminf(ymin, oa.polys[i].pts[j].y);
+			ymax = fmaxf(ymax, oa.polys[i].pts[j].y);
+		}
+		box[0] = oa_grid_cell(xmin, x1, x2, OA_GRID_W);
+		box[1] = oa_grid_cell(ymin, y1, y2, OA_GRID_H);
+		box[2] = oa_grid_cell(xmax, x1, x2, OA_GRID_W);
+		box[3] = oa_grid_cell(ymax, y1, y2, OA_GRID_H);
+		for (cy=box[1]; cy<=box[3]; cy++)
+			for (cx=box[0]; cx<=box[2]; cx++)
+				BIT_SET(oa.grid[cy*OA_GRID_W + cx], i);
+	}
+}
+
+/* Polygon of the grid strictly containing p, 0 if none. The grid must
+ * be up to date. */
+static uint8_t oa_grid_find(const point_t *p)
+{
+	const uint8_t *cell;
+	uint8_t i;
+
+	cell = oa.grid[oa_grid_cell(p->y, oa.grid_y1, oa.grid_y2, OA_GRID_H) * OA_GRID_W +
+		       oa_grid_cell(p->x, oa.grid_x1, oa.grid_x2, OA_GRID_W)];
+	for (i=1; i<oa.cur_poly_idx; i++) {
+		if (BIT_TEST(cell, i) && is_in_poly(p, &oa.polys[i]) == 1)
+			return i;
+	}
+	return 0;
+}
+
+poly_t *oa_poly_containing(int32_t x, int32_t y)
+{
+	point_t p;
+	uint8_t i;
+
+	p.x = x;
+	p.y = y;
+	oa_grid_update();
+	i = oa_grid_find(&p);
+	return i ? &oa.polys[i] : NULL;
+}
+
+/* Candidate c of oa_nearest_free_point(): c moved by margin away from p
+ * is kept in best if it is free and nearer than the best one. */
+static void oa_free_candidate(const point_t *p, point_t c, float margin,
+			      point_t *best, float *best_d)
+{
+	float d, dx = c.x - p->x, dy = c.y - p->y;
+
+	d = sqrtf(dx * dx + dy * dy);
+	if (d + margin >= *best_d)
+		return;
+	if (d > 0) {
+		c.x += dx / d * margin;
+		c.y += dy / d * margin;
+	}
+	if (!is_in_boundingbox(&c) || oa_grid_find(&c))
+		return;
+	*best = c;
+	*best_d = d + margin;
+}
+
+int8_t oa_nearest_free_point(int32_t x, int32_t y, float margin, point_t *res)
+{
+	uint8_t seen[OA_BITSET_LEN(MAX_POLY)];
+	uint8_t px, py, r, i, j, k, m, n;
+	int16_t cx, cy;
+	const uint8_t *cell;
+	float best_d = INFINITY, cell_size, t, l;
+	point_t p, c, a, b;
+	poly_t *pol;
+
+	p.x = x;
+	p.y = y;
+	*res = p;
+	oa_grid_update();
+	if (oa_grid_find(&p) == 0)
+		return 0;
+
+	memset(seen, 0, sizeof(seen));
+	px = oa_grid_cell(p.x, oa.grid_x1, oa.grid_x2, OA_GRID_W);
+	py = oa_grid_cell(p.y, oa.grid_y1, oa.grid_y2, OA_GRID_H);
+	cell_size = fminf((float)(oa.grid_x2 - oa.grid_x1) / OA_GRID_W,
+			  (float)(oa.grid_y2 - oa.grid_y1) / OA_GRID_H);
+
+	/* rings of cells around p, by increasing distance */
+	for (r=0; r<OA_GRID_W || r<OA_GRID_H; r++) {
+		/* the cells of this ring are farther than the best point */
+		if (r > 0 && best_d <= (r - 1) * cell_size + margin)
+			break;
+
+		for (cy=py-r; cy<=py+r; cy++) {
+			if (cy < 0 || cy >= OA_GRID_H)
+				continue;
+			for (cx=px-r; cx<=px+r; cx++) {
+				/* only the border of the ring */
+				if (cy != py-r && cy != py+r && cx != px-r)
+					cx = px+r;
+				if (cx < 0 || cx >= OA_GRID_W)
+					continue;
+				cell = oa.grid[cy*OA_GRID_W + cx];
+
+				for (i=1; i<oa.cur_poly_idx; i++) {
+					if (!BIT_TEST(cell, i) || BIT_TEST(seen, i))
+						continue;
+					BIT_SET(seen, i);
+					pol = &oa.polys[i];
+
+					for (j=0; j<pol->l; j++) {
+						n = (j+1)%pol->l;
+						a = pol->pts[j];
+						b = pol->pts[n];
+
+						/* projection of p on the edge */
+						l = (b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y);
+						t = l > 0 ? ((p.x - a.x) * (b.x - a.x) + (p.y - a.y) * (b.y - a.y)) / l : 0;
+						t = fmaxf(0, fminf(1, t));
+						c.x = a.x + t * (b.x - a.x);
+						c.y = a.y + t * (b.y - a.y);
+						oa_free_candidate(&p, c, margin, res, &best_d);
+
+						/* where obstacles overlap, the free space
+						 * has corners at their intersections */
+						for (k=1; k<i; k++) {
+							if (!BIT_TEST(seen, k))
+								continue;
+							for (m=0; m<oa.polys[k].l; m++) {
+								if (intersect_segment(&a, &b, &oa.polys[k].pts[m],
+										      &oa.polys[k].pts[(m+1)%oa.polys[k].l],
+										      &c) == 1)
+									oa_free_candidate(&p, c, margin, res, &best_d);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if (best_d == INFINITY)
+		return -1;
+	return 1;
+}
+
+poly_t *oa_new_cost_region(uint8_t size, float factor)
+{
+	cost_region_t *r;
+
+	DEBUG_OA_PRINTF("%s(): size=%d factor=%f\r", __FUNCTION__, size, factor);
+
+	if (size < 3 || factor < 0 || oa.region_n >= MAX_REGIONS ||
+	    oa.region_pt_n + size > MAX_REGION_PTS)
+		return NULL;
+
+	r = &oa.regions[oa.region_n++];
+	r->poly.pts = &oa.region_points[oa.region_pt_n];
+	r->poly.l = size;
+	r->factor = factor;
+	oa.region_pt_n += size;
+
+	return &r->poly;
+}
+
+void oa_cost_region_set_point(poly_t *pol, int32_t x, int32_t y, uint8_t i)
+{
+	pol->pts[i].x = x;
+	pol->pts[i].y = y;
+}
+
+void oa_clear_cost_regions(void)
+{
+	oa.region_n = 0;
+	oa.region_pt_n = 0;
 }
 
 point_t * oa_get_path(void)
@@ -185,43 +529,54 @@ void oa_dump(void)
 #endif 
 }
 
-/* Iterative Dijkstra algorithm: The valid filed is used to determine if:
- *   1: this point has been visited, his weight is correct.
- *   2: the point must be visited.
- *
- * The algorithm does: find a point that must be visited (2) update
- * his weight, mark it as (1) and update all his neightbours has 2.
+/* Cost of following the ray whose end is at offset r in u.rays: ray
+ * length and checkpoint cost. */
+static float
+oa_ray_cost(uint16_t r)
+{
+	return oa.weight[r/4] + oa.checkpoint_cost;
+}
+
+/* Iterative Dijkstra algorithm: The reached and todo bitsets are used
+ * to determine if:
+ *   reached: this point has a weight (a parent in the tree).
+ *   todo: the point must be visited.
  *
- * The algorithm ends when no (2) points are found
+ * The algorithm does: find a point that must be visited, update
+ * the weight of all his neighbours, and mark the updated ones as
+ * todo.
  *
- * A point with weight 0 is a point that has not been visited (so
- * weight is not affected yet); This explain why first point must have
- * a start weight different than 0.
+ * The algorithm ends when no todo points are found
  *
  * When the algo finds a shorter path to reach a point B from point A,
  * it will store in (p, pt) the parent point. This is important to
  * remenber and extract the solution path. */
-void 
+void
 dijkstra(uint8_t start_p, uint8_t start)
 {
-	uint8_t i;
+	uint16_t i, u, n, root;
 	int8_t add;
 	int8_t finish = 0;
-	/* weight == 0 means not visited */
-	/* weight == 1 for start */
-	
-	/* find all point linked to start */
+	float w;
+
+	memset(oa.reached, 0, sizeof(oa.reached));
+	memset(oa.todo, 0, sizeof(oa.todo));
 
-	oa.valid[GET_PT(oa.polys[start_p].pts[start])] = 2;
+	root = PT_IDX(start_p, start);
+	oa.pweight[root] = 0;
+	BIT_SET(oa.reached, root);
+	BIT_SET(oa.todo, root);
 
 	while (!finish){
 		finish = 1;
 
-		for (start_p = 0;start_p<MAX_POLY;start_p++) {
+		for (start_p = 0;start_p<oa.cur_poly_idx;start_p++) {
 			for (start = 0;start<oa.polys[start_p].l;start++) {
-				if (oa.valid[GET_PT(oa.polys[start_p].pts[start])] != 2)
+				u = PT_IDX(start_p, start);
+				if (!BIT_TEST(oa.todo, u))
 					continue;
-				add = -2;		
+				BIT_CLR(oa.todo, u);
+				add = -2;
 
 			        /* For all points that must be
 				 * visited, we look for rays that
@@ -238,34 +593,33 @@ dijkstra(uint8_t start_p, uint8_t start)
 					 * If index is odd, we are in stop
 					 * point and ray start point is at
 					 * i-2 pos */
-					add = -add;					
-					
+					add = -add;
+
 					if (start_p != oa.u.rays[i] || start != oa.u.rays[i+1])
 						continue;
 
-					if ((oa.pweight[GET_PT(oa.polys[oa.u.rays[i+add]].pts[oa.u.rays[i+add+1]])] != 0) &&
-					    (oa.pweight[GET_PT(oa.polys[start_p].pts[start])]+oa.weight[i/4] >=
-					     oa.pweight[GET_PT(oa.polys[oa.u.rays[i+add]].pts[oa.u.rays[i+add+1]])]))
+					n = PT_IDX(oa.u.rays[i+add], oa.u.rays[i+add+1]);
+					w = oa.pweight[u] + oa_ray_cost(i+add);
+
+					if (BIT_TEST(oa.reached, n) && w >= oa.pweight[n])
 						continue;
-					
-					oa.p[GET_PT(oa.polys[oa.u.rays[i+add]].pts[oa.u.rays[i+add+1]])] = start_p;
-					oa.pt[GET_PT(oa.polys[oa.u.rays[i+add]].pts[oa.u.rays[i+add+1]])] = start;
-					oa.valid[GET_PT(oa.polys[oa.u.rays[i+add]].pts[oa.u.rays[i+add+1]])]=2;
-					oa.pweight[GET_PT(oa.polys[oa.u.rays[i+add]].pts[oa.u.rays[i+add+1]])] = 
-						oa.pweight[GET_PT(oa.polys[start_p].pts[start])]+oa.weight[i/4];
-							
-					oa.valid[GET_PT(oa.polys[start_p].pts[start])] = 1;
-					finish = 0;				
-					DEBUG_OA_PRINTF("%s() (%2.0f,%2.0f p=%ld) %d (%2.0f,%2.0f p=%ld)\r", __FUNCTION__,
+
+					oa.p[n] = start_p;
+					oa.pt[n] = start;
+					oa.pweight[n] = w;
+					BIT_SET(oa.reached, n);
+					BIT_SET(oa.todo, n);
+					finish = 0;
+					DEBUG_OA_PRINTF("%s() (%2.0f,%2.0f p=%f) %f (%2.0f,%2.0f p=%f)\r", __FUNCTION__,
 					      oa.polys[start_p].pts[start].x,
 					      oa.polys[start_p].pts[start].y,
-					      oa.pweight[GET_PT(oa.polys[start_p].pts[start])],
+					      oa.pweight[u],
 
 					      oa.weight[i/4],
-					      
-					      oa.polys[oa.u.rays[i+add]].pts[oa.u.rays[i+add+1]].x, 
+
+					      oa.polys[oa.u.rays[i+add]].pts[oa.u.rays[i+add+1]].x,
 					      oa.polys[oa.u.rays[i+add]].pts[oa.u.rays[i+add+1]].y,
-					      oa.pweight[GET_PT(oa.polys[oa.u.rays[i+add]].pts[oa.u.rays[i+add+1]])]
+					      oa.pweight[n]
 					      );
 				}
 			}
@@ -273,6 +627,363 @@ dijkstra(uint8_t start_p, uint8_t start)
 	}
 }
 
+/* Build the adjacency lists of the visibility graph from the rays
+ * array, so a point does not have to scan every ray to find its
+ * neighbours. This is a counting sort of the ray ends on their
+ * point index. */
+static void oa_build_adjacency(void)
+{
+	uint16_t i, n;
+	uint16_t a, b;
+
+	memset(oa.adj_start, 0, sizeof(oa.adj_start));
+
+	/* count the neighbours of each point */
+	for (i=0; i<oa.ray_n; i+=4) {
+		oa.adj_start[PT_IDX(oa.u.rays[i], oa.u.rays[i+1]) + 1]++;
+		oa.adj_start[PT_IDX(oa.u.rays[i+2], oa.u.rays[i+3]) + 1]++;
+	}
+
+	for (n=0; n<oa.cur_pt_idx; n++)
+		oa.adj_start[n+1] += oa.adj_start[n];
+
+	/* adj_start[n] is used as a write cursor, so at the end it
+	 * points to the first neighbour of point n+1 */
+	for (i=0; i<oa.ray_n; i+=4) {
+		a = PT_IDX(oa.u.rays[i], oa.u.rays[i+1]);
+		b = PT_IDX(oa.u.rays[i+2], oa.u.rays[i+3]);
+		oa.adj[oa.adj_start[a]++] = i+2;
+		oa.adj[oa.adj_start[b]++] = i;
+	}
+
+	for (n=oa.cur_pt_idx; n>0; n--)
+		oa.adj_start[n] = oa.adj_start[n-1];
+	oa.adj_start[0] = 0;
+}
+
+/* Find the point that must be visited with the lowest weight.
+ * Returns 0 if there is no such point. */
+static uint8_t
+oa_frontier_min(const uint8_t *todo, const float *pweight, uint8_t *min_p, uint8_t *min_pt)
+{
+	uint8_t p, pt;
+	uint8_t found = 0;
+	float min = 0;
+
+	for (p=0; p<oa.cur_poly_idx; p++) {
+		for (pt=0; pt<oa.polys[p].l; pt++) {
+			if (!BIT_TEST(todo, PT_IDX(p, pt)))
+				continue;
+			if (found && pweight[PT_IDX(p, pt)] >= min)
+				continue;
+			min = pweight[PT_IDX(p, pt)];
+			*min_p = p;
+			*min_pt = pt;
+			found = 1;
+		}
+	}
+	return found;
+}
+
+/* Classic Dijkstra, using the same reached / todo / pweight / p / pt
+ * fields as dijkstra(), but points are visited by increasing weight so
+ * the search can stop as soon as the point (goal_p, goal) is reached. */
+static void
+dijkstra_early_exit(uint8_t start_p, uint8_t start, uint8_t goal_p, uint8_t goal)
+{
+	uint8_t p, pt, np, npt;
+	uint16_t i, u, n, root;
+	uint8_t settled[OA_BITSET_LEN(MAX_PTS)];
+	float w;
+
+	memset(oa.reached, 0, sizeof(oa.reached));
+	memset(oa.todo, 0, sizeof(oa.todo));
+	memset(settled, 0, sizeof(settled));
+
+	root = PT_IDX(start_p, start);
+	oa.pweight[root] = 0;
+	BIT_SET(oa.reached, root);
+	BIT_SET(oa.todo, root);
+
+	while (oa_frontier_min(oa.todo, oa.pweight, &p, &pt)) {
+		u = PT_IDX(p, pt);
+		BIT_CLR(oa.todo, u);
+		BIT_SET(settled, u);
+
+		/* the weight of the goal cannot decrease anymore */
+		if (p == goal_p && pt == goal)
+			break;
+
+		for (i=oa.adj_start[u]; i<oa.adj_start[u+1]; i++) {
+			np = oa.u.rays[oa.adj[i]];
+			npt = oa.u.rays[oa.adj[i]+1];
+			n = PT_IDX(np, npt);
+
+			if (BIT_TEST(settled, n))
+				continue;
+
+			w = oa.pweight[u] + oa_ray_cost(oa.adj[i]);
+			if (BIT_TEST(oa.reached, n) && w >= oa.pweight[n])
+				continue;
+
+			oa.p[n] = p;
+			oa.pt[n] = pt;
+			oa.pweight[n] = w;
+			BIT_SET(oa.reached, n);
+			BIT_SET(oa.todo, n);
+		}
+	}
+}
+
+/* Bidirectional Dijkstra. The tree rooted at (end_p, end) is stored in
+ * reached / todo / pweight / p / pt, the one rooted at (start_p,
+ * start) in breached / btodo / bweight / bp / bpt. The cost of a path
+ * going through the ray (a, b) is pweight[a] + cost + bweight[b].
+ *
+ * The search stops when the sum of the two lowest frontier weights
+ * exceeds the best path found so far. Then the start tree part of the
+ * best path is copied in p / pt, so get_path() can walk it exactly
+ * like after a one-way search.
+ *
+ * Not used with turn costs, since the turn at the meeting point
+ * depends on both trees: see dijkstra_turns(). */
+static void
+dijkstra_bidirectional(uint8_t end_p, uint8_t end, uint8_t start_p, uint8_t start)
+{
+	uint8_t fp=0, fpt=0, bp=0, bpt=0;
+	uint8_t p, pt, np, npt;
+	uint8_t meet_fp=0, meet_fpt=0, meet_bp=0, meet_bpt=0;
+	uint8_t has_f, has_b, forward, found = 0;
+	uint16_t i, u, n;
+	float w, mu = 0;
+
+	uint8_t *reached, *todo, *oreached, *par_p, *par_pt;
+	float *pweight, *oweight;
+
+	memset(oa.reached, 0, sizeof(oa.reached));
+	memset(oa.todo, 0, sizeof(oa.todo));
+	memset(oa.breached, 0, sizeof(oa.breached));
+	memset(oa.btodo, 0, sizeof(oa.btodo));
+
+	oa.pweight[PT_IDX(end_p, end)] = 0;
+	BIT_SET(oa.reached, PT_IDX(end_p, end));
+	BIT_SET(oa.todo, PT_IDX(end_p, end));
+	oa.bweight[PT_IDX(start_p, start)] = 0;
+	BIT_SET(oa.breached, PT_IDX(start_p, start));
+	BIT_SET(oa.btodo, PT_IDX(start_p, start));
+
+	while (1) {
+		has_f = oa_frontier_min(oa.todo, oa.pweight, &fp, &fpt);
+		has_b = oa_frontier_min(oa.btodo, oa.bweight, &bp, &bpt);
+
+		/* one of the trees cannot grow anymore: every path
+		 * between the two ends was already seen */
+		if (!has_f || !has_b)
+			break;
+
+		if (found && oa.pweight[PT_IDX(fp, fpt)] + oa.bweight[PT_IDX(bp, bpt)] >= mu)
+			break;
+
+		/* grow the tree with the lowest frontier */
+		forward = oa.pweight[PT_IDX(fp, fpt)] <= oa.bweight[PT_IDX(bp, bpt)];
+		if (forward) {
+			p = fp; pt = fpt;
+			reached = oa.reached; todo = oa.todo; pweight = oa.pweight;
+			par_p = oa.p; par_pt = oa.pt;
+			oreached = oa.breached; oweight = oa.bweight;
+		}
+		else {
+			p = bp; pt = bpt;
+			reached = oa.breached; todo = oa.btodo; pweight = oa.bweight;
+			par_p = oa.bp; par_pt = oa.bpt;
+			oreached = oa.reached; oweight = oa.pweight;
+		}
+
+		u = PT_IDX(p, pt);
+		BIT_CLR(todo, u);
+
+		for (i=oa.adj_start[u]; i<oa.adj_start[u+1]; i++) {
+			np = oa.u.rays[oa.adj[i]];
+			npt = oa.u.rays[oa.adj[i]+1];
+			n = PT_IDX(np, npt);
+
+			w = pweight[u] + oa_ray_cost(oa.adj[i]);
+
+			/* the other tree already reached this point,
+			 * we have a candidate path */
+			if (BIT_TEST(oreached, n) && (!found || w + oweight[n] < mu)) {
+				mu = w + oweight[n];
+				found = 1;
+				if (forward) {
+					meet_fp = p; meet_fpt = pt;
+					meet_bp = np; meet_bpt = npt;
+				}
+				else {
+					meet_fp = np; meet_fpt = npt;
+					meet_bp = p; meet_bpt = pt;
+				}
+			}
+
+			if (BIT_TEST(reached, n) && w >= pweight[n])
+				continue;
+
+			par_p[n] = p;
+			par_pt[n] = pt;
+			pweight[n] = w;
+			BIT_SET(reached, n);
+			BIT_SET(todo, n);
+		}
+	}
+
+	/* no path, get_path() will see the start point is not reached */
+	if (!found)
+		return;
+
+	/* Link the meeting point of the start tree to the end tree, then
+	 * reverse the start tree branch so it points toward the end. */
+	p = meet_bp;
+	pt = meet_bpt;
+	np = meet_fp;
+	npt = meet_fpt;
+	while (1) {
+		u = PT_IDX(p, pt);
+		oa.p[u] = np;
+		oa.pt[u] = npt;
+		BIT_SET(oa.reached, u);
+		if (p == start_p && pt == start)
+			break;
+		np = p;
+		npt = pt;
+		p = oa.bp[u];
+		pt = oa.bpt[u];
+	}
+}
+
+
+/* Point at the offset r of u.rays. */
+#define RAY_PT(r) (&oa.polys[oa.u.rays[r]].pts[oa.u.rays[(r)+1]])
+
+/* Cost of turning at the end of the directed ray i to follow the
+ * directed ray j, which leaves from there. The start of the directed
+ * ray i is the other end of its ray, at offset adj[i] ^ 2. */
+static float
+oa_turn_cost(uint16_t i, uint16_t j)
+{
+	const point_t *from = RAY_PT(oa.adj[i] ^ 2);
+	const point_t *cur = RAY_PT(oa.adj[i]);
+	const point_t *next = RAY_PT(oa.adj[j]);
+	float cost = oa.turn_cost + oa.point_turn_cost[GET_PT(*cur)];
+	vect_t v, w;
+
+	if (cost == 0.)
+		return 0.;
+
+	v.x = cur->x - from->x;
+	v.y = cur->y - from->y;
+	w.x = next->x - cur->x;
+	w.y = next->y - cur->y;
+
+	return cost * fabsf(atan2f(vect_pvect(&v, &w), vect_pscal(&v, &w)));
+}
+
+/* Dijkstra on the directed rays, for the turn costs. The cost of a
+ * directed ray depends on the previous one, which a search on the
+ * points cannot know. The states are the entries of adj (see
+ * oa_build_adjacency()), visited by increasing weight, so the search
+ * stops at the first one ending at (goal_p, goal): there is no turn
+ * there. The path is read by get_turn_path(). */
+static int32_t
+dijkstra_turns(uint8_t start_p, uint8_t start, uint8_t goal_p, uint8_t goal)
+{
+	uint16_t i, j, u, n, state_n = oa.ray_n / 2;
+	uint16_t goal_idx = PT_IDX(goal_p, goal);
+	int32_t best;
+	float w, min;
+
+	memset(oa.rreached, 0, sizeof(oa.rreached));
+	memset(oa.rtodo, 0, sizeof(oa.rtodo));
+
+	/* the rays leaving the root, without turn */
+	u = PT_IDX(start_p, start);
+	for (j=oa.adj_start[u]; j<oa.adj_start[u+1]; j++) {
+		oa.rweight[j] = oa_ray_cost(oa.adj[j]);
+		oa.rparent[j] = OA_NO_RAY;
+		BIT_SET(oa.rreached, j);
+		BIT_SET(oa.rtodo, j);
+	}
+
+	while (1) {
+		best = -1;
+		min = 0;
+		for (i=0; i<state_n; i++) {
+			if (!BIT_TEST(oa.rtodo, i))
+				continue;
+			if (best >= 0 && oa.rweight[i] >= min)
+				continue;
+			min = oa.rweight[i];
+			best = i;
+		}
+		if (best < 0)
+			return -1;
+
+		i = best;
+		BIT_CLR(oa.rtodo, i);
+		n = GET_PT(*RAY_PT(oa.adj[i]));
+		if (n == goal_idx)
+			return i;
+
+		for (j=oa.adj_start[n]; j<oa.adj_start[n+1]; j++) {
+			/* already settled */
+			if (BIT_TEST(oa.rreached, j) && !BIT_TEST(oa.rtodo, j))
+				continue;
+
+			w = oa.rweight[i] + oa_ray_cost(oa.adj[j]) + oa_turn_cost(i, j);
+			if (BIT_TEST(oa.rreached, j) && w >= oa.rweight[j])
+				continue;
+
+			oa.rweight[j] = w;
+			oa.rparent[j] = i;
+			BIT_SET(oa.rreached, j);
+			BIT_SET(oa.rtodo, j);
+		}
+	}
+}
+
+/* Writes the path found by dijkstra_turns(), ending with the directed
+ * ray last, in u.res. As for get_path(), the tree root is the goal of
+ * the robot, so the path is the start of each directed ray. */
+static int8_t
+get_turn_path(int32_t last)
+{
+	uint8_t pts[MAX_CHKPOINTS][2];
+	uint16_t i, r;
+	uint8_t n = 0;
+
+	if (last < 0) {
+		DEBUG_OA_PRINTF("invalid path!\r");
+		return -2;
+	}
+
+	/* the rays are in the same union as the result, read them first */
+	for (i=last; ; i=oa.rparent[i]) {
+		if (n >= MAX_CHKPOINTS)
+			return -1;
+		r = oa.adj[i] ^ 2;
+		pts[n][0] = oa.u.rays[r];
+		pts[n][1] = oa.u.rays[r+1];
+		n++;
+		if (oa.rparent[i] == OA_NO_RAY)
+			break;
+	}
+
+	for (i=0; i<n; i++) {
+		oa.u.res[i] = oa.polys[pts[i][0]].pts[pts[i][1]];
+		DEBUG_OA_PRINTF("result[%d]: %2.0f, %2.0f\r", i, oa.u.res[i].x, oa.u.res[i].y);
+	}
+	return n;
+}
+
+#undef RAY_PT
 
 /* display the path */
 int8_t get_path(poly_t *polys) {
@@ -289,7 +1000,7 @@ int8_t get_path(poly_t *polys) {
 		if (i>=MAX_CHKPOINTS)
 			return -1;
 
-		if (oa.valid[GET_PT(polys[p].pts[pt])]==0) {
+		if (!BIT_TEST(oa.reached, GET_PT(polys[p].pts[pt]))) {
 			DEBUG_OA_PRINTF( "invalid path!\r");
 			return -2;
 		}
@@ -306,14 +1017,66 @@ int8_t get_path(poly_t *polys) {
 	return i;
 }
 
+/* Moves the end (point 0) and start (point 1) points out of the
+ * obstacles, as no ray leaves a point inside an obstacle. Returns 1 if
+ * the start moved. */
+static uint8_t oa_free_start_end(void)
+{
+	point_t *pts = oa.polys[0].pts;
+	point_t p;
+	uint8_t i, start_moved = 0;
+
+	for (i=0; i<2; i++) {
+		if (oa_nearest_free_point(pts[i].x, pts[i].y, OA_FREE_MARGIN, &p) != 1)
+			continue;
+		DEBUG_OA_PRINTF("point %d moved out of an obstacle to %2.0f, %2.0f\r",
+				i, p.x, p.y);
+		pts[i] = p;
+		if (i == 1)
+			start_moved = 1;
+	}
+	return start_moved;
+}
+
 int8_t 
 oa_process(void)
 {
-	uint8_t ret;
-	uint8_t i;
+	uint16_t ret;
+	uint16_t i;
+	int8_t path_len;
+	uint8_t start_moved, pruning;
+	int32_t last_ray;
+
+	TRACE_BEGIN("oa_process");
+
+	start_moved = oa_free_start_end();
 
-	/* First we compute the visibility graph */
-	ret = calc_rays(oa.polys, oa.cur_poly_idx, oa.u.rays);
+	/* First we compute the visibility graph. With cost regions, the
+	 * best path may bend where a ray is not tangent: keep all the rays,
+	 * and do not use the rays of a pruned map. */
+	TRACE_BEGIN("calc_rays");
+	pruning = polygon_get_tangent_pruning();
+	if (oa.region_n)
+		polygon_set_tangent_pruning(0);
+	if (oa.map && !(oa.region_n &&
+			(oa.map->header->flags & OA_MAP_FLAG_TANGENT_PRUNING)))
+		ret = calc_rays_static(oa.polys, oa.cur_poly_idx, oa.static_poly_n,
+				       oa.map->rays, oa.map->ray_n, oa.map->bounds,
+				       oa.u.rays, sizeof(oa.u.rays));
+	else if (oa.rays_sweep)
+		ret = calc_rays_sweep(oa.polys, oa.cur_poly_idx, oa.u.rays,
+				      sizeof(oa.u.rays));
+	else
+		ret = calc_rays(oa.polys, oa.cur_poly_idx, oa.u.rays,
+				sizeof(oa.u.rays));
+	polygon_set_tangent_pruning(pruning);
+	TRACE_END("calc_rays");
+	if (ret > sizeof(oa.u.rays)) {
+		DEBUG_OA_PRINTF("too many rays\r");
+		TRACE_END("oa_process");
+		return -5;
+	}
+	TRACE_COUNTER("oa rays", ret / 4);
 	DEBUG_OA_PRINTF("nbR%d\r", ret);
 
 	DEBUG_OA_PRINTF("Ray list\r");
@@ -321,16 +1084,29 @@ oa_process(void)
 		DEBUG_OA_PRINTF("%d,%d -> %d,%d\r", oa.u.rays[i], oa.u.rays[i+1], oa.u.rays[i+2], oa.u.rays[i+3]);
 	}
 	// S'il n'y a pas de rayon, on dit qu'il faut aller direct
-	if(ret == 0)
+	if(ret == 0) {
+		TRACE_END("oa_process");
 		return -3;
+	}
 	
-	/* Then we affect the rays lengths to their weights */
-	calc_rays_weight(oa.polys, oa.cur_poly_idx, 
-			 oa.u.rays, ret, oa.weight);
+	/* Then we affect the rays lengths to their weights, scaled in
+	 * the cost regions */
+	TRACE_BEGIN("calc_rays_weight");
+	for (i=0; i<oa.region_n; i++) {
+		if (cost_region_update(&oa.regions[i]) < 0) {
+			DEBUG_OA_PRINTF("cost region %d is not convex\r", i);
+			TRACE_END("calc_rays_weight");
+			TRACE_END("oa_process");
+			return -4;
+		}
+	}
+	calc_rays_weight_regions(oa.polys, oa.cur_poly_idx, oa.u.rays, ret,
+				 oa.regions, oa.region_n, oa.weight);
+	TRACE_END("calc_rays_weight");
 	
 	DEBUG_OA_PRINTF("Ray weights:\r");
 	for (i=0;i<ret;i+=4) {
-		DEBUG_OA_PRINTF("%d,%d->%d,%d (%d)\r",
+		DEBUG_OA_PRINTF("%d,%d->%d,%d (%f)\r",
 		       (int)oa.polys[oa.u.rays[i]].pts[oa.u.rays[i+1]].x,
 		       (int)oa.polys[oa.u.rays[i]].pts[oa.u.rays[i+1]].y,
 		       (int)oa.polys[oa.u.rays[i+2]].pts[oa.u.rays[i+3]].x,
@@ -342,9 +1118,49 @@ oa_process(void)
 	 * point (point 0 of the polygon 0) */
 	oa.ray_n = ret;
 	DEBUG_OA_PRINTF( "dijkstra ray_n = %d\r", ret);
-	dijkstra(0, 0);
+	TRACE_BEGIN("dijkstra");
+	if (oa.turn_cost != 0. || oa.point_turn_costs) {
+		oa_build_adjacency();
+		last_ray = dijkstra_turns(0, 0, 0, 1);
+		TRACE_END("dijkstra");
+		path_len = get_turn_path(last_ray);
+	}
+	else {
+		switch (oa.search_mode) {
+		case OA_SEARCH_FULL:
+			dijkstra(0, 0);
+			break;
+
+		case OA_SEARCH_BIDIRECTIONAL:
+			oa_build_adjacency();
+			dijkstra_bidirectional(0, 0, 0, 1);
+			break;
+
+		case OA_SEARCH_EARLY_EXIT:
+		default:
+			oa_build_adjacency();
+			dijkstra_early_exit(0, 0, 0, 1);
+			break;
+		}
+		TRACE_END("dijkstra");
+
+		/* As dijkstra sets the parent points in the resulting graph,
+		 * we can backtrack the solution path. */
+		path_len = get_path(oa.polys);
+	}
+
+	/* the robot must first go to the moved start */
+	if (start_moved && path_len > 0) {
+		if (path_len >= MAX_CHKPOINTS) {
+			path_len = -1;
+		}
+		else {
+			memmove(&oa.u.res[1], &oa.u.res[0], path_len * sizeof(point_t));
+			oa.u.res[0] = oa.polys[0].pts[1];
+			path_len++;
+		}
+	}
 
-	/* As dijkstra sets the parent points in the resulting graph,
-	 * we can backtrack the solution path. */
-	return get_path(oa.polys);
+	TRACE_END("oa_process");
+	return path_len;
 }
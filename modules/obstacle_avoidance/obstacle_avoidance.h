@@ -40,7 +40,10 @@
  * a weight with its own length.
  *
  * The algorithm executes Dijkstra to find the shortest path to go
- * from A to B.
+ * from A to B. By default the search stops as soon as the start point
+ * is settled, so the parts of the graph that are farther away than the
+ * solution are never explored. A bidirectional variant, growing one
+ * tree from each end, can be selected with oa_set_search_mode().
  */
 
 /*
@@ -63,6 +66,28 @@
 #define MAX_PTS 500         /**< The maximal number of polygon vertices. */
 #define MAX_RAYS 2000       /**< The maximal number of rays. */
 #define MAX_CHKPOINTS 100   /**< Maximal length of the path. */
+#define MAX_REGIONS 8       /**< The maximal number of cost regions. */
+#define MAX_REGION_PTS 48   /**< The maximal number of cost region vertices. */
+#define OA_GRID_W 16        /**< Number of columns of the point location grid. */
+#define OA_GRID_H 16        /**< Number of rows of the point location grid. */
+#define OA_FREE_MARGIN 1.   /**< Distance to the obstacle of a start or goal moved out of it, in mm. */
+
+/** rparent value of the rays leaving the root of the search. */
+#define OA_NO_RAY 0xffff
+
+/** Number of bytes needed by a bitset of n elements. */
+#define OA_BITSET_LEN(n) (((n) + 7) / 8)
+
+/** Legacy search: weights the whole visibility graph before extracting
+ * the path. */
+#define OA_SEARCH_FULL 0
+
+/** Dijkstra stopping as soon as the path end is settled (default). */
+#define OA_SEARCH_EARLY_EXIT 1
+
+/** Dijkstra run from both ends at the same time, stopping when the two
+ * search trees meet on a shortest path. */
+#define OA_SEARCH_BIDIRECTIONAL 2
 
 
 /** @struct obstacle_avoidance
@@ -94,18 +119,62 @@
 struct obstacle_avoidance {
 	poly_t polys[MAX_POLY];  /**< Array of polygons (obstacles). */
 	point_t points[MAX_PTS]; /**< Array of points, referenced by polys */
-	uint8_t valid[MAX_PTS]; /**< Used by the Dijkstra algorithm to say if a point was visited. */
-	int32_t pweight[MAX_PTS]; /**< Weight of a point in Dijkstra. */
-	uint8_t p[MAX_PTS]; /**< @todo Dafuq ? */
-	uint8_t pt[MAX_PTS]; /**< Stores all the points. */
+	uint8_t reached[OA_BITSET_LEN(MAX_PTS)]; /**< Bitset of the points which have a weight in the search tree. */
+	uint8_t todo[OA_BITSET_LEN(MAX_PTS)]; /**< Bitset of the points that must be visited by Dijkstra. */
+	float pweight[MAX_PTS]; /**< Cost of the best known path from the tree root to each point. */
+	uint8_t p[MAX_PTS]; /**< Polygon index of the parent of each point in the path tree. */
+	uint8_t pt[MAX_PTS]; /**< Point index (in its polygon) of the parent of each point. */
+
+	/* Second search tree, only used by the bidirectional search. */
+	uint8_t breached[OA_BITSET_LEN(MAX_PTS)]; /**< Same as reached, for the tree grown from the start point. */
+	uint8_t btodo[OA_BITSET_LEN(MAX_PTS)]; /**< Same as todo, for the tree grown from the start point. */
+	float bweight[MAX_PTS]; /**< Same as pweight, for the tree grown from the start point. */
+	uint8_t bp[MAX_PTS]; /**< Same as p, for the tree grown from the start point. */
+	uint8_t bpt[MAX_PTS]; /**< Same as pt, for the tree grown from the start point. */
+
+	/** Adjacency of the visibility graph. The neighbours of point n
+	 * are adj[adj_start[n]] to adj[adj_start[n+1]-1]. Each entry is the
+	 * offset in u.rays of the (poly, point) couple at the other end of
+	 * the ray, so the ray weight is weight[adj[i]/4]. */
+	uint16_t adj_start[MAX_PTS+1];
+	uint16_t adj[MAX_RAYS]; /**< See adj_start. */
 
+	/* Search on the directed rays, only used with turn costs. State i
+	 * is the ray adj[i] followed from the point whose list contains i,
+	 * so the turn at its end is known. */
+	uint8_t rreached[OA_BITSET_LEN(MAX_RAYS)]; /**< Same as reached, for the directed rays. */
+	uint8_t rtodo[OA_BITSET_LEN(MAX_RAYS)]; /**< Same as todo, for the directed rays. */
+	float rweight[MAX_RAYS]; /**< Cost from the tree root to the end of each directed ray. */
+	uint16_t rparent[MAX_RAYS]; /**< Previous directed ray, OA_NO_RAY for the rays leaving the root. */
+	float point_turn_cost[MAX_PTS]; /**< Turn cost of each point, added to turn_cost, see oa_poly_set_turn_cost(). */
+	uint8_t point_turn_costs; /**< 1 once a point has its own turn cost. */
 
+	cost_region_t regions[MAX_REGIONS]; /**< Cost regions, see oa_new_cost_region(). */
+	point_t region_points[MAX_REGION_PTS]; /**< Vertices of the cost regions. */
+	uint8_t region_n; /**< Number of cost regions. */
+	uint8_t region_pt_n; /**< Number of cost region vertices used. */
+
+	/** Point location grid over the bounding box. Each cell has the
+	 * bitset of the polygons whose bounding box meets it, updated
+	 * lazily from grid_dirty before each query. */
+	uint8_t grid[OA_GRID_W*OA_GRID_H][OA_BITSET_LEN(MAX_POLY)];
+	uint8_t grid_box[MAX_POLY][4]; /**< Cells x1, y1, x2, y2 of each indexed polygon, x1 = 0xff if none. */
+	uint8_t grid_dirty[OA_BITSET_LEN(MAX_POLY)]; /**< Polygons modified since they were indexed. */
+	int32_t grid_x1, grid_y1, grid_x2, grid_y2; /**< Bounding box the grid was built for. */
+
+	const struct oa_map *map; /**< Static obstacles loaded by oa_load_map(), or NULL. */
+	uint8_t static_poly_n; /**< Index of the first polygon which is not in the map. */
+
+	uint8_t search_mode; /**< One of the OA_SEARCH_* values. */
+	uint8_t rays_sweep; /**< Build the visibility graph with calc_rays_sweep(). */
+	float checkpoint_cost; /**< Cost added for each checkpoint of the path, in mm. */
+	float turn_cost; /**< Cost of turning in place, in mm per radian. */
 	
-	uint8_t ray_n; /**< Number of computed rays. */
+	uint16_t ray_n; /**< Number of computed rays. */
 	uint8_t cur_poly_idx; /**< Index of the current polygon (for adding polygons). */
 	uint8_t cur_pt_idx; /**< Index of the current point in the current polygon. */
 
-	uint16_t weight[MAX_RAYS]; /**< Length of each ray. */
+	float weight[MAX_RAYS]; /**< Length of each ray, in mm. */
 	union {
 		uint8_t rays[MAX_RAYS*2]; /**< All valid rays given by Dijkstra. */
 		point_t res[MAX_CHKPOINTS]; /**< Resulting path. */
@@ -121,7 +190,69 @@ void oa_init(void);
 /** Set the start and destination point. */
 void oa_start_end_points(int32_t st_x, int32_t st_y, int32_t en_x, int32_t en_y);
 
+struct oa_map;
+
+/** Loads the static obstacles of a precomputed map.
+ *
+ * Must be called just after oa_init(). The map polygons become the
+ * first obstacles, with the map bounding box and tangent pruning, and
+ * oa_process() reuses the precomputed rays between them instead of
+ * computing the whole visibility graph: only the rays ending on the
+ * start/stop points or on the polygons added by oa_new_poly() are
+ * computed. The static polygons must not be modified afterwards.
+ *
+ * The vertices are copied (the search marks them by their position in
+ * the obstacle avoidance), the rays are used in place, so the map must
+ * stay valid until the next oa_init().
+ * @param [in] map The map, see oa_map_open().
+ * @return 0 on success, -1 if the obstacle avoidance is full or was
+ * not just initialized.
+ */
+int8_t oa_load_map(const struct oa_map *map);
+
+/** Computes the path between two waypoints of the loaded map.
+ *
+ * The shortest path around the static obstacles comes from the table
+ * of the map. If none of the other polygons crosses it, it is the
+ * result and there is no search at all. Otherwise this is the same as
+ * oa_start_end_points() with the two waypoints, then oa_process(), which
+ * is also the case when there are cost regions, turn costs, or when the
+ * checkpoint cost differs from the one the map was compiled with (-k of
+ * oa_mapc).
+ * @param [in] from, to Indexes of the waypoints in the map.
+ * @return Same as oa_process(), the path is given by oa_get_path().
+ */
+int8_t oa_process_waypoints(uint8_t from, uint8_t to);
+
+/** Create a new cost region.
+ *
+ * A cost region is a convex area the robot may cross, but where each mm
+ * costs factor mm: a factor of 3 makes the planner accept a detour up to
+ * twice the length crossed in the region to avoid it (opponent start
+ * area, fragile game elements, narrow gaps). A factor below 1 makes an
+ * area preferred. The vertices are set with oa_cost_region_set_point().
+ * The region must be convex (split a concave area in several regions):
+ * oa_process() fails with -4 otherwise. While there are cost regions,
+ * oa_process() keeps all the rays instead of the tangent ones, and
+ * recomputes the rays of a map built with tangent pruning: the search is
+ * slower.
+ * @param [in] size Number of points of the region, at least 3.
+ * @param [in] factor Cost of 1 mm inside the region, in mm, >= 0.
+ * @return NULL if there is no room left.
+ * @return Adress of the polygon of the region if OK.
+ */
+poly_t *oa_new_cost_region(uint8_t size, float factor);
+
+/** Set a point of a cost region. */
+void oa_cost_region_set_point(poly_t *pol, int32_t x, int32_t y, uint8_t i);
+
+/** Remove all the cost regions. */
+void oa_clear_cost_regions(void);
+
 /** Create a new obstacle polygon.
+ *
+ * The polygon may be concave (an L or U shaped table element), as long
+ * as its edges do not cross each other.
  * @param [in] size Number of point in the polygon.
  * @return NULL on error.
  * @return Adress of the polygon if OK.
@@ -129,6 +260,54 @@ void oa_start_end_points(int32_t st_x, int32_t st_y, int32_t en_x, int32_t en_y)
 poly_t *oa_new_poly(uint8_t size);
 
 
+/** Selects the shortest path search used by oa_process().
+ * @param [in] mode OA_SEARCH_FULL, OA_SEARCH_EARLY_EXIT or
+ * OA_SEARCH_BIDIRECTIONAL. All of them give the same path length.
+ */
+void oa_set_search_mode(uint8_t mode);
+
+/** Selects how oa_process() builds the visibility graph.
+ * @param [in] enable 1 to use the rotational sweep (calc_rays_sweep()),
+ * faster on maps with many vertices, 0 (default) to use calc_rays().
+ * @note Not used when a map is loaded, see oa_load_map().
+ */
+void oa_set_rays_sweep(uint8_t enable);
+
+/** Sets the cost of each checkpoint of the path.
+ *
+ * It represents the time lost to stop and start again at a checkpoint,
+ * expressed as a distance (mm). With a non zero value, the search
+ * prefers (A, C) to (A, B, C) when the 3 points are aligned. Default
+ * is 1.
+ */
+void oa_set_checkpoint_cost(float mm);
+
+/** Sets the cost of turning in place at a checkpoint.
+ *
+ * This should be the distance the robot travels in the time it needs
+ * to turn by one radian, i.e. the ratio between the linear and angular
+ * speeds. The default (0) searches for the shortest path.
+ *
+ * With turn costs (this one or oa_poly_set_turn_cost()), the cost of a
+ * ray depends on the ray the robot arrives from, so the search runs on
+ * the directed rays instead of the points, whatever the search mode:
+ * the path has the lowest cost, length plus checkpoints plus turns. It
+ * visits up to twice as many states as there are rays, so it is slower.
+ * The heading of the robot at the start and at the goal is not counted.
+ */
+void oa_set_turn_cost(float mm_per_rad);
+
+/** Sets the turn cost of a vertex, added to the one of oa_set_turn_cost().
+ *
+ * For places where turning is slower or riskier than elsewhere, for
+ * example close to the border or to fragile elements.
+ * @param [in] pol The polygon, from oa_new_poly().
+ * @param [in] i The index of the vertex.
+ * @param [in] mm_per_rad The cost, see oa_set_turn_cost(). It is kept
+ * until oa_init().
+ */
+void oa_poly_set_turn_cost(poly_t *pol, uint8_t i, float mm_per_rad);
+
 /** Dump status of the obstacle avoidance. */
 void oa_dump(void);
 
@@ -139,10 +318,53 @@ void oa_dump(void);
  */
 void oa_poly_set_point(poly_t *pol, int32_t x, int32_t y, uint8_t i);
 
+/** Tells the obstacle avoidance that a polygon was modified without
+ * oa_poly_set_point(), for example by changing its length. */
+void oa_poly_moved(poly_t *pol);
+
+/** Removes an obstacle polygon.
+ *
+ * The polygon is emptied but keeps its place, so it can get new points
+ * later with oa_poly_set_point() after setting its length.
+ */
+void oa_poly_remove(poly_t *pol);
+
+/** Finds the obstacle containing a point.
+ *
+ * A coarse grid over the bounding box gives the polygons which may
+ * contain the point, so only those are tested.
+ * @param [in] x, y The point, in mm.
+ * @return The first polygon strictly containing the point (not the
+ * start/stop one), NULL if the point is free.
+ */
+poly_t *oa_poly_containing(int32_t x, int32_t y);
+
+/** Finds the free point nearest to a point inside obstacles.
+ *
+ * oa_process() uses it to push the start or the goal out of the grown
+ * obstacles. The grid cells are visited by increasing
+ * distance from the point. The projections of the point on the edges
+ * of their polygons, and the intersections of these edges where
+ * obstacles overlap, are the candidates, until no nearer cell is left.
+ * @param [in] x, y The point, in mm.
+ * @param [in] margin Distance to keep from the obstacle edge, in mm.
+ * @param [out] res The free point, may be the point itself.
+ * @return 0 if the point was free, 1 if it was moved, -1 if no free
+ * point was found in the bounding box.
+ */
+int8_t oa_nearest_free_point(int32_t x, int32_t y, float margin, point_t *res);
+
 
 /** Processes the path.
+ *
+ * A start or a goal inside an obstacle is first moved to the nearest free
+ * point, OA_FREE_MARGIN away from the obstacle (see
+ * oa_nearest_free_point()). The path then ends at the moved goal, and
+ * begins with the moved start, so the robot first leaves the obstacle.
  * @returns The number of points in the path on sucess
- * @returns An error code < 0 in case of failure.
+ * @returns An error code < 0 in case of failure, -4 if a cost region is
+ * not convex, -5 if the rays do not fit in MAX_RAYS (the path would miss
+ * some of them).
  */
 int8_t oa_process(void);
 
@@ -0,0 +1,365 @@
+/** @file modules/odometry_calibration/odometry_calibration.c
+ * @author CVRA
+ * @brief Least squares calibration of the odometry from recorded runs.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "odometry_calibration.h"
+
+/** Relative change of the parameters used for the finite differences. */
+#define ODOCAL_RELATIVE_STEP 1e-6
+
+/** Finite difference step of the wheel angles, in radians. */
+#define ODOCAL_ANGLE_STEP 1e-6
+
+/** Damping above which no better parameters are expected. */
+#define ODOCAL_MAX_LAMBDA 1e12
+
+/** Initializes what is common to both robots. */
+static void odocal_init_common(struct odometry_calibration *cal)
+{
+    cal->in_run = 0;
+    cal->best_cost = -1.;
+    cal->lambda = 1e-3;
+    cal->weight_xy = 1.;
+    cal->weight_a = 1000.;
+    cal->tolerance = 1e-9;
+    cal->pass_n = 0;
+    odocal_pass_begin(cal);
+}
+
+void odocal_init_2wheels(struct odometry_calibration *cal, double track_mm,
+                         double distance_imp_per_mm, double left_gain,
+                         double right_gain)
+{
+    int i;
+
+    memset(cal, 0, sizeof(*cal));
+    cal->type = ODOCAL_2WHEELS;
+    cal->param_n = 3;
+    cal->wheel_n = 2;
+
+    cal->params[0] = left_gain / distance_imp_per_mm;
+    cal->params[1] = right_gain / distance_imp_per_mm;
+    cal->params[2] = track_mm;
+    for (i = 0; i < 3; i++)
+        cal->step[i] = fabs(cal->params[i]) * ODOCAL_RELATIVE_STEP;
+
+    odocal_init_common(cal);
+}
+
+void odocal_init_holonomic(struct odometry_calibration *cal,
+                           const double beta[3], const double wheel_radius[3],
+                           const double wheel_distance[3],
+                           int32_t encoder_resolution)
+{
+    int i;
+
+    memset(cal, 0, sizeof(*cal));
+    cal->type = ODOCAL_HOLONOMIC;
+    cal->param_n = 7;
+    cal->wheel_n = 3;
+    cal->inv_encoder_resolution = 2.0 * M_PI / (double)encoder_resolution;
+
+    for (i = 0; i < 3; i++) {
+        cal->wheel_distance[i] = wheel_distance[i];
+        cal->params[i] = wheel_radius[i];
+        cal->params[3] += wheel_distance[i];
+        cal->params[4 + i] = beta[i];
+    }
+    for (i = 0; i < 4; i++)
+        cal->step[i] = fabs(cal->params[i]) * ODOCAL_RELATIVE_STEP;
+    for (i = 4; i < 7; i++)
+        cal->step[i] = ODOCAL_ANGLE_STEP;
+
+    odocal_init_common(cal);
+}
+
+void odocal_set_weights(struct odometry_calibration *cal, double xy_mm, double a_rad)
+{
+    cal->weight_xy = 1. / xy_mm;
+    cal->weight_a = 1. / a_rad;
+}
+
+/** Moves a pose by the encoder steps of a sample, as the 2 wheels
+ * position_manage() does. */
+static void odocal_move_2wheels(const double *p, struct odocal_pose *pose,
+                                const int32_t *steps)
+{
+    const double left = p[0] * steps[0];
+    const double right = p[1] * steps[1];
+    const double ds = (right + left) / 2.;
+    const double da = (right - left) / p[2];
+    double chord;
+
+    /* Chord of the arc, 2 r sin(da / 2), without dividing by da. */
+    if (fabs(da) < 1e-9)
+        chord = ds;
+    else
+        chord = ds * sin(da / 2.) / (da / 2.);
+
+    pose->x += chord * cos(pose->a + da / 2.);
+    pose->y += chord * sin(pose->a + da / 2.);
+    pose->a += da;
+}
+
+/** Moves a pose by the encoder steps of a sample, as
+ * holonomic_position_manage() does. */
+static void odocal_move_holonomic(const struct odometry_calibration *cal,
+                                  const double *p, struct odocal_pose *pose,
+                                  const int32_t *steps)
+{
+    double sum_steps_dist = 0., sum_cos = 0., sum_sin = 0.;
+    double dx, dy, cos_a, sin_a;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        /* the position manager negates the encoder values */
+        const double dist_steps = -steps[i] * p[i];
+
+        sum_steps_dist += dist_steps;
+        sum_cos += cos(p[4 + i]) * dist_steps;
+        sum_sin += sin(p[4 + i]) * dist_steps;
+    }
+
+    pose->a -= sum_steps_dist * cal->inv_encoder_resolution / p[3];
+    dx = 2. / 3. * sum_cos * cal->inv_encoder_resolution;
+    dy = 2. / 3. * sum_sin * cal->inv_encoder_resolution;
+
+    cos_a = cos(pose->a - M_PI_2);
+    sin_a = sin(pose->a - M_PI_2);
+    pose->x += cos_a * dx - sin_a * dy;
+    pose->y += sin_a * dx + cos_a * dy;
+}
+
+/** Computes the weighted error of a pose. */
+static void odocal_residual(const struct odometry_calibration *cal,
+                            const struct odocal_pose *pose,
+                            const struct odocal_pose *ref, double r[3])
+{
+    double da = fmod(pose->a - ref->a, 2. * M_PI);
+
+    if (da > M_PI)
+        da -= 2. * M_PI;
+    else if (da < -M_PI)
+        da += 2. * M_PI;
+
+    r[0] = (pose->x - ref->x) * cal->weight_xy;
+    r[1] = (pose->y - ref->y) * cal->weight_xy;
+    r[2] = da * cal->weight_a;
+}
+
+/** Solves (A + lambda diag(A)) x = b by Gaussian elimination.
+ * @return 0 on success, -1 if the system is singular. */
+static int8_t odocal_solve(uint8_t n, double a[ODOCAL_MAX_PARAMS][ODOCAL_MAX_PARAMS],
+                           const double *b, double lambda, double *x)
+{
+    double m[ODOCAL_MAX_PARAMS][ODOCAL_MAX_PARAMS + 1];
+    uint8_t i, j, k, pivot;
+    double tmp;
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++)
+            m[i][j] = a[i][j];
+        m[i][i] *= 1. + lambda;
+        m[i][n] = b[i];
+    }
+
+    for (k = 0; k < n; k++) {
+        pivot = k;
+        for (i = k + 1; i < n; i++)
+            if (fabs(m[i][k]) > fabs(m[pivot][k]))
+                pivot = i;
+        if (m[pivot][k] == 0.)
+            return -1;
+        for (j = k; j <= n; j++) {
+            tmp = m[k][j];
+            m[k][j] = m[pivot][j];
+            m[pivot][j] = tmp;
+        }
+        for (i = k + 1; i < n; i++) {
+            tmp = m[i][k] / m[k][k];
+            for (j = k; j <= n; j++)
+                m[i][j] -= tmp * m[k][j];
+        }
+    }
+
+    for (i = n; i-- > 0;) {
+        tmp = m[i][n];
+        for (j = i + 1; j < n; j++)
+            tmp -= m[i][j] * x[j];
+        x[i] = tmp / m[i][i];
+    }
+    return 0;
+}
+
+void odocal_pass_begin(struct odometry_calibration *cal)
+{
+    memset(cal->jtj, 0, sizeof(cal->jtj));
+    memset(cal->jtr, 0, sizeof(cal->jtr));
+    cal->cost = 0.;
+    cal->run_n = 0;
+    cal->sample_n = 0;
+    cal->in_run = 0;
+}
+
+void odocal_run_begin(struct odometry_calibration *cal, const struct odocal_pose *start)
+{
+    uint8_t k;
+
+    for (k = 0; k <= cal->param_n; k++) {
+        memcpy(cal->run_params[k], cal->params, sizeof(cal->params));
+        if (k > 0)
+            cal->run_params[k][k - 1] += cal->step[k - 1];
+        cal->poses[k] = *start;
+    }
+    cal->has_prev = 0;
+    cal->in_run = 1;
+}
+
+void odocal_add_sample(struct odometry_calibration *cal, const int32_t *enc)
+{
+    int32_t steps[3];
+    uint8_t i, k;
+
+    if (!cal->in_run)
+        return;
+
+    for (i = 0; i < cal->wheel_n; i++) {
+        steps[i] = enc[i] - cal->prev_enc[i];
+        cal->prev_enc[i] = enc[i];
+    }
+    if (!cal->has_prev) {
+        cal->has_prev = 1;
+        return;
+    }
+
+    for (k = 0; k <= cal->param_n; k++) {
+        if (cal->type == ODOCAL_2WHEELS)
+            odocal_move_2wheels(cal->run_params[k], &cal->poses[k], steps);
+        else
+            odocal_move_holonomic(cal, cal->run_params[k], &cal->poses[k], steps);
+    }
+    cal->sample_n++;
+}
+
+void odocal_run_end(struct odometry_calibration *cal, const struct odocal_pose *end)
+{
+    double r[3], rk[3], jac[3][ODOCAL_MAX_PARAMS];
+    uint8_t i, j, k;
+
+    if (!cal->in_run)
+        return;
+    cal->in_run = 0;
+
+    odocal_residual(cal, &cal->poses[0], end, r);
+    for (k = 0; k < cal->param_n; k++) {
+        odocal_residual(cal, &cal->poses[k + 1], end, rk);
+        for (i = 0; i < 3; i++)
+            jac[i][k] = (rk[i] - r[i]) / cal->step[k];
+    }
+
+    for (i = 0; i < 3; i++) {
+        cal->cost += r[i] * r[i];
+        for (j = 0; j < cal->param_n; j++) {
+            cal->jtr[j] += jac[i][j] * r[i];
+            for (k = 0; k < cal->param_n; k++)
+                cal->jtj[j][k] += jac[i][j] * jac[i][k];
+        }
+    }
+    cal->run_n++;
+}
+
+int8_t odocal_pass_end(struct odometry_calibration *cal)
+{
+    double delta[ODOCAL_MAX_PARAMS], previous_cost;
+    uint8_t i, small_step;
+
+    cal->in_run = 0;
+    if (cal->run_n == 0)
+        return ODOCAL_ERR_NO_RUN;
+    cal->pass_n++;
+
+    if (cal->best_cost >= 0. && cal->cost > cal->best_cost) {
+        /* Worse than the best parameters: go back to them, and take a
+         * shorter step, closer to the gradient. */
+        memcpy(cal->params, cal->best_params, sizeof(cal->params));
+        cal->lambda *= 10.;
+        if (cal->lambda > ODOCAL_MAX_LAMBDA)
+            return ODOCAL_CONVERGED;
+    }
+    else {
+        previous_cost = cal->best_cost;
+        cal->best_cost = cal->cost;
+        memcpy(cal->best_params, cal->params, sizeof(cal->params));
+        memcpy(cal->best_jtj, cal->jtj, sizeof(cal->jtj));
+        memcpy(cal->best_jtr, cal->jtr, sizeof(cal->jtr));
+
+        if (previous_cost >= 0.) {
+            if (previous_cost - cal->cost <= cal->tolerance * previous_cost)
+                return ODOCAL_CONVERGED;
+            cal->lambda /= 10.;
+            if (cal->lambda < 1e-9)
+                cal->lambda = 1e-9;
+        }
+    }
+
+    if (odocal_solve(cal->param_n, cal->best_jtj, cal->best_jtr, cal->lambda, delta) < 0)
+        return ODOCAL_ERR_SINGULAR;
+
+    small_step = 1;
+    for (i = 0; i < cal->param_n; i++) {
+        cal->params[i] -= delta[i];
+        if (fabs(delta[i]) > cal->step[i] * 1e-3)
+            small_step = 0;
+    }
+
+    /* The step would not change the odometry: the best parameters are
+     * the final ones. */
+    if (small_step) {
+        memcpy(cal->params, cal->best_params, sizeof(cal->params));
+        return ODOCAL_CONVERGED;
+    }
+    return ODOCAL_CONTINUE;
+}
+
+double odocal_get_rms(struct odometry_calibration *cal)
+{
+    double cost = cal->best_cost >= 0. ? cal->best_cost : cal->cost;
+
+    if (cal->run_n == 0)
+        return 0.;
+    return sqrt(cost / (3. * cal->run_n));
+}
+
+void odocal_get_2wheels(struct odometry_calibration *cal, double *track_mm,
+                        double *distance_imp_per_mm, double *left_gain,
+                        double *right_gain)
+{
+    const double *p = cal->best_cost >= 0. ? cal->best_params : cal->params;
+
+    *distance_imp_per_mm = 2. / (p[0] + p[1]);
+    *left_gain = p[0] * *distance_imp_per_mm;
+    *right_gain = p[1] * *distance_imp_per_mm;
+    *track_mm = p[2];
+}
+
+double odocal_get_holonomic(struct odometry_calibration *cal, double beta[3],
+                            double wheel_radius[3], double wheel_distance[3])
+{
+    const double *p = cal->best_cost >= 0. ? cal->best_params : cal->params;
+    double sum = 0.;
+    int i;
+
+    for (i = 0; i < 3; i++)
+        sum += cal->wheel_distance[i];
+
+    for (i = 0; i < 3; i++) {
+        wheel_radius[i] = p[i];
+        wheel_distance[i] = cal->wheel_distance[i] * p[3] / sum;
+        beta[i] = p[4 + i];
+    }
+
+    return p[3] / sum;
+}
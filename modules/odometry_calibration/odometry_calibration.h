@@ -0,0 +1,197 @@
+/** @file modules/odometry_calibration/odometry_calibration.h
+ * @author CVRA
+ * @brief Least squares calibration of the odometry from recorded runs.
+ *
+ * The odometry parameters (track and encoder gains of a 2 wheeled robot,
+ * wheel radii and distances of a holonomic base) are measured by hand,
+ * and each error turns into a drift which the strategy must correct. This
+ * module fits them to recorded runs: streams of encoder values, each run
+ * starting and ending at a known reference pose (a border, a marked
+ * position, an external tracker). For a 2 wheeled robot, driving squares
+ * both clockwise and counter clockwise as in UMBmark separates the wheel
+ * diameter error from the track error. As a loop coming back to its
+ * start does not tell the scale of the odometry, at least one run must
+ * end far from its start.
+ *
+ * The fit is a Levenberg-Marquardt least squares on the final pose errors
+ * of the runs. The odometry is integrated exactly as position_manager
+ * does, so the results can be given to it as they are. The samples are
+ * never stored: each pass over the recording integrates, next to the
+ * odometry with the current parameters, one odometry per parameter with
+ * this parameter slightly changed, which gives the Jacobian by finite
+ * differences. A recording of hundreds of thousands of samples is read a
+ * few times, from a file or any stream:
+ * @code
+ * odocal_init_2wheels(&cal, track_mm, imp_per_mm, left_gain, right_gain);
+ * do {
+ *     odocal_pass_begin(&cal);
+ *     for each run of the recording {
+ *         odocal_run_begin(&cal, &start);
+ *         for each sample
+ *             odocal_add_sample(&cal, enc);
+ *         odocal_run_end(&cal, &end);
+ *     }
+ * } while (odocal_pass_end(&cal) == ODOCAL_CONTINUE);
+ * odocal_get_2wheels(&cal, &track_mm, &imp_per_mm, &left_gain, &right_gain);
+ * @endcode
+ *
+ * tools/odocal does this with a recording in a text file.
+ */
+
+#ifndef _ODOMETRY_CALIBRATION_H_
+#define _ODOMETRY_CALIBRATION_H_
+
+#include <stdint.h>
+
+/** Maximal number of fitted parameters. */
+#define ODOCAL_MAX_PARAMS 7
+
+#define ODOCAL_2WHEELS 0   /**< Differential drive, see robot_system. */
+#define ODOCAL_HOLONOMIC 1 /**< 3 wheeled holonomic base. */
+
+/** Return values of odocal_pass_end(). */
+#define ODOCAL_CONTINUE 0        /**< The parameters changed, run another pass. */
+#define ODOCAL_CONVERGED 1       /**< The parameters are the best ones found. */
+#define ODOCAL_ERR_NO_RUN -1     /**< The pass had no complete run. */
+#define ODOCAL_ERR_SINGULAR -2   /**< The runs do not constrain the parameters. */
+
+/** A pose of the robot. */
+struct odocal_pose {
+    double x;  /**< In mm. */
+    double y;  /**< In mm. */
+    double a;  /**< In radians. */
+};
+
+/** Instance of the calibration. */
+struct odometry_calibration {
+    uint8_t type;       /**< ODOCAL_2WHEELS or ODOCAL_HOLONOMIC. */
+    uint8_t param_n;    /**< Number of fitted parameters. */
+    uint8_t wheel_n;    /**< Number of encoders of a sample. */
+
+    /** Fitted parameters.
+     * 2 wheels: mm per tick of the left and right wheels, track in mm.
+     * Holonomic: wheel_radius[3], sum of wheel_distance[3], beta[3]. */
+    double params[ODOCAL_MAX_PARAMS];
+    double step[ODOCAL_MAX_PARAMS];  /**< Finite difference step of each parameter. */
+    double wheel_distance[3];        /**< Holonomic: initial distances, scaled by the fit. */
+    double inv_encoder_resolution;   /**< Holonomic: 2 pi / steps per revolution. */
+
+    /* current run */
+    uint8_t in_run;     /**< 1 between odocal_run_begin() and odocal_run_end(). */
+    uint8_t has_prev;   /**< 1 once the first sample of the run is known. */
+    int32_t prev_enc[3];    /**< Previous sample. */
+    /** Parameters of the odometries integrated in parallel: the current
+     * ones, then each one with a single parameter changed by its step. */
+    double run_params[ODOCAL_MAX_PARAMS + 1][ODOCAL_MAX_PARAMS];
+    struct odocal_pose poses[ODOCAL_MAX_PARAMS + 1]; /**< Poses of these odometries. */
+
+    /* current pass */
+    double jtj[ODOCAL_MAX_PARAMS][ODOCAL_MAX_PARAMS]; /**< J'J of the runs. */
+    double jtr[ODOCAL_MAX_PARAMS];  /**< J'r of the runs. */
+    double cost;                    /**< Sum of the squared weighted errors. */
+    uint32_t run_n;                 /**< Number of runs of the pass. */
+    uint32_t sample_n;              /**< Number of samples of the pass. */
+
+    /* Levenberg-Marquardt */
+    double best_params[ODOCAL_MAX_PARAMS]; /**< Parameters of the lowest cost. */
+    double best_jtj[ODOCAL_MAX_PARAMS][ODOCAL_MAX_PARAMS]; /**< J'J at best_params. */
+    double best_jtr[ODOCAL_MAX_PARAMS];    /**< J'r at best_params. */
+    double best_cost;   /**< Lowest cost, < 0 before the first pass. */
+    double lambda;      /**< Damping. */
+    double weight_xy;   /**< Weight of the position errors, per mm. */
+    double weight_a;    /**< Weight of the angle errors, per radian. */
+    double tolerance;   /**< Relative cost decrease under which it converged. */
+    uint16_t pass_n;    /**< Number of completed passes. */
+};
+
+/** Initializes a calibration of a 2 wheeled robot.
+ *
+ * The parameters are the ones of position_set_physical_params() and
+ * the gain argument of rs_set_left_ext_encoder() /
+ * rs_set_right_ext_encoder(). The samples are the raw left and right
+ * external encoder values.
+ * @param [in] cal The odometry_calibration instance.
+ * @param [in] track_mm The distance between the wheels, in mm.
+ * @param [in] distance_imp_per_mm The number of encoder pulses for one mm.
+ * @param [in] left_gain, right_gain The gains of the encoders.
+ */
+void odocal_init_2wheels(struct odometry_calibration *cal, double track_mm,
+                         double distance_imp_per_mm, double left_gain,
+                         double right_gain);
+
+/** Initializes a calibration of a holonomic base.
+ *
+ * The parameters are the ones of holonomic_position_set_physical_params().
+ * The position manager switches between the inner and outer distance of
+ * each wheel depending on the rollers touching the floor, the model uses
+ * their mean. The odometry only depends on the sum of the distances, so
+ * the fit scales all of them by the same factor, which
+ * odocal_get_holonomic() returns: apply it to wheel_inner_distance and
+ * wheel_outer_distance too. The samples are the
+ * raw values of the 3 motor encoders.
+ * @param [in] cal The odometry_calibration instance.
+ * @param [in] beta Angles of the wheels, in radians.
+ * @param [in] wheel_radius Radii of the wheels.
+ * @param [in] wheel_distance Mean distances of the wheels to the center.
+ * @param [in] encoder_resolution Encoder steps per revolution of a wheel.
+ */
+void odocal_init_holonomic(struct odometry_calibration *cal,
+                           const double beta[3], const double wheel_radius[3],
+                           const double wheel_distance[3],
+                           int32_t encoder_resolution);
+
+/** Sets the weights of the errors.
+ *
+ * The fit minimizes the sum of (position error / xy)^2 + (angle error /
+ * a)^2, so xy and a are the errors considered equivalent, by default
+ * 1 mm and 1 mrad.
+ */
+void odocal_set_weights(struct odometry_calibration *cal, double xy_mm, double a_rad);
+
+/** Starts a pass over the recording. */
+void odocal_pass_begin(struct odometry_calibration *cal);
+
+/** Starts a run at a reference pose. */
+void odocal_run_begin(struct odometry_calibration *cal, const struct odocal_pose *start);
+
+/** Integrates a sample of the current run.
+ * @param [in] cal The odometry_calibration instance.
+ * @param [in] enc Encoder values, 2 or 3 depending on the robot. The
+ * first sample of a run only sets the reference values.
+ */
+void odocal_add_sample(struct odometry_calibration *cal, const int32_t *enc);
+
+/** Ends a run at a reference pose, and adds its error to the pass. */
+void odocal_run_end(struct odometry_calibration *cal, const struct odocal_pose *end);
+
+/** Ends a pass, and updates the parameters.
+ * @return ODOCAL_CONTINUE if another pass is needed, ODOCAL_CONVERGED when
+ * the parameters are final, or an ODOCAL_ERR_* code.
+ */
+int8_t odocal_pass_end(struct odometry_calibration *cal);
+
+/** Returns the RMS of the weighted errors of the runs, with the best
+ * parameters. */
+double odocal_get_rms(struct odometry_calibration *cal);
+
+/** Gets the fitted parameters of a 2 wheeled robot.
+ *
+ * The gains are normalized so their mean is 1.
+ */
+void odocal_get_2wheels(struct odometry_calibration *cal, double *track_mm,
+                        double *distance_imp_per_mm, double *left_gain,
+                        double *right_gain);
+
+/** Gets the fitted parameters of a holonomic base.
+ *
+ * @param [in] cal The odometry_calibration instance.
+ * @param [out] beta Angles of the wheels, in radians.
+ * @param [out] wheel_radius Radii of the wheels.
+ * @param [out] wheel_distance Mean distances of the wheels to the center.
+ * @return The factor applied to all the wheel distances, by which the inner
+ * and outer distances must be multiplied as well.
+ */
+double odocal_get_holonomic(struct odometry_calibration *cal, double beta[3],
+                            double wheel_radius[3], double wheel_distance[3]);
+
+#endif
@@ -0,0 +1,191 @@
+/** @file modules/planner_service/planner_service.c
+ * @author CVRA
+ * @brief Runs the obstacle avoidance in the background.
+ */
+
+#include <string.h>
+#include "planner_service.h"
+
+/** Flag of planner_service::middle, set when it holds an unread result. */
+#define PLANNER_SERVICE_FRESH 0x80
+
+/* Locking, removed when everything runs in a single thread. */
+#ifdef CONFIG_MODULE_PLANNER_SERVICE_NO_THREAD
+#define PLANNER_SERVICE_LOCK(ps, lock) ((void)(ps))
+#define PLANNER_SERVICE_UNLOCK(ps, lock) ((void)(ps))
+#define PLANNER_SERVICE_SIGNAL(ps) ((void)(ps))
+#else
+#define PLANNER_SERVICE_LOCK(ps, lock) pthread_mutex_lock(&(ps)->lock)
+#define PLANNER_SERVICE_UNLOCK(ps, lock) pthread_mutex_unlock(&(ps)->lock)
+#define PLANNER_SERVICE_SIGNAL(ps) pthread_cond_signal(&(ps)->request_cond)
+#endif
+
+void planner_service_init(struct planner_service *ps)
+{
+    int i;
+
+    memset(ps, 0, sizeof(struct planner_service));
+#ifndef CONFIG_MODULE_PLANNER_SERVICE_NO_THREAD
+    pthread_mutex_init(&ps->map_lock, NULL);
+    pthread_mutex_init(&ps->request_lock, NULL);
+    pthread_cond_init(&ps->request_cond, NULL);
+#endif
+
+    for (i = 0; i < 3; i++)
+        ps->buffers[i].len = PLANNER_SERVICE_PENDING;
+    ps->back = 0;
+    ps->middle = 1;
+    ps->front = 2;
+}
+
+uint32_t planner_service_request(struct planner_service *ps,
+                                 int32_t start_x, int32_t start_y,
+                                 int32_t goal_x, int32_t goal_y)
+{
+    uint32_t id;
+
+    PLANNER_SERVICE_LOCK(ps, request_lock);
+
+    /* the previous request was not taken yet, replace it */
+    if (ps->request_id != ps->processed_id)
+        ps->dropped++;
+
+    ps->start_x = start_x;
+    ps->start_y = start_y;
+    ps->goal_x = goal_x;
+    ps->goal_y = goal_y;
+
+    /* 0 means no request */
+    if (++ps->request_id == 0)
+        ps->request_id = 1;
+    id = ps->request_id;
+
+    PLANNER_SERVICE_SIGNAL(ps);
+    PLANNER_SERVICE_UNLOCK(ps, request_lock);
+
+    return id;
+}
+
+/** Makes the back buffer available to the reader and takes the spare one. */
+static void planner_service_publish(struct planner_service *ps)
+{
+    uint8_t back = ps->back | PLANNER_SERVICE_FRESH;
+
+    back = __atomic_exchange_n(&ps->middle, back, __ATOMIC_ACQ_REL);
+    ps->back = back & ~PLANNER_SERVICE_FRESH;
+}
+
+uint8_t planner_service_step(struct planner_service *ps)
+{
+    struct planner_result *res;
+    point_t *path;
+
+    PLANNER_SERVICE_LOCK(ps, request_lock);
+    if (ps->request_id == ps->processed_id) {
+        PLANNER_SERVICE_UNLOCK(ps, request_lock);
+        return 0;
+    }
+
+    res = &ps->buffers[ps->back];
+    res->id = ps->request_id;
+    res->start_x = ps->start_x;
+    res->start_y = ps->start_y;
+    res->goal_x = ps->goal_x;
+    res->goal_y = ps->goal_y;
+    ps->processed_id = ps->request_id;
+    PLANNER_SERVICE_UNLOCK(ps, request_lock);
+
+    PLANNER_SERVICE_LOCK(ps, map_lock);
+    oa_start_end_points(res->start_x, res->start_y, res->goal_x, res->goal_y);
+    res->len = oa_process();
+    if (res->len > 0) {
+        path = oa_get_path();
+        memcpy(res->path, path, res->len * sizeof(point_t));
+    }
+    PLANNER_SERVICE_UNLOCK(ps, map_lock);
+
+    planner_service_publish(ps);
+    __atomic_store_n(&ps->published_id, res->id, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+const struct planner_result *planner_service_get_result(struct planner_service *ps)
+{
+    if (__atomic_load_n(&ps->middle, __ATOMIC_ACQUIRE) & PLANNER_SERVICE_FRESH)
+        ps->front = __atomic_exchange_n(&ps->middle, ps->front, __ATOMIC_ACQ_REL)
+                    & ~PLANNER_SERVICE_FRESH;
+
+    return &ps->buffers[ps->front];
+}
+
+uint8_t planner_service_is_busy(struct planner_service *ps)
+{
+    uint32_t id;
+
+    PLANNER_SERVICE_LOCK(ps, request_lock);
+    id = ps->request_id;
+    PLANNER_SERVICE_UNLOCK(ps, request_lock);
+
+    return id != __atomic_load_n(&ps->published_id, __ATOMIC_ACQUIRE);
+}
+
+#ifndef CONFIG_MODULE_PLANNER_SERVICE_NO_THREAD
+/** Body of the planner thread. */
+static void *planner_service_thread(void *arg)
+{
+    struct planner_service *ps = arg;
+
+    while (1) {
+        pthread_mutex_lock(&ps->request_lock);
+        while (ps->running && ps->request_id == ps->processed_id)
+            pthread_cond_wait(&ps->request_cond, &ps->request_lock);
+
+        if (!ps->running) {
+            pthread_mutex_unlock(&ps->request_lock);
+            break;
+        }
+        pthread_mutex_unlock(&ps->request_lock);
+
+        planner_service_step(ps);
+    }
+
+    return NULL;
+}
+
+int planner_service_start(struct planner_service *ps)
+{
+    int ret;
+
+    ps->running = 1;
+    ret = pthread_create(&ps->thread, NULL, planner_service_thread, ps);
+    if (ret != 0)
+        ps->running = 0;
+
+    return ret;
+}
+
+void planner_service_stop(struct planner_service *ps)
+{
+    pthread_mutex_lock(&ps->request_lock);
+    if (!ps->running) {
+        pthread_mutex_unlock(&ps->request_lock);
+        return;
+    }
+    ps->running = 0;
+    pthread_cond_signal(&ps->request_cond);
+    pthread_mutex_unlock(&ps->request_lock);
+
+    pthread_join(ps->thread, NULL);
+}
+#endif
+
+void planner_service_lock_map(struct planner_service *ps)
+{
+    PLANNER_SERVICE_LOCK(ps, map_lock);
+}
+
+void planner_service_unlock_map(struct planner_service *ps)
+{
+    PLANNER_SERVICE_UNLOCK(ps, map_lock);
+}
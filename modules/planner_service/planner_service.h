@@ -0,0 +1,148 @@
+/** @file modules/planner_service/planner_service.h
+ * @author CVRA
+ * @brief Runs the obstacle avoidance in the background.
+ *
+ * oa_process() can take longer than a control period on a big map, so it
+ * must not be called by the control loop or the trajectory manager. This
+ * module runs it in a thread of its own:
+ *  - planner_service_request() posts a start / goal couple and returns
+ *    immediately. Only the newest request is kept: when a new one arrives
+ *    before the planner took the previous one, the previous one is dropped,
+ *    as its start point is outdated anyway.
+ *  - The planner publishes each path in a triple buffer.
+ *    planner_service_get_result() returns the newest published path without
+ *    any lock, so the reader never waits for the planner and the planner
+ *    never waits for the reader.
+ *
+ * The obstacle avoidance has a single global map, which the planner reads
+ * during the whole search. Code modifying the polygons from another thread
+ * (oa_poly_set_point(), lidar_obstacles_process_scan()...) must hold the
+ * map lock:
+ * @code
+ * planner_service_lock_map(&planner);
+ * lidar_obstacles_process_scan(&lidar, scan, n, x, y, a);
+ * planner_service_unlock_map(&planner);
+ * @endcode
+ *
+ * Usage:
+ * @code
+ * planner_service_init(&planner);
+ * planner_service_start(&planner);
+ *
+ * // strategy
+ * id = planner_service_request(&planner, x, y, goal_x, goal_y);
+ *
+ * // trajectory, at each period
+ * res = planner_service_get_result(&planner);
+ * if (res->id == id && res->len > 0)
+ *     ... follow res->path[0] to res->path[res->len - 1] ...
+ * @endcode
+ *
+ * The thread backend uses POSIX threads. On targets without threads,
+ * define CONFIG_MODULE_PLANNER_SERVICE_NO_THREAD: the locks are then
+ * removed, planner_service_start() and planner_service_stop() do not
+ * exist, and planner_service_step() is called from a low priority task of
+ * the scheduler instead. The request and result functions must then not
+ * be called from an interrupt which may preempt planner_service_step().
+ */
+
+#ifndef _PLANNER_SERVICE_H_
+#define _PLANNER_SERVICE_H_
+
+#include <stdint.h>
+#ifndef CONFIG_MODULE_PLANNER_SERVICE_NO_THREAD
+#include <pthread.h>
+#endif
+#include <obstacle_avoidance.h>
+
+/** Status of a result whose request was not processed yet. */
+#define PLANNER_SERVICE_PENDING -128
+
+/** A path computed by the planner. */
+struct planner_result {
+    uint32_t id;          /**< Identifier of the request, 0 if none. */
+    int32_t start_x, start_y; /**< Start point of the request, in mm. */
+    int32_t goal_x, goal_y;   /**< Goal of the request, in mm. */
+    int8_t len;           /**< Result of oa_process(): number of points or error code < 0. */
+    point_t path[MAX_CHKPOINTS]; /**< Checkpoints, the last one is the goal. */
+};
+
+/** Instance of the planner service. */
+struct planner_service {
+#ifndef CONFIG_MODULE_PLANNER_SERVICE_NO_THREAD
+    pthread_mutex_t map_lock; /**< Held while the map is used or modified. */
+
+    pthread_mutex_t request_lock; /**< Protects the request fields. */
+    pthread_cond_t request_cond;  /**< Signaled when a request is posted. */
+#endif
+    uint32_t request_id;      /**< Identifier of the newest request. */
+    uint32_t processed_id;    /**< Identifier of the last request taken by the planner. */
+    int32_t start_x, start_y; /**< Start point of the newest request. */
+    int32_t goal_x, goal_y;   /**< Goal of the newest request. */
+    uint32_t dropped;         /**< Requests replaced before being processed. */
+#ifndef CONFIG_MODULE_PLANNER_SERVICE_NO_THREAD
+    uint8_t running;          /**< 1 while the thread must run. */
+    pthread_t thread;         /**< The planner thread. */
+#endif
+
+    /** Triple buffer. The planner fills buffers[back], the reader uses
+     * buffers[front], and middle holds the newest published result. */
+    struct planner_result buffers[3];
+    uint8_t back;    /**< Buffer written by the planner. */
+    uint8_t front;   /**< Buffer read by the reader. */
+    uint8_t middle;  /**< Spare buffer, bit 7 set while it holds an unread result. */
+    uint32_t published_id; /**< Identifier of the last published result. */
+};
+
+/** Initializes the planner service, without starting its thread.
+ * @param [in] ps The planner_service instance.
+ */
+void planner_service_init(struct planner_service *ps);
+
+#ifndef CONFIG_MODULE_PLANNER_SERVICE_NO_THREAD
+/** Starts the planner thread.
+ * @return 0 on success, an error number of pthread_create() otherwise.
+ */
+int planner_service_start(struct planner_service *ps);
+
+/** Stops the planner thread and waits for its current search to end. */
+void planner_service_stop(struct planner_service *ps);
+#endif
+
+/** Posts a request, replacing the previous one if it was not processed.
+ *
+ * @param [in] ps The planner_service instance.
+ * @param [in] start_x, start_y Start point, in mm.
+ * @param [in] goal_x, goal_y Destination, in mm.
+ * @return The identifier of the request, as found in the result.
+ */
+uint32_t planner_service_request(struct planner_service *ps,
+                                 int32_t start_x, int32_t start_y,
+                                 int32_t goal_x, int32_t goal_y);
+
+/** Processes the pending request, if any, in the calling context.
+ *
+ * This is what the planner thread does in a loop. It is also the entry
+ * point on targets without threads.
+ * @return 1 if a request was processed, 0 otherwise.
+ */
+uint8_t planner_service_step(struct planner_service *ps);
+
+/** Returns the newest published result, without blocking.
+ *
+ * The returned buffer is valid until the next call. Its id is 0 while
+ * nothing was published.
+ */
+const struct planner_result *planner_service_get_result(struct planner_service *ps);
+
+/** Returns 1 if a request was posted after the last published result. */
+uint8_t planner_service_is_busy(struct planner_service *ps);
+
+/** Takes the map lock, see the module documentation. Does nothing with
+ * CONFIG_MODULE_PLANNER_SERVICE_NO_THREAD. */
+void planner_service_lock_map(struct planner_service *ps);
+
+/** Releases the map lock. */
+void planner_service_unlock_map(struct planner_service *ps);
+
+#endif
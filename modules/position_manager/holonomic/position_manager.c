@@ -100,6 +100,13 @@ void holonomic_position_set_physical_params(
     pos->geometry.encoder_resolution = encoder_resolution;
     pos->geometry.inv_encoder_resolution = 2.0 * M_PI / (double)encoder_resolution;
 
+    /* Rounded up, so a position on a sector boundary is in the next sector
+     * (exact for resolutions below 65536). */
+    pos->geometry.sector_recip = 0;
+    if (encoder_resolution > 6)
+        pos->geometry.sector_recip = (uint32_t)((((uint64_t)6 << 32) + encoder_resolution - 1) /
+                                                encoder_resolution);
+
 }
 
 void holonomic_position_set_mot_encoder(struct holonomic_robot_position *pos,
@@ -116,6 +123,14 @@ void holonomic_position_set_mot_encoder(struct holonomic_robot_position *pos,
     }
 }
 
+void holonomic_position_set_contact_blend(struct holonomic_robot_position *pos, float blend){
+    if (blend < 0.)
+        blend = 0.;
+    if (blend > 1.)
+        blend = 1.;
+    pos->geometry.contact_blend = (uint32_t)(blend * 65536.);
+}
+
 void holonomic_position_set_update_frequency(struct holonomic_robot_position *pos, float frequency){
     pos->update_frequency = frequency;
 }
@@ -149,6 +164,52 @@ int32_t holonomic_position_get_theta_v_int(void *data){
     return TO_DEG(holonomic_position_get_theta_v(pos));
 }
 
+/** @brief Returns the distance from the contact point of a wheel to the center.
+ *
+ * The rollers of a wheel alternate between an inner and an outer ring, in 6
+ * sectors per revolution. The sector is found with an integer modulo and the
+ * fixed point reciprocal of its size, and the distance is blended with the
+ * one of the next ring near the sector boundaries.
+ *
+ * @param [in] g The geometry of the base.
+ * @param [in] i The wheel.
+ * @param [in] wheel_state Encoder steps from the first boundary of the wheel.
+ */
+static double contact_distance(const struct holonomic_base_geometry *g, int i, int32_t wheel_state)
+{
+    int32_t wheel_pos;
+    uint64_t s;
+    uint32_t frac, edge;
+    double d, other, w;
+
+    if (g->sector_recip == 0)
+        return g->wheel_inner_distance[i];
+
+    /* modulo rounded down, the sectors continue below the index */
+    wheel_pos = wheel_state % g->encoder_resolution;
+    if (wheel_pos < 0)
+        wheel_pos += g->encoder_resolution;
+
+    s = (uint64_t)(uint32_t)wheel_pos * g->sector_recip;
+    if ((s >> 32) & 1) {
+        d = g->wheel_outer_distance[i];
+        other = g->wheel_inner_distance[i];
+    }else{
+        d = g->wheel_inner_distance[i];
+        other = g->wheel_outer_distance[i];
+    }
+
+    /* distance to the nearest boundary of the sector, Q16 */
+    frac = (uint32_t)s >> 16;
+    edge = frac < 0x8000 ? frac : 0x10000 - frac;
+    if (2 * edge >= g->contact_blend)
+        return d;
+
+    /* half of each distance on the boundary, this ring only at blend / 2 */
+    w = 0.5 + (double)edge / (double)g->contact_blend;
+    return w * d + (1. - w) * other;
+}
+
 /** 
  * Process the absolute position (x,y,a) depending on the delta on
  * virtual encoders since last read, and depending on physical
@@ -176,11 +237,7 @@ void holonomic_position_manage(struct holonomic_robot_position *pos)
 
         const double dist_steps = enc_steps * pos->geometry.wheel_radius[i];
 
-        if((int32_t)(wheel_state / (pos->geometry.encoder_resolution / 6.0)) % 2){
-            sum_wheel_distance += pos->geometry.wheel_outer_distance[i];
-        }else{
-            sum_wheel_distance += pos->geometry.wheel_inner_distance[i];
-        }
+        sum_wheel_distance += contact_distance(&pos->geometry, i, wheel_state);
 
         sum_wheel_steps_dist += dist_steps;
         sum_cos_steps_dist += pos->geometry.cos_beta[i] * dist_steps;
@@ -30,6 +30,17 @@ struct holonomic_base_geometry {
      * direction.) 
      */
     int32_t index_offset[3];
+
+    /** 6 / encoder_resolution, Q32. The product of a wheel position in
+     * [0, encoder_resolution[ by this value gives the roller sector (0 to 5)
+     * in its high word and the position in the sector in its low word. 0
+     * until the physical parameters are set.
+     */
+    uint32_t sector_recip;
+
+    /** Fraction of a sector, Q16, over which the contact distance goes from
+     * one roller ring to the other. 0 to switch at the sector boundary. */
+    uint32_t contact_blend;
 };
 
 
@@ -115,6 +126,18 @@ void holonomic_position_set_physical_params(
                   int32_t encoder_resolution,
                   int32_t index_offset[static 3]);
 
+/** @brief Sets how the contact distance changes between the roller rings.
+ *
+ * The contact point of an omni-wheel jumps from the inner to the outer ring
+ * at each sector boundary, but the rollers touch the floor together for a
+ * few steps around it. Blending the two distances over this zone removes the
+ * jump of the heading rate at each boundary.
+ * @param [in] pos The robot_position instance to configure.
+ * @param [in] blend Width of the transition, as a fraction of a sector, in
+ * [0, 1]. 0 (the default) switches at the boundary.
+ */
+void holonomic_position_set_contact_blend(struct holonomic_robot_position *pos, float blend);
+
 /** @brief Sets the frequency at which the function position_manage is called
  * @param [in] pos The robot_position instance to configure.
  * @param [in] frequency New frequency.
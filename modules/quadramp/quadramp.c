@@ -113,7 +113,7 @@ float quadramp_do_filter(void * data, float in)
 
 		/* var_2nd_ord_pos > 0 */
 		ramp_neg = -__ieee754_sqrtf( (var_2nd_ord_pos*var_2nd_ord_pos)/4 -
-				  2*d_float*var_2nd_ord_pos ) -
+				  2*d_float*var_2nd_ord_pos ) +
 			var_2nd_ord_pos/2;
 
 		/* ramp_neg < 0 */
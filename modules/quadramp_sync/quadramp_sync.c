@@ -0,0 +1,71 @@
+#include <math.h>
+#include <quadramp_sync.h>
+
+float quadramp_sync_plan(const float *d, const float *speed, const float *acc,
+                         float *speed_out, float *acc_out, uint8_t n) {
+    float c = 0., m = 0., ta;
+    float dist;
+    uint8_t i;
+
+    /* Smallest cruise time and smallest c * ta allowed by each axis. */
+    for (i = 0; i < n; i++) {
+        dist = fabsf(d[i]);
+        if (dist == 0.)
+            continue;
+
+        if (dist / speed[i] > c)
+            c = dist / speed[i];
+
+        if (acc[i] > 0. && dist / acc[i] > m)
+            m = dist / acc[i];
+    }
+
+    /* Triangular profile: the cruise speed is never reached. */
+    if (c * c < m)
+        c = sqrtf(m);
+
+    ta = (c > 0.) ? m / c : 0.;
+
+    for (i = 0; i < n; i++) {
+        dist = fabsf(d[i]);
+        if (dist == 0. || c == 0.) {
+            speed_out[i] = speed[i];
+            acc_out[i] = acc[i];
+            continue;
+        }
+
+        speed_out[i] = dist / c;
+
+        /* No acceleration limit on any axis. */
+        if (ta == 0.)
+            acc_out[i] = 0.;
+        else
+            acc_out[i] = speed_out[i] / ta;
+    }
+
+    return c + ta;
+}
+
+float quadramp_sync_goto(struct quadramp_filter **q, const float *target,
+                         const float *speed, const float *acc, uint8_t n) {
+    float d[QUADRAMP_SYNC_MAX_AXES];
+    float speed_out[QUADRAMP_SYNC_MAX_AXES];
+    float acc_out[QUADRAMP_SYNC_MAX_AXES];
+    float t;
+    uint8_t i;
+
+    if (n > QUADRAMP_SYNC_MAX_AXES)
+        n = QUADRAMP_SYNC_MAX_AXES;
+
+    for (i = 0; i < n; i++)
+        d[i] = target[i] - q[i]->previous_out;
+
+    t = quadramp_sync_plan(d, speed, acc, speed_out, acc_out, n);
+
+    for (i = 0; i < n; i++) {
+        quadramp_set_1st_order_vars(q[i], speed_out[i], speed_out[i]);
+        quadramp_set_2nd_order_vars(q[i], acc_out[i], acc_out[i]);
+    }
+
+    return t;
+}
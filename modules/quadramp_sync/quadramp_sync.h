@@ -0,0 +1,90 @@
+/** @file modules/quadramp_sync/quadramp_sync.h
+ * @author CVRA
+ * @brief Time synchronized speed ramps for several axes.
+ *
+ * When several quadramp filters are given a new consign at the same time,
+ * each of them uses its own speed and acceleration limits, so the shortest
+ * axis arrives first. For a 2 wheeled robot moving in distance and angle
+ * at the same time, it means the robot turns on the spot at the end (or
+ * the beginning) of the move instead of following an arc.
+ *
+ * This module computes, for N axes, speed and acceleration limits so that
+ * all the ramps start and end together, in the shortest time allowed by
+ * the limits of every axis. Every axis follows the same normalized
+ * trapezoidal profile, scaled by its distance:
+ *  - c is the time to travel the distance at cruise speed (d / v),
+ *  - ta is the acceleration time (v / a),
+ *  - the move lasts c + ta.
+ *
+ * The limits of the axes give c >= max(d / v_max) and
+ * c * ta >= max(d / a_max). The minimal time is reached with the smallest
+ * c, unless there is no time to reach the cruise speed (triangular
+ * profile), in which case c = ta = sqrt(max(d / a_max)).
+ *
+ * Since quadramp is linear in the distance, speed and acceleration, the
+ * scaled ramps stay synchronized, provided all axes are stopped when the
+ * move starts.
+ *
+ * Usage with generic axes (the consigns are set as usual):
+ * @code
+ * struct quadramp_filter *q[2] = {&q_lift, &q_arm};
+ * float targets[2] = {1200., 300.};
+ * float speeds[2] = {10., 5.};
+ * float accs[2] = {0.5, 0.2};
+ *
+ * quadramp_sync_goto(q, targets, speeds, accs, 2);
+ * cs_set_consign(&cs_lift, targets[0]);
+ * cs_set_consign(&cs_arm, targets[1]);
+ * @endcode
+ *
+ * @sa quadramp.h, trajectory_d_a_rel_sync()
+ */
+
+#ifndef _QUADRAMP_SYNC_H_
+#define _QUADRAMP_SYNC_H_
+
+#include <aversive.h>
+#include <quadramp.h>
+
+/** Maximal number of synchronized axes. */
+#define QUADRAMP_SYNC_MAX_AXES 8
+
+/** @brief Computes synchronized speeds and accelerations.
+ *
+ * The units are the ones of the quadramp filter (units / period and
+ * units / period^2). As in quadramp, an acceleration of 0 means no
+ * acceleration limit. The speed limits must be positive.
+ *
+ * Axes which do not move (d == 0) keep their speed and acceleration.
+ *
+ * @param [in] d The distance to travel on each axis (the sign is ignored).
+ * @param [in] speed The maximal speed of each axis.
+ * @param [in] acc The maximal acceleration of each axis.
+ * @param [out] speed_out The speed to use on each axis.
+ * @param [out] acc_out The acceleration to use on each axis.
+ * @param [in] n The number of axes.
+ *
+ * @returns The duration of the move, in periods.
+ */
+float quadramp_sync_plan(const float *d, const float *speed, const float *acc,
+                         float *speed_out, float *acc_out, uint8_t n);
+
+/** @brief Sets synchronized ramps to reach new positions.
+ *
+ * Computes the distance from the current output of each filter to its
+ * target and sets the speed and acceleration limits of the filters so
+ * that all of them reach their target together. The consigns must then
+ * be given to the filters as usual (with cs_set_consign()).
+ *
+ * @param [in] q The quadramp filters.
+ * @param [in] target The target position of each axis.
+ * @param [in] speed The maximal speed of each axis.
+ * @param [in] acc The maximal acceleration of each axis.
+ * @param [in] n The number of axes (at most QUADRAMP_SYNC_MAX_AXES).
+ *
+ * @returns The duration of the move, in periods.
+ */
+float quadramp_sync_goto(struct quadramp_filter **q, const float *target,
+                         const float *speed, const float *acc, uint8_t n);
+
+#endif
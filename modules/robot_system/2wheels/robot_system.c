@@ -85,6 +85,11 @@ void rs_set_ratio(struct robot_system * rs, float ratio)
 {
     rs->ratio_mot_ext = ratio;
 }
+
+void rs_set_traction_control(struct robot_system * rs, struct traction_control *tc)
+{
+    rs->traction = tc;
+}
 #endif
 
 void rs_set_left_pwm(struct robot_system * rs, void (*left_pwm)(void *, int32_t), void *left_pwm_param)
@@ -302,6 +307,18 @@ void rs_update(void * data)
     delta_distance = pext.distance - rs->pext_prev.distance;
 #endif
 
+#ifdef CONFIG_MODULE_ROBOT_SYSTEM_MOT_AND_EXT
+    /* compare motor and external wheels displacements to detect slip */
+    if (rs->traction) {
+        struct rs_wheels dmot, dext;
+        dmot.left = wmot.left - rs->wmot_prev.left;
+        dmot.right = wmot.right - rs->wmot_prev.right;
+        dext.left = wext.left - rs->wext_prev.left;
+        dext.right = wext.right - rs->wext_prev.right;
+        traction_control_update(rs->traction, &dmot, &dext);
+    }
+#endif
+
     rs->virtual_encoders.angle += delta_angle;
     rs->virtual_encoders.distance += delta_distance;
     rs->pext_prev = pext;
@@ -75,6 +75,7 @@
 
 //#include <platform.h>
 #include "2wheels/angle_distance.h"
+#include "2wheels/traction_control.h"
 
 #ifndef _ROBOT_SYSTEM_H_
 #define _ROBOT_SYSTEM_H_
@@ -127,6 +128,9 @@ struct robot_system
 
     /** Gain on the right motor encoder to compensate for wheel difference. */
     float right_mot_gain;
+
+    /** Slip detection updated with the motor and external encoders, or NULL. */
+    struct traction_control *traction;
 #endif
 
     /* External encoders */
@@ -195,6 +199,20 @@ void rs_init( struct robot_system *rs );
 void rs_set_ratio(struct robot_system * rs, float ratio);
 #endif
 
+#ifdef CONFIG_MODULE_ROBOT_SYSTEM_MOT_AND_EXT
+/** @brief Sets the slip detection.
+ *
+ * At each update, the displacement of each wheel measured by the motor
+ * encoders is compared to the one measured by the external encoders
+ * and given to the slip detection.
+ *
+ * @param [in] rs The robot_system instance.
+ * @param [in] tc The traction_control instance, NULL to disable it.
+ * @sa traction_control.h
+ */
+void rs_set_traction_control(struct robot_system * rs, struct traction_control *tc);
+#endif
+
 /** @brief Define left pwn.
  *
  * This function tells robot_system which callback to use.
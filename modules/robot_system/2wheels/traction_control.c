@@ -0,0 +1,109 @@
+#include <math.h>
+#include <string.h>
+#include "traction_control.h"
+
+void traction_control_init(struct traction_control *tc)
+{
+    memset(tc, 0, sizeof(struct traction_control));
+    traction_control_set_thresholds(tc, 10., 0.2, 3);
+}
+
+void traction_control_set_thresholds(struct traction_control *tc, float threshold,
+                                     float ratio, uint16_t cpt_thres)
+{
+    tc->threshold = threshold;
+    tc->ratio = ratio;
+    tc->cpt_thres = cpt_thres;
+}
+
+/** Updates the counter of a wheel and returns 1 if it slips. */
+static uint8_t wheel_slips(struct traction_control *tc, uint16_t *cpt,
+                           float *div, int32_t dmot, int32_t dext)
+{
+    *div = (float)(dmot - dext);
+
+    if (fabsf(*div) > tc->threshold + tc->ratio * fabsf((float)dext)) {
+        if (*cpt < tc->cpt_thres)
+            (*cpt)++;
+    }
+    else {
+        *cpt = 0;
+    }
+
+    return *cpt >= tc->cpt_thres;
+}
+
+void traction_control_update(struct traction_control *tc,
+                             const struct rs_wheels *dmot, const struct rs_wheels *dext)
+{
+    uint8_t slip = 0;
+
+    if (wheel_slips(tc, &tc->cpt_left, &tc->div_left, dmot->left, dext->left))
+        slip |= TRACTION_CONTROL_SLIP_LEFT;
+
+    if (wheel_slips(tc, &tc->cpt_right, &tc->div_right, dmot->right, dext->right))
+        slip |= TRACTION_CONTROL_SLIP_RIGHT;
+
+    if (slip && !tc->slip)
+        tc->slip_events++;
+
+    tc->slip = slip;
+}
+
+uint8_t traction_control_get_slip(struct traction_control *tc)
+{
+    return tc->slip;
+}
+
+void traction_control_reset(struct traction_control *tc)
+{
+    tc->cpt_left = 0;
+    tc->cpt_right = 0;
+    tc->slip = 0;
+}
+
+void traction_control_filter_init(struct traction_control_filter *f,
+                                  struct traction_control *tc)
+{
+    memset(f, 0, sizeof(struct traction_control_filter));
+    f->tc = tc;
+    f->limit = -1.;
+    traction_control_filter_set_limits(f, 0.5, 0.01);
+}
+
+void traction_control_filter_set_limits(struct traction_control_filter *f,
+                                        float backoff, float recovery)
+{
+    f->backoff = backoff;
+    f->recovery = recovery;
+}
+
+float traction_control_do_filter(void *data, float in)
+{
+    struct traction_control_filter *f = data;
+    float out = in;
+
+    if (f->tc->slip) {
+        /* A slip starts: back off from the output which caused it. */
+        if (f->limit < 0.) {
+            f->slip_out = fabsf(f->prev_out);
+            f->limit = f->slip_out * f->backoff;
+        }
+    }
+    else if (f->limit >= 0.) {
+        /* The wheels grip again: raise the cap until it is not reached. */
+        f->limit += f->slip_out * f->recovery;
+        if (f->limit >= fabsf(in) || f->slip_out == 0.)
+            f->limit = -1.;
+    }
+
+    if (f->limit >= 0.) {
+        if (out > f->limit)
+            out = f->limit;
+        else if (out < -f->limit)
+            out = -f->limit;
+    }
+
+    f->prev_out = out;
+    return out;
+}
@@ -0,0 +1,141 @@
+/** @file modules/robot_system/2wheels/traction_control.h
+ * @author CVRA
+ * @brief Wheel slip detection and traction control.
+ *
+ * When the robot has both motor encoders and external (free wheel)
+ * encoders, a wheel which slips turns faster than the robot moves: its
+ * motor encoder diverges from the matching external encoder. This module
+ * compares the two every time robot_system is updated and flags the
+ * slipping wheels.
+ *
+ * The slip flag is used by an output filter, to put between the
+ * corrector and the robot_system in the angle and distance control
+ * systems. When a wheel starts slipping, the output is capped to a
+ * fraction of its value, then the cap is slowly raised again once the
+ * wheel grips. Aggressive acceleration settings can then be used, the
+ * motors only backing off when the wheels actually slip.
+ *
+ * Usage:
+ * @code
+ * traction_control_init(&tc);
+ * traction_control_set_thresholds(&tc, 10, 0.2, 3);
+ * rs_set_traction_control(&robot.rs, &tc);
+ *
+ * traction_control_filter_init(&tc_distance, &tc);
+ * traction_control_filter_set_limits(&tc_distance, 0.5, 0.01);
+ * cs_set_output_filter(&distance_cs, traction_control_do_filter, &tc_distance);
+ * @endcode
+ *
+ * @note Both deltas are compared after the encoders gains and the
+ * ratio_mot_ext correction are applied, so they must be calibrated first.
+ */
+
+#ifndef _TRACTION_CONTROL_H_
+#define _TRACTION_CONTROL_H_
+
+#include <stdint.h>
+#include "angle_distance.h"
+
+#define TRACTION_CONTROL_SLIP_LEFT 1  /**< The left wheel slips. */
+#define TRACTION_CONTROL_SLIP_RIGHT 2 /**< The right wheel slips. */
+
+/** Slip detection on the two wheels. */
+struct traction_control {
+    float threshold;    /**< Divergence always accepted, in ticks / period. */
+    float ratio;        /**< Divergence accepted relative to the wheel speed. */
+    uint16_t cpt_thres; /**< Number of periods over the threshold to detect a slip. */
+
+    uint16_t cpt_left;  /**< Consecutive periods the left wheel diverged. */
+    uint16_t cpt_right; /**< Consecutive periods the right wheel diverged. */
+    float div_left;     /**< Last divergence of the left wheel, mot - ext. */
+    float div_right;    /**< Last divergence of the right wheel, mot - ext. */
+
+    uint8_t slip;       /**< Slipping wheels (TRACTION_CONTROL_SLIP_* flags). */
+    uint32_t slip_events; /**< Number of slips detected since the init. */
+};
+
+/** Output filter limiting a control system output while a wheel slips. */
+struct traction_control_filter {
+    struct traction_control *tc; /**< Slip detection used by the filter. */
+    float backoff;      /**< Fraction of the output kept when a slip starts. */
+    float recovery;     /**< Increase of the cap per period, relative to slip_out. */
+
+    float prev_out;     /**< Output at the previous period. */
+    float slip_out;     /**< Absolute output when the last slip started. */
+    float limit;        /**< Current cap of the output, negative when disabled. */
+};
+
+/** @brief Initializes the slip detection.
+ *
+ * The default thresholds detect a slip when a wheel diverges by more than
+ * 10 ticks + 20% of its speed during 3 periods.
+ * @param [in] tc The traction_control instance.
+ */
+void traction_control_init(struct traction_control *tc);
+
+/** @brief Sets the slip detection thresholds.
+ *
+ * A wheel is considered as slipping when, during cpt_thres consecutive
+ * periods, |mot - ext| > threshold + ratio * |ext|.
+ *
+ * @param [in] tc The traction_control instance.
+ * @param [in] threshold Divergence always accepted, in ticks / period.
+ * @param [in] ratio Divergence accepted relative to the wheel speed.
+ * @param [in] cpt_thres Number of periods to confirm the slip.
+ */
+void traction_control_set_thresholds(struct traction_control *tc, float threshold,
+                                     float ratio, uint16_t cpt_thres);
+
+/** @brief Updates the slip detection.
+ *
+ * This function is called by rs_update() with the displacement of each
+ * wheel measured by the two kinds of encoders since the last period.
+ *
+ * @param [in] tc The traction_control instance.
+ * @param [in] dmot Displacement of the wheels according to the motor encoders.
+ * @param [in] dext Displacement of the wheels according to the external encoders.
+ */
+void traction_control_update(struct traction_control *tc,
+                             const struct rs_wheels *dmot, const struct rs_wheels *dext);
+
+/** @brief Gets the slipping wheels.
+ * @returns A combination of TRACTION_CONTROL_SLIP_LEFT and
+ * TRACTION_CONTROL_SLIP_RIGHT, 0 if the wheels grip.
+ */
+uint8_t traction_control_get_slip(struct traction_control *tc);
+
+/** @brief Clears the slip state, for example after a manual reset of the robot. */
+void traction_control_reset(struct traction_control *tc);
+
+/** @brief Initializes an output filter.
+ *
+ * By default, the output is halved when a slip is detected and the cap
+ * is raised by 1% of the output at the slip each period.
+ *
+ * @param [in] f The filter instance.
+ * @param [in] tc The slip detection to use.
+ */
+void traction_control_filter_init(struct traction_control_filter *f,
+                                  struct traction_control *tc);
+
+/** @brief Sets the filter limits.
+ * @param [in] f The filter instance.
+ * @param [in] backoff Fraction of the output kept when a slip starts (0 to 1).
+ * @param [in] recovery Increase of the cap per period once the wheels grip,
+ * as a fraction of the output when the slip started.
+ */
+void traction_control_filter_set_limits(struct traction_control_filter *f,
+                                        float backoff, float recovery);
+
+/** @brief Filters the output of a control system.
+ *
+ * This function is compatible with cs_set_output_filter(). It passes the
+ * input unchanged while the wheels grip.
+ *
+ * @param [in] data A pointer to a traction_control_filter, casted to void *.
+ * @param [in] in The output of the corrector.
+ * @returns The output to send to the robot_system.
+ */
+float traction_control_do_filter(void *data, float in);
+
+#endif
@@ -0,0 +1,175 @@
+#include <stddef.h>
+#include <string.h>
+#include <tick_monitor.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+/** Low 32 bits of the cycle counter. */
+static uint32_t tick_monitor_rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    (void)hi;
+    return lo;
+}
+#define TICK_MONITOR_DEFAULT_CLOCK tick_monitor_rdtsc
+#else
+#define TICK_MONITOR_DEFAULT_CLOCK NULL
+#endif
+
+static void stats_reset(struct tick_monitor_stats *s) {
+    const char *name = s->name;
+
+    memset(s, 0, sizeof(struct tick_monitor_stats));
+    s->name = name;
+    s->min = UINT32_MAX;
+}
+
+static void stats_add(struct tick_monitor_stats *s, uint32_t d) {
+    uint8_t bucket;
+
+    s->count++;
+    s->sum += d;
+    if (d < s->min)
+        s->min = d;
+    if (d > s->max)
+        s->max = d;
+
+    /* Number of significant bits: 0 for 0, 1 for 1, 2 for 2-3... */
+    bucket = (d == 0) ? 0 : 32 - __builtin_clz(d);
+    s->hist[bucket]++;
+}
+
+static uint32_t tick_monitor_now(struct tick_monitor *tm) {
+    if (tm->clock == NULL)
+        return 0;
+    return tm->clock();
+}
+
+void tick_monitor_init(struct tick_monitor *tm, uint32_t deadline) {
+    memset(tm, 0, sizeof(struct tick_monitor));
+    tm->clock = TICK_MONITOR_DEFAULT_CLOCK;
+    tm->tick.name = "tick";
+    tm->interval.name = "interval";
+    tick_monitor_set_deadline(tm, deadline);
+    tick_monitor_reset(tm);
+}
+
+void tick_monitor_set_clock(struct tick_monitor *tm, uint32_t (*clock)(void)) {
+    tm->clock = clock;
+}
+
+void tick_monitor_set_deadline(struct tick_monitor *tm, uint32_t deadline) {
+    tm->deadline = deadline;
+}
+
+int8_t tick_monitor_add_stage(struct tick_monitor *tm, const char *name) {
+    struct tick_monitor_stats *s;
+
+    if (tm->stage_n >= TICK_MONITOR_MAX_STAGES)
+        return -1;
+
+    s = &tm->stages[tm->stage_n];
+    s->name = name;
+    stats_reset(s);
+
+    return tm->stage_n++;
+}
+
+void tick_monitor_tick_begin(struct tick_monitor *tm) {
+    uint32_t now = tick_monitor_now(tm);
+
+    /* The unsigned difference is right even when the counter wraps. */
+    if (tm->tick.count > 0)
+        stats_add(&tm->interval, now - tm->tick.start);
+
+    tm->tick.start = now;
+}
+
+void tick_monitor_tick_end(struct tick_monitor *tm) {
+    uint32_t d = tick_monitor_now(tm) - tm->tick.start;
+
+    stats_add(&tm->tick, d);
+    if (d > tm->deadline)
+        tm->misses++;
+}
+
+void tick_monitor_stage_begin(struct tick_monitor *tm, int8_t stage) {
+    if (stage < 0 || stage >= tm->stage_n)
+        return;
+    tm->stages[stage].start = tick_monitor_now(tm);
+}
+
+void tick_monitor_stage_end(struct tick_monitor *tm, int8_t stage) {
+    if (stage < 0 || stage >= tm->stage_n)
+        return;
+    stats_add(&tm->stages[stage], tick_monitor_now(tm) - tm->stages[stage].start);
+}
+
+void tick_monitor_call(struct tick_monitor *tm, int8_t stage,
+                       void (*f)(void *), void *param) {
+    tick_monitor_stage_begin(tm, stage);
+    f(param);
+    tick_monitor_stage_end(tm, stage);
+}
+
+const struct tick_monitor_stats *tick_monitor_get_stage(struct tick_monitor *tm, int8_t stage) {
+    if (stage < 0 || stage >= tm->stage_n)
+        return NULL;
+    return &tm->stages[stage];
+}
+
+const struct tick_monitor_stats *tick_monitor_get_tick(struct tick_monitor *tm) {
+    return &tm->tick;
+}
+
+const struct tick_monitor_stats *tick_monitor_get_interval(struct tick_monitor *tm) {
+    return &tm->interval;
+}
+
+uint32_t tick_monitor_get_misses(struct tick_monitor *tm) {
+    return tm->misses;
+}
+
+uint32_t tick_monitor_get_mean(const struct tick_monitor_stats *s) {
+    if (s->count == 0)
+        return 0;
+    return s->sum / s->count;
+}
+
+uint32_t tick_monitor_get_percentile(const struct tick_monitor_stats *s, uint16_t permille) {
+    uint64_t target, acc = 0;
+    uint8_t i;
+
+    if (s->count == 0)
+        return 0;
+
+    target = ((uint64_t)s->count * permille + 999) / 1000;
+
+    for (i = 0; i < TICK_MONITOR_BUCKETS; i++) {
+        acc += s->hist[i];
+        if (acc >= target)
+            break;
+    }
+
+    if (i == 0)
+        return 0;
+
+    /* Upper bound of the bucket, but not above the real maximum. */
+    if (i >= 32 || (((uint32_t)1 << i) - 1) > s->max)
+        return s->max;
+    return ((uint32_t)1 << i) - 1;
+}
+
+void tick_monitor_reset(struct tick_monitor *tm) {
+    uint32_t start = tm->tick.start;
+    uint8_t i;
+
+    stats_reset(&tm->tick);
+    stats_reset(&tm->interval);
+    for (i = 0; i < tm->stage_n; i++)
+        stats_reset(&tm->stages[i]);
+    tm->misses = 0;
+
+    /* Keep the start of the current period, so a reset from inside a
+     * period still measures it. */
+    tm->tick.start = start;
+}
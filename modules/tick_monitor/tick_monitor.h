@@ -0,0 +1,142 @@
+/** @file modules/tick_monitor/tick_monitor.h
+ * @author CVRA
+ * @brief Execution time and deadline monitoring of the control loop.
+ *
+ * This module measures how long each control period takes, and how long
+ * each of its stages (rs_update(), position_manage(), cs_manage() of each
+ * axis, trajectory_manager_event()...) takes. For the whole period and for
+ * each stage it keeps the minimum, the maximum, the mean and a histogram
+ * of the durations with one bucket per power of two. It also measures the
+ * interval between the starts of two periods (the jitter of the timer)
+ * and counts the periods which lasted longer than the deadline.
+ *
+ * The time is read from a callback returning a free running 32 bits
+ * counter: a hardware timer on the robot, or the cycle counter (rdtsc)
+ * which is used by default on x86. All durations are in counter ticks.
+ *
+ * @code
+ * tick_monitor_init(&tm, 1000);  // deadline in counter ticks
+ * tick_monitor_set_clock(&tm, timer_get);
+ * rs_stage = tick_monitor_add_stage(&tm, "rs_update");
+ * d_stage = tick_monitor_add_stage(&tm, "cs distance");
+ *
+ * // in the control interrupt
+ * tick_monitor_tick_begin(&tm);
+ * tick_monitor_call(&tm, rs_stage, rs_update, &rs);
+ * tick_monitor_stage_begin(&tm, d_stage);
+ * cs_manage(&distance_cs);
+ * tick_monitor_stage_end(&tm, d_stage);
+ * tick_monitor_tick_end(&tm);
+ * @endcode
+ *
+ * @note The statistics are updated from the control loop, reading them from
+ * another context can give values from two different periods.
+ */
+
+#ifndef _TICK_MONITOR_H_
+#define _TICK_MONITOR_H_
+
+#include <stdint.h>
+
+/** Maximal number of stages, besides the whole period. */
+#define TICK_MONITOR_MAX_STAGES 8
+
+/** Number of buckets of the histograms. Bucket i counts the durations
+ * in [2^(i-1), 2^i[ (bucket 0 counts the null durations). */
+#define TICK_MONITOR_BUCKETS 33
+
+/** Statistics of a measured duration. */
+struct tick_monitor_stats {
+    const char *name;   /**< Name of the stage. */
+    uint32_t start;     /**< Counter value at the start of the current measure. */
+    uint32_t count;     /**< Number of measures. */
+    uint32_t min;       /**< Shortest duration. */
+    uint32_t max;       /**< Longest duration. */
+    uint64_t sum;       /**< Sum of the durations, for the mean. */
+    uint32_t hist[TICK_MONITOR_BUCKETS]; /**< Log scale histogram. */
+};
+
+/** A tick monitor instance. */
+struct tick_monitor {
+    uint32_t (*clock)(void); /**< Callback reading the counter. */
+    uint32_t deadline;  /**< Maximal duration of a period, in counter ticks. */
+    uint32_t misses;    /**< Number of periods longer than the deadline. */
+
+    struct tick_monitor_stats tick;     /**< Duration of the periods. */
+    struct tick_monitor_stats interval; /**< Interval between the starts of two periods. */
+    struct tick_monitor_stats stages[TICK_MONITOR_MAX_STAGES]; /**< Durations of the stages. */
+    uint8_t stage_n;    /**< Number of registered stages. */
+};
+
+/** @brief Initializes the monitor.
+ *
+ * On x86 the clock is the cycle counter, elsewhere it must be set with
+ * tick_monitor_set_clock().
+ * @param [in] tm The tick_monitor instance.
+ * @param [in] deadline Maximal duration of a period, in counter ticks.
+ */
+void tick_monitor_init(struct tick_monitor *tm, uint32_t deadline);
+
+/** @brief Sets the callback reading the counter.
+ * @param [in] tm The tick_monitor instance.
+ * @param [in] clock Function returning a free running counter.
+ */
+void tick_monitor_set_clock(struct tick_monitor *tm, uint32_t (*clock)(void));
+
+/** @brief Sets the deadline, in counter ticks. */
+void tick_monitor_set_deadline(struct tick_monitor *tm, uint32_t deadline);
+
+/** @brief Registers a stage.
+ * @param [in] tm The tick_monitor instance.
+ * @param [in] name Name of the stage, the string is not copied.
+ * @returns The identifier of the stage, or -1 if there are too many stages.
+ */
+int8_t tick_monitor_add_stage(struct tick_monitor *tm, const char *name);
+
+/** @brief Marks the start of a period. */
+void tick_monitor_tick_begin(struct tick_monitor *tm);
+
+/** @brief Marks the end of a period, and counts a miss if it lasted
+ * longer than the deadline. */
+void tick_monitor_tick_end(struct tick_monitor *tm);
+
+/** @brief Marks the start of a stage. */
+void tick_monitor_stage_begin(struct tick_monitor *tm, int8_t stage);
+
+/** @brief Marks the end of a stage. */
+void tick_monitor_stage_end(struct tick_monitor *tm, int8_t stage);
+
+/** @brief Calls a function and measures its duration as a stage.
+ *
+ * Most periodic functions (rs_update(), cs_manage(),
+ * trajectory_manager_event()) have this prototype.
+ */
+void tick_monitor_call(struct tick_monitor *tm, int8_t stage,
+                       void (*f)(void *), void *param);
+
+/** @brief Returns the statistics of a stage, NULL if it does not exist. */
+const struct tick_monitor_stats *tick_monitor_get_stage(struct tick_monitor *tm, int8_t stage);
+
+/** @brief Returns the statistics of the whole periods. */
+const struct tick_monitor_stats *tick_monitor_get_tick(struct tick_monitor *tm);
+
+/** @brief Returns the statistics of the intervals between two periods. */
+const struct tick_monitor_stats *tick_monitor_get_interval(struct tick_monitor *tm);
+
+/** @brief Returns the number of periods longer than the deadline. */
+uint32_t tick_monitor_get_misses(struct tick_monitor *tm);
+
+/** @brief Returns the mean of a duration, 0 if it was never measured. */
+uint32_t tick_monitor_get_mean(const struct tick_monitor_stats *s);
+
+/** @brief Returns the duration under which a fraction of the measures
+ * are, rounded up to a power of two.
+ * @param [in] s The statistics.
+ * @param [in] permille The fraction, in 1/1000 (990 for the 99th percentile).
+ */
+uint32_t tick_monitor_get_percentile(const struct tick_monitor_stats *s, uint16_t permille);
+
+/** @brief Clears all the statistics, keeping the stages and the settings. */
+void tick_monitor_reset(struct tick_monitor *tm);
+
+#endif
@@ -0,0 +1,152 @@
+#ifdef CONFIG_MODULE_TRACE
+
+#include <stddef.h>
+#include <trace.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+
+static uint32_t trace_default_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+#define TRACE_DEFAULT_CLOCK trace_default_clock
+#else
+#define TRACE_DEFAULT_CLOCK NULL
+#endif
+
+static uint32_t (*trace_clock)(void) = TRACE_DEFAULT_CLOCK;
+static float trace_ticks_per_us = 1.;
+
+/** Registered buffers, new ones are pushed at the head. */
+static struct trace_buffer *trace_buffers = NULL;
+static uint16_t trace_next_tid = 1;
+
+static TRACE_THREAD_LOCAL struct trace_buffer *trace_current = NULL;
+
+void trace_set_clock(uint32_t (*clock)(void), float ticks_per_us) {
+    trace_clock = clock;
+    trace_ticks_per_us = ticks_per_us;
+}
+
+void trace_thread_register(struct trace_buffer *buf, const char *name) {
+    struct trace_buffer *b;
+    uint32_t i;
+
+    /* Already in the list: pushing it again would link it to itself. The
+     * list only grows, so it can be walked without a lock. */
+    for (b = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE); b != NULL; b = b->next) {
+        if (b == buf) {
+            buf->name = name;
+            trace_current = buf;
+            return;
+        }
+    }
+
+    for (i = 0; i < TRACE_BUFFER_SIZE; i++)
+        buf->events[i].committed = 0;
+    buf->head = 0;
+    buf->tail = 0;
+    buf->dropped = 0;
+    buf->name = name;
+    buf->last_timestamp = 0;
+    buf->wraps = 0;
+    buf->tid = __atomic_fetch_add(&trace_next_tid, 1, __ATOMIC_RELAXED);
+
+    /* Lock free push on the list of buffers. */
+    buf->next = __atomic_load_n(&trace_buffers, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&trace_buffers, &buf->next, buf, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+
+    trace_current = buf;
+}
+
+void trace_event(uint8_t type, const char *name, float value) {
+    struct trace_buffer *buf = trace_current;
+    struct trace_event *e;
+    uint32_t head, tail;
+
+    if (buf == NULL || trace_clock == NULL)
+        return;
+
+#ifdef CONFIG_MODULE_TRACE_NO_TLS
+    /* The buffer is shared with the interrupts: reserve the slot first,
+     * an interrupt between the reservation and the commit writes in the
+     * next one. */
+    head = __atomic_load_n(&buf->head, __ATOMIC_RELAXED);
+    do {
+        tail = __atomic_load_n(&buf->tail, __ATOMIC_ACQUIRE);
+        if (head - tail >= TRACE_BUFFER_SIZE) {
+            __atomic_fetch_add(&buf->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&buf->head, &head, head + 1, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#else
+    head = buf->head;
+    tail = __atomic_load_n(&buf->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= TRACE_BUFFER_SIZE) {
+        buf->dropped++;
+        return;
+    }
+    __atomic_store_n(&buf->head, head + 1, __ATOMIC_RELAXED);
+#endif
+
+    e = &buf->events[head & (TRACE_BUFFER_SIZE - 1)];
+    e->name = name;
+    e->timestamp = trace_clock();
+    e->value = value;
+    e->type = type;
+
+    /* Publish the event once it is written. */
+    __atomic_store_n(&e->committed, 1, __ATOMIC_RELEASE);
+}
+
+void trace_dump(FILE *f) {
+    struct trace_buffer *buf;
+    struct trace_event *e;
+    uint32_t head, tail, back;
+    uint64_t ts;
+
+    for (buf = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE); buf != NULL; buf = buf->next) {
+        fprintf(f, "T %u %s\n", buf->tid, buf->name);
+
+        head = __atomic_load_n(&buf->head, __ATOMIC_RELAXED);
+        for (tail = buf->tail; tail != head; tail++) {
+            e = &buf->events[tail & (TRACE_BUFFER_SIZE - 1)];
+
+            /* Reserved, but still being written. */
+            if (!__atomic_load_n(&e->committed, __ATOMIC_ACQUIRE))
+                break;
+
+            /* Extend the timestamps to 64 bits. Without thread local
+             * storage, an event reserved just before an interrupt is
+             * stamped after the events of the interrupt: a small step
+             * back is not a wrap. */
+            back = buf->last_timestamp - e->timestamp;
+            if (back != 0 && back <= UINT32_MAX / 2 &&
+                back <= buf->wraps + buf->last_timestamp) {
+                ts = buf->wraps + buf->last_timestamp - back;
+            } else {
+                if (e->timestamp < buf->last_timestamp)
+                    buf->wraps += (uint64_t)1 << 32;
+                buf->last_timestamp = e->timestamp;
+                ts = buf->wraps + e->timestamp;
+            }
+
+            fprintf(f, "E %u %c %.3f %g %s\n", buf->tid, e->type,
+                    ts / trace_ticks_per_us, e->value, e->name);
+            e->committed = 0;
+        }
+
+        /* Free the slots for the writer. */
+        __atomic_store_n(&buf->tail, tail, __ATOMIC_RELEASE);
+
+        if (buf->dropped)
+            fprintf(f, "D %u %u\n", buf->tid, buf->dropped);
+    }
+}
+
+#endif
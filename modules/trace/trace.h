@@ -0,0 +1,132 @@
+/** @file modules/trace/trace.h
+ * @author CVRA
+ * @brief Timeline tracing of the robot code.
+ *
+ * This module records timestamped events: the beginning and the end of a
+ * function, instant events and counter values. Each thread writes in its
+ * own circular buffer without any lock (there is a single writer, and a
+ * single reader which dumps the buffers), so the trace points can be used
+ * in interrupts and in the control loop. Without thread local storage, the
+ * writers share a buffer and reserve its slots atomically. trace_dump() writes the events
+ * as text, and tools/trace2json converts this text to the Chrome trace
+ * format, which can be opened in chrome://tracing or ui.perfetto.dev.
+ *
+ * The trace points are macros which compile to nothing unless
+ * CONFIG_MODULE_TRACE is defined, so they can stay in the hot functions:
+ * @code
+ * void oa_process(void)
+ * {
+ *     TRACE_BEGIN("oa_process");
+ *     ...
+ *     TRACE_COUNTER("oa rays", ray_n);
+ *     ...
+ *     TRACE_END("oa_process");
+ * }
+ * @endcode
+ *
+ * Each thread (or interrupt context) registers its buffer before tracing:
+ * @code
+ * static struct trace_buffer control_trace;
+ * trace_thread_register(&control_trace, "control");
+ * @endcode
+ * The events of a thread without buffer are ignored.
+ *
+ * @note The names must be string literals (or strings which stay valid
+ * until the dump), only the pointers are stored.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#ifdef CONFIG_MODULE_TRACE
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** Number of events in each buffer, must be a power of two. */
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 1024
+#endif
+
+/** Storage class of the pointer to the buffer of the current thread.
+ * Define CONFIG_MODULE_TRACE_NO_TLS on targets without thread local
+ * storage: a single buffer is then shared by everything, the tasks and
+ * the interrupts reserve their slots with an atomic compare and swap on
+ * its head. */
+#ifdef CONFIG_MODULE_TRACE_NO_TLS
+#define TRACE_THREAD_LOCAL
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+#define TRACE_TYPE_BEGIN 'B'   /**< Start of a duration. */
+#define TRACE_TYPE_END 'E'     /**< End of a duration. */
+#define TRACE_TYPE_INSTANT 'I' /**< Instant event. */
+#define TRACE_TYPE_COUNTER 'C' /**< Value of a counter. */
+
+/** A recorded event. */
+struct trace_event {
+    const char *name;   /**< Name of the event. */
+    uint32_t timestamp; /**< Value of the clock. */
+    float value;        /**< Value of a counter. */
+    uint8_t type;       /**< One of the TRACE_TYPE_* values. */
+    uint8_t committed;  /**< 1 once written, cleared by trace_dump(). */
+};
+
+/** Events of a thread. */
+struct trace_buffer {
+    struct trace_event events[TRACE_BUFFER_SIZE]; /**< Circular buffer. */
+    uint32_t head;      /**< Next event reserved by a writer. */
+    uint32_t tail;      /**< Next event read, only modified by trace_dump(). */
+    uint32_t dropped;   /**< Events lost because the buffer was full. */
+    uint16_t tid;       /**< Identifier of the thread in the trace. */
+    const char *name;   /**< Name of the thread. */
+    uint32_t last_timestamp; /**< Last timestamp dumped, to detect clock wraps. */
+    uint64_t wraps;     /**< Clock wraps, in clock ticks. */
+    struct trace_buffer *next; /**< Next registered buffer. */
+};
+
+/** @brief Sets the clock of the timestamps.
+ *
+ * By default, on a hosted system, the clock is the monotonic time in
+ * microseconds.
+ * @param [in] clock Function returning a free running counter.
+ * @param [in] ticks_per_us Frequency of the counter, in MHz.
+ */
+void trace_set_clock(uint32_t (*clock)(void), float ticks_per_us);
+
+/** @brief Registers the buffer of the calling thread.
+ *
+ * Registering a buffer again only makes it the one of the calling thread,
+ * and keeps its events. A buffer must be written by one thread at a time.
+ * @param [in] buf The buffer, which must stay valid until the end.
+ * @param [in] name Name of the thread in the trace.
+ */
+void trace_thread_register(struct trace_buffer *buf, const char *name);
+
+/** @brief Records an event in the buffer of the calling thread. */
+void trace_event(uint8_t type, const char *name, float value);
+
+/** @brief Writes the events of all the buffers and removes them.
+ *
+ * Can be called from any thread, while the others keep tracing. The
+ * format is the input of tools/trace2json.
+ * @param [in] f The output file.
+ */
+void trace_dump(FILE *f);
+
+#define TRACE_BEGIN(name) trace_event(TRACE_TYPE_BEGIN, (name), 0)
+#define TRACE_END(name) trace_event(TRACE_TYPE_END, (name), 0)
+#define TRACE_INSTANT(name) trace_event(TRACE_TYPE_INSTANT, (name), 0)
+#define TRACE_COUNTER(name, value) trace_event(TRACE_TYPE_COUNTER, (name), (value))
+
+#else
+
+#define TRACE_BEGIN(name) do {} while (0)
+#define TRACE_END(name) do {} while (0)
+#define TRACE_INSTANT(name) do {} while (0)
+#define TRACE_COUNTER(name, value) do {} while (0)
+
+#endif
+
+#endif
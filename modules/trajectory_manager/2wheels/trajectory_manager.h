@@ -381,6 +381,23 @@ void trajectory_only_a_abs(struct trajectory *traj, float a_deg, uint8_t correct
  */
 void trajectory_d_a_rel(struct trajectory *traj, float d_mm, float a_deg, uint8_t correction);
 
+/** @brief Go forward and turn at the same time, following an arc.
+ *
+ * Same as trajectory_d_a_rel(), but the speed and acceleration of the
+ * distance and angle ramps are scaled so both of them start and end
+ * together, in the shortest time allowed by the distance and angle
+ * limits. The robot then follows an arc which does not depend on the
+ * speeds, provided it is stopped when the function is called.
+ *
+ * @param [in] traj The trajectory manager instance.
+ * @param [in] d_mm The distance to go, in mm.
+ * @param [in] a_deg The angle to turn, in degrees.
+ * @param [in] correction Use external coder correction.
+ *
+ * @sa quadramp_sync.h
+ */
+void trajectory_d_a_rel_sync(struct trajectory *traj, float d_mm, float a_deg, uint8_t correction);
+
 /* commands using events */
 
 /** @brief Go to a point.
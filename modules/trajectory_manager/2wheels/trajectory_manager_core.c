@@ -38,6 +38,8 @@
 #include <2wheels/robot_system.h>
 #include <control_system_manager.h>
 #include <quadramp.h>
+#include <quadramp_sync.h>
+#include <trace.h>
 
 #include <2wheels/trajectory_manager.h>
 #include "trajectory_manager_utils.h"
@@ -213,6 +215,29 @@ void trajectory_d_a_rel(struct trajectory *traj, float d_mm, float a_deg, uint8_
                   RUNNING_AD, UPDATE_A | UPDATE_D);
 }
 
+void trajectory_d_a_rel_sync(struct trajectory *traj, float d_mm, float a_deg, uint8_t correction)
+{
+    struct quadramp_filter *q[2];
+    float target[2], speed[2], acc[2];
+
+    traj->correction = correction;
+    __trajectory_goto_d_a_rel(traj, d_mm, RAD(a_deg),
+                  RUNNING_AD, UPDATE_A | UPDATE_D);
+
+    /* __trajectory_goto_d_a_rel() restored the default limits, scale
+     * them so both ramps end together. */
+    q[0] = traj->csm_distance->consign_filter_params;
+    q[1] = traj->csm_angle->consign_filter_params;
+    target[0] = cs_get_consign(traj->csm_distance);
+    target[1] = cs_get_consign(traj->csm_angle);
+    speed[0] = traj->d_speed;
+    speed[1] = traj->a_speed;
+    acc[0] = traj->d_acc;
+    acc[1] = traj->a_acc;
+
+    quadramp_sync_goto(q, target, speed, acc, 2);
+}
+
 void trajectory_stop(struct trajectory *traj)
 {
     //DEBUG(E_TRAJECTORY, "stop");
@@ -700,6 +725,7 @@ void trajectory_manager_event(void * param)
 {
     struct trajectory *traj = (struct trajectory *)param;
 
+    TRACE_BEGIN("trajectory_manager_event");
 
     //while(1) {
         switch (traj->state) {
@@ -735,6 +761,8 @@ void trajectory_manager_event(void * param)
         }
         //OSTimeDlyHMSM(0, 0, 0, TRAJ_EVT_PERIOD);
     //}
+
+    TRACE_END("trajectory_manager_event");
 }
 
 #if 0
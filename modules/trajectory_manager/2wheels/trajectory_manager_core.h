@@ -62,6 +62,10 @@ void trajectory_only_a_abs(struct trajectory *traj, float a_deg_abs, uint8_t cor
 /** turn by 'a' degrees */
 void trajectory_d_a_rel(struct trajectory *traj, float d_mm, float a_deg, uint8_t correction);
 
+/** go forward by d_mm while turning by a_deg, both ramps starting and
+ * ending together so the robot follows an arc */
+void trajectory_d_a_rel_sync(struct trajectory *traj, float d_mm, float a_deg, uint8_t correction);
+
 /** set relative angle and distance consign to 0 */
 void trajectory_stop(struct trajectory *traj);
 
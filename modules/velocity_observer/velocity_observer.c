@@ -0,0 +1,80 @@
+#include <math.h>
+#include <stddef.h>
+#include <velocity_observer.h>
+
+void velocity_observer_init(struct velocity_observer *vo, float frequency) {
+    vo->period = 1. / frequency;
+    vo->source = NULL;
+    vo->source_param = NULL;
+    velocity_observer_set_bandwidth(vo, 2. * M_PI * frequency / 10., 1.);
+    velocity_observer_reset(vo);
+}
+
+void velocity_observer_set_bandwidth(struct velocity_observer *vo, float omega, float zeta) {
+    velocity_observer_set_gains(vo, 2. * zeta * omega, omega * omega);
+}
+
+void velocity_observer_set_gains(struct velocity_observer *vo, float kp, float ki) {
+    vo->kp = kp;
+    vo->ki = ki;
+}
+
+void velocity_observer_set_source(struct velocity_observer *vo,
+                                  float (*source)(void *), void *source_param) {
+    vo->source = source;
+    vo->source_param = source_param;
+}
+
+void velocity_observer_reset(struct velocity_observer *vo) {
+    vo->position = 0.;
+    vo->est_position = 0.;
+    vo->est_speed = 0.;
+    vo->speed = 0.;
+    vo->started = 0;
+}
+
+float velocity_observer_update(struct velocity_observer *vo, float position) {
+    float err;
+
+    vo->position = position;
+
+    /* Start from the first measure to avoid a large transient. */
+    if (!vo->started) {
+        vo->est_position = position;
+        vo->started = 1;
+        return vo->speed;
+    }
+
+    err = position - vo->est_position;
+    vo->est_speed += vo->ki * err * vo->period;
+    vo->speed = vo->est_speed + vo->kp * err;
+    vo->est_position += vo->speed * vo->period;
+
+    return vo->speed;
+}
+
+float velocity_observer_update_delta(struct velocity_observer *vo, float delta) {
+    vo->started = 1;
+    return velocity_observer_update(vo, vo->position + delta);
+}
+
+float velocity_observer_get_speed(struct velocity_observer *vo) {
+    return vo->speed;
+}
+
+float velocity_observer_get_position(struct velocity_observer *vo) {
+    return vo->est_position;
+}
+
+float velocity_observer_do_filter(void *data, float in) {
+    return velocity_observer_update(data, in);
+}
+
+float velocity_observer_process_out(void *data) {
+    struct velocity_observer *vo = data;
+
+    if (vo->source == NULL)
+        return vo->speed;
+
+    return velocity_observer_update(vo, vo->source(vo->source_param));
+}
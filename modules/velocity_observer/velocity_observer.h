@@ -0,0 +1,137 @@
+/** @file modules/velocity_observer/velocity_observer.h
+ * @author CVRA
+ * @brief Velocity estimation from a quantized position.
+ *
+ * Differentiating an encoder position gives a speed quantized to one tick
+ * per period: at low speed the measure jumps between 0 and a few ticks
+ * and the speed loops chatter. This module estimates the speed with a
+ * tracking loop (like the PLL used to demodulate resolvers): an estimated
+ * position follows the measured one, driven by a PI corrector whose
+ * integral term is the estimated speed.
+ *
+ * \f$ e = x - \hat{x} \f$, \f$ \hat{v} \leftarrow \hat{v} + k_i e T \f$,
+ * \f$ \hat{x} \leftarrow \hat{x} + (\hat{v} + k_p e) T \f$
+ *
+ * The error dynamics are \f$ s^2 + k_p s + k_i \f$, so the gains are set
+ * from a bandwidth \f$ \omega \f$ and a damping \f$ \zeta \f$ with
+ * \f$ k_p = 2 \zeta \omega \f$ and \f$ k_i = \omega^2 \f$. A higher
+ * bandwidth follows accelerations faster but lets more quantization noise
+ * through.
+ *
+ * The returned speed is \f$ \hat{v} + k_p e \f$, the speed at which the
+ * estimated position moves: it converges to the true speed, even when
+ * accelerating at a constant rate a. The integral term alone lags by
+ * \f$ k_p a / k_i \f$ in that case (20 mm/s per m/s^2 with
+ * \f$ \omega = 100 \f$, \f$ \zeta = 1 \f$), but the proportional term
+ * lets a bit more quantization noise through.
+ *
+ * The update is a few multiplications, it can be used in the feedback
+ * filter slot of a control system (position in, speed out):
+ * @code
+ * velocity_observer_init(&vo, 1000.);
+ * velocity_observer_set_bandwidth(&vo, 100., 1.);
+ * cs_set_process_out(&speed_cs, rs_get_distance, &rs);
+ * cs_set_feedback_filter(&speed_cs, velocity_observer_do_filter, &vo);
+ * @endcode
+ *
+ * or in the process out slot, reading the position itself:
+ * @code
+ * velocity_observer_set_source(&vo, rs_get_distance, &rs);
+ * cs_set_process_out(&speed_cs, velocity_observer_process_out, &vo);
+ * @endcode
+ *
+ * When only the displacement since the previous period is known (for
+ * example the holonomic odometry), velocity_observer_update_delta() can be
+ * used instead.
+ */
+
+#ifndef _VELOCITY_OBSERVER_H_
+#define _VELOCITY_OBSERVER_H_
+
+#include <stdint.h>
+
+/** A velocity observer instance. */
+struct velocity_observer {
+    float kp;           /**< Proportional gain, in 1/s. */
+    float ki;           /**< Integral gain, in 1/s^2. */
+    float period;       /**< Update period, in s. */
+
+    float position;     /**< Measured position (sum of the deltas). */
+    float est_position; /**< Estimated position. */
+    float est_speed;    /**< Integral term, in units / s. */
+    float speed;        /**< Estimated speed est_speed + kp * err, in units / s. */
+    uint8_t started;    /**< 0 until the first measure. */
+
+    float (*source)(void *); /**< Callback giving the position, for process_out. */
+    void *source_param; /**< Parameter of source. */
+};
+
+/** @brief Initializes the observer.
+ *
+ * The default bandwidth is a tenth of the update frequency, critically
+ * damped.
+ * @param [in] vo The velocity_observer instance.
+ * @param [in] frequency The frequency of the updates, in Hz.
+ */
+void velocity_observer_init(struct velocity_observer *vo, float frequency);
+
+/** @brief Sets the gains from the bandwidth of the observer.
+ * @param [in] vo The velocity_observer instance.
+ * @param [in] omega The natural frequency, in rad/s. It must stay well
+ * below the update frequency.
+ * @param [in] zeta The damping, 1 for a critically damped observer.
+ */
+void velocity_observer_set_bandwidth(struct velocity_observer *vo, float omega, float zeta);
+
+/** @brief Sets the gains directly.
+ * @param [in] vo The velocity_observer instance.
+ * @param [in] kp Proportional gain, in 1/s.
+ * @param [in] ki Integral gain, in 1/s^2.
+ */
+void velocity_observer_set_gains(struct velocity_observer *vo, float kp, float ki);
+
+/** @brief Sets the callback reading the position, for
+ * velocity_observer_process_out().
+ */
+void velocity_observer_set_source(struct velocity_observer *vo,
+                                  float (*source)(void *), void *source_param);
+
+/** @brief Restarts the observer from the next measure, with a null speed. */
+void velocity_observer_reset(struct velocity_observer *vo);
+
+/** @brief Updates the observer with a new position.
+ * @param [in] vo The velocity_observer instance.
+ * @param [in] position The measured position.
+ * @returns The estimated speed, in position units per second.
+ */
+float velocity_observer_update(struct velocity_observer *vo, float position);
+
+/** @brief Updates the observer with the displacement since the last update.
+ * @param [in] vo The velocity_observer instance.
+ * @param [in] delta The measured displacement.
+ * @returns The estimated speed, in position units per second.
+ */
+float velocity_observer_update_delta(struct velocity_observer *vo, float delta);
+
+/** @brief Returns the last estimated speed, in position units per second. */
+float velocity_observer_get_speed(struct velocity_observer *vo);
+
+/** @brief Returns the last estimated position. */
+float velocity_observer_get_position(struct velocity_observer *vo);
+
+/** @brief Feedback filter: position in, speed out.
+ *
+ * \param [in] data A pointer to a velocity_observer instance, casted to void *.
+ * \param [in] in The measured position.
+ * @returns The estimated speed.
+ */
+float velocity_observer_do_filter(void *data, float in);
+
+/** @brief Process out: reads the position from the source and returns
+ * the estimated speed.
+ *
+ * \param [in] data A pointer to a velocity_observer instance, casted to void *.
+ */
+float velocity_observer_process_out(void *data);
+
+#endif
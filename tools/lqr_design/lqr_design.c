@@ -0,0 +1,272 @@
+/** @file tools/lqr_design/lqr_design.c
+ * @author CVRA
+ * @brief Offline computation of the gains of the lqr module.
+ *
+ * Solves the discrete algebraic Riccati equation by iterating
+ *
+ * P = Q + A'PA - A'PB (R + B'PB)^-1 B'PA
+ *
+ * until it converges, then prints K = (R + B'PB)^-1 B'PA as a C array for
+ * lqr_set_gains(). See README.md for the usage.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_N 6
+#define MAX_M 2
+#define MAX_ITERATIONS 100000
+
+typedef double mat[MAX_N][MAX_N];
+
+static int n, m;
+static mat A, B, Q, R;
+
+/** c = a * b, with a of size r * k and b of size k * c_cols. */
+static void mul(mat c, mat a, mat b, int rows, int k, int cols)
+{
+    mat tmp;
+    int i, j, l;
+
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            tmp[i][j] = 0.;
+            for (l = 0; l < k; l++)
+                tmp[i][j] += a[i][l] * b[l][j];
+        }
+    }
+    memcpy(c, tmp, sizeof(mat));
+}
+
+static void transpose(mat t, mat a, int rows, int cols)
+{
+    mat tmp;
+    int i, j;
+
+    for (i = 0; i < rows; i++)
+        for (j = 0; j < cols; j++)
+            tmp[j][i] = a[i][j];
+    memcpy(t, tmp, sizeof(mat));
+}
+
+/** Inverts a size * size matrix (Gauss-Jordan). Returns -1 if singular. */
+static int invert(mat inv, mat a, int size)
+{
+    mat tmp;
+    int i, j, k, p;
+    double f;
+
+    memcpy(tmp, a, sizeof(mat));
+    memset(inv, 0, sizeof(mat));
+    for (i = 0; i < size; i++)
+        inv[i][i] = 1.;
+
+    for (i = 0; i < size; i++) {
+        p = i;
+        for (j = i + 1; j < size; j++)
+            if (fabs(tmp[j][i]) > fabs(tmp[p][i]))
+                p = j;
+
+        if (fabs(tmp[p][i]) < 1e-15)
+            return -1;
+
+        for (k = 0; k < size; k++) {
+            f = tmp[i][k]; tmp[i][k] = tmp[p][k]; tmp[p][k] = f;
+            f = inv[i][k]; inv[i][k] = inv[p][k]; inv[p][k] = f;
+        }
+
+        f = tmp[i][i];
+        for (k = 0; k < size; k++) {
+            tmp[i][k] /= f;
+            inv[i][k] /= f;
+        }
+
+        for (j = 0; j < size; j++) {
+            if (j == i)
+                continue;
+            f = tmp[j][i];
+            for (k = 0; k < size; k++) {
+                tmp[j][k] -= f * tmp[i][k];
+                inv[j][k] -= f * inv[i][k];
+            }
+        }
+    }
+    return 0;
+}
+
+/** K = (R + B'PB)^-1 B'PA. Returns -1 if R + B'PB is singular. */
+static int gain(mat K, mat P)
+{
+    mat Bt, BtP, S, Sinv, BtPA;
+    int i, j;
+
+    transpose(Bt, B, n, m);
+    mul(BtP, Bt, P, m, n, n);
+    mul(S, BtP, B, m, n, m);
+    for (i = 0; i < m; i++)
+        for (j = 0; j < m; j++)
+            S[i][j] += R[i][j];
+
+    if (invert(Sinv, S, m) < 0)
+        return -1;
+
+    mul(BtPA, BtP, A, m, n, n);
+    mul(K, Sinv, BtPA, m, m, n);
+    return 0;
+}
+
+/** Solves the Riccati equation, returns the number of iterations or -1. */
+static int riccati(mat K)
+{
+    mat P, Pn, At, AtP, AtPA, AtPB, X;
+    double diff, norm;
+    int it, i, j;
+
+    memcpy(P, Q, sizeof(mat));
+    transpose(At, A, n, n);
+
+    for (it = 1; it <= MAX_ITERATIONS; it++) {
+        if (gain(K, P) < 0)
+            return -1;
+
+        /* Pn = Q + A'PA - A'PB K */
+        mul(AtP, At, P, n, n, n);
+        mul(AtPA, AtP, A, n, n, n);
+        mul(AtPB, AtP, B, n, n, m);
+        mul(X, AtPB, K, n, m, n);
+
+        diff = 0.;
+        norm = 0.;
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < n; j++) {
+                Pn[i][j] = Q[i][j] + AtPA[i][j] - X[i][j];
+                diff += fabs(Pn[i][j] - P[i][j]);
+                norm += fabs(Pn[i][j]);
+            }
+        }
+        memcpy(P, Pn, sizeof(mat));
+
+        if (diff <= 1e-12 * norm) {
+            gain(K, P);
+            return it;
+        }
+    }
+    return -1;
+}
+
+static int read_matrix(FILE *f, mat a, int rows, int cols)
+{
+    int i, j;
+
+    for (i = 0; i < rows; i++)
+        for (j = 0; j < cols; j++)
+            if (fscanf(f, "%lf", &a[i][j]) != 1)
+                return -1;
+    return 0;
+}
+
+/** Reads n, m, then A (n * n), B (n * m), Q (n * n) and R (m * m). */
+static int read_model(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    int ret = -1;
+
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    if (fscanf(f, "%d %d", &n, &m) == 2 && n > 0 && n <= MAX_N && m > 0 && m <= MAX_M &&
+        read_matrix(f, A, n, n) == 0 && read_matrix(f, B, n, m) == 0 &&
+        read_matrix(f, Q, n, n) == 0 && read_matrix(f, R, m, m) == 0)
+        ret = 0;
+    else
+        fprintf(stderr, "%s: invalid model\n", path);
+
+    fclose(f);
+    return ret;
+}
+
+/** Builds the model of a 2 wheeled robot controlled in polar coordinates.
+ *
+ * The state is (distance, angle, distance speed, angle speed), in encoder
+ * ticks and periods, the speeds being the difference between the last two
+ * positions, as measured by lqr_2wheels. The commands are the left and
+ * right PWMs. Each PWM unit accelerates its wheel by gl or gr
+ * ticks / period^2, and the speeds decrease by a fraction c each period
+ * (friction, back EMF):
+ *
+ * v(k+1) = (1 - c) v(k) + g u(k), x(k+1) = x(k) + v(k+1)
+ */
+static void model_2wheels(char **argv)
+{
+    double gl = atof(argv[0]), gr = atof(argv[1]), c = atof(argv[2]);
+    int i;
+
+    n = 4;
+    m = 2;
+    memset(A, 0, sizeof(mat));
+    memset(B, 0, sizeof(mat));
+    memset(Q, 0, sizeof(mat));
+    memset(R, 0, sizeof(mat));
+
+    A[0][0] = 1.; A[0][2] = 1. - c;
+    A[1][1] = 1.; A[1][3] = 1. - c;
+    A[2][2] = 1. - c;
+    A[3][3] = 1. - c;
+
+    /* distance = (left + right) / 2, angle = (right - left) / 2 */
+    B[2][0] = gl / 2.;  B[2][1] = gr / 2.;
+    B[3][0] = -gl / 2.; B[3][1] = gr / 2.;
+    B[0][0] = B[2][0];  B[0][1] = B[2][1];
+    B[1][0] = B[3][0];  B[1][1] = B[3][1];
+
+    for (i = 0; i < 4; i++)
+        Q[i][i] = atof(argv[3 + i]);
+    R[0][0] = R[1][1] = atof(argv[7]);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s -f model.txt\n"
+            "       %s -2wheels gl gr c qd qa qvd qva r\n", name, name);
+}
+
+int main(int argc, char **argv)
+{
+    mat K;
+    int i, j, it;
+
+    if (argc == 3 && !strcmp(argv[1], "-f")) {
+        if (read_model(argv[2]) < 0)
+            return 1;
+    }
+    else if (argc == 10 && !strcmp(argv[1], "-2wheels")) {
+        model_2wheels(argv + 2);
+    }
+    else {
+        usage(argv[0]);
+        return 1;
+    }
+
+    it = riccati(K);
+    if (it < 0) {
+        fprintf(stderr, "the Riccati iteration did not converge\n");
+        return 1;
+    }
+
+    printf("/* lqr_design: converged in %d iterations */\n", it);
+    printf("static const float lqr_gains[%d * %d] = {\n", m, n);
+    for (i = 0; i < m; i++) {
+        printf("   ");
+        for (j = 0; j < n; j++)
+            printf(" %.9g%s", K[i][j], (i == m - 1 && j == n - 1) ? "" : ",");
+        printf("\n");
+    }
+    printf("};\n");
+
+    return 0;
+}
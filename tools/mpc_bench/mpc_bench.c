@@ -0,0 +1,123 @@
+/** @file tools/mpc_bench/mpc_bench.c
+ * @author CVRA
+ * @brief Execution time and tracking error of the mpc module.
+ *
+ * Follows a path with right angle corners with a simulated robot (a
+ * perfect unicycle following the speed commands) and prints, for several
+ * horizons, the mean, 99th percentile and worst time of mpc_update() and
+ * the tracking errors. N=1 is the baseline without anticipation. Build on
+ * the host with:
+ *
+ *   gcc -O2 -I../../modules/mpc -I../../modules/math/geometry \
+ *       mpc_bench.c ../../modules/mpc/mpc.c -lm -o mpc_bench
+ *
+ * The times are the ones of the host, but their ratio between horizons
+ * applies to the target too. The worst case does not stay close to the
+ * mean: on the host, the 99th percentile is 2 to 4 times the mean and the
+ * maximum 3 to more than 30 times (N=20 with 20 iterations: about 35 us
+ * mean, 120 to 145 us p99, 0.4 to 3.9 ms max over a few runs). Measure
+ * the worst case on the target before choosing the period.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <mpc.h>
+
+#define PERIOD 0.01
+#define STEPS 1500
+
+static const point_t path[] = {
+    {200, 200}, {1200, 200}, {1200, 900}, {500, 900}, {500, 1600}, {2000, 1600},
+};
+
+/** Distance from a point to the path. */
+static float path_distance(float x, float y)
+{
+    float best = 1e9, d, t, dx, dy;
+    unsigned i;
+
+    for (i = 0; i + 1 < sizeof(path) / sizeof(path[0]); i++) {
+        dx = path[i + 1].x - path[i].x;
+        dy = path[i + 1].y - path[i].y;
+        t = ((x - path[i].x) * dx + (y - path[i].y) * dy) / (dx * dx + dy * dy);
+        if (t < 0)
+            t = 0;
+        if (t > 1)
+            t = 1;
+        d = hypotf(x - path[i].x - t * dx, y - path[i].y - t * dy);
+        if (d < best)
+            best = d;
+    }
+    return best;
+}
+
+static int compare_times(const void *a, const void *b)
+{
+    double d = *(const double *)a - *(const double *)b;
+    return (d > 0) - (d < 0);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run(uint8_t horizon, uint8_t iterations)
+{
+    static struct mpc m;
+    static double times[STEPS];
+    float x = path[0].x, y = path[0].y, a = 0.;
+    float err, err_max = 0., err_sum = 0.;
+    double t, t_sum = 0., t_max = 0.;
+    int i;
+
+    mpc_init(&m, horizon, PERIOD);
+    mpc_set_iterations(&m, iterations);
+    mpc_set_limits(&m, 1000., 6., 1500.);
+    mpc_set_path(&m, path, sizeof(path) / sizeof(path[0]), 800.);
+    mpc_start(&m, 0., 0.);
+
+    for (i = 0; i < STEPS; i++) {
+        t = now();
+        mpc_update(&m, x, y, a);
+        t = now() - t;
+
+        times[i] = t;
+        t_sum += t;
+        if (t > t_max)
+            t_max = t;
+
+        x += m.v * PERIOD * cosf(a);
+        y += m.v * PERIOD * sinf(a);
+        a += m.w * PERIOD;
+
+        err = path_distance(x, y);
+        err_sum += err;
+        if (err > err_max)
+            err_max = err;
+    }
+
+    qsort(times, STEPS, sizeof(times[0]), compare_times);
+
+    printf("N=%2d it=%2d: %6.2f us mean, %6.2f us p99, %7.2f us max, "
+           "path error %5.1f mm mean, %5.1f mm max, end at %.1f mm of the goal\n",
+           horizon, iterations, t_sum / STEPS * 1e6, times[STEPS * 99 / 100] * 1e6,
+           t_max * 1e6,
+           err_sum / STEPS, err_max,
+           hypotf(x - path[5].x, y - path[5].y));
+}
+
+int main(void)
+{
+    run(1, 10);
+    run(10, 10);
+    run(10, 20);
+    run(15, 20);
+    run(20, 20);
+    run(20, 40);
+    return 0;
+}
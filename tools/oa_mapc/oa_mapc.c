@@ -0,0 +1,638 @@
+/** @file tools/oa_mapc/oa_mapc.c
+ * @author CVRA
+ * @brief Compiles a description of the static obstacles into an oa_map file.
+ *
+ * Usage: oa_mapc [-n] [-d cell] [-k cost] [-r rays] [-j threads] [-c name] map.txt output
+ *
+ * The input is a text file with one item per line ('#' starts a comment):
+ *  - "bbox x1 y1 x2 y2": the playground bounding box, in mm (required).
+ *  - "poly x1 y1 x2 y2 ...": a static obstacle, at least 2 vertices.
+ *  - "waypoint x y": a key position, the shortest paths between all the
+ *    waypoints are stored in the map.
+ *
+ * Options:
+ *  - -n: disables the tangent pruning of the rays.
+ *  - -d cell: adds a distance field with cells of the given size, in mm.
+ *  - -k cost: cost of a checkpoint for the paths, in mm, as given to
+ *    oa_set_checkpoint_cost() (1 by default).
+ *  - -r rays: number of rays left free in the buffer of the obstacle
+ *    avoidance for the start, the goal and the dynamic obstacles (by
+ *    default, the rays from the start and the goal to the static vertices).
+ *  - -j threads: number of threads computing the paths (1 by default).
+ *  - -c name: writes a C file defining the map as a const array called
+ *    name (and name_size, its size in bytes) instead of a binary file,
+ *    to link it in the firmware.
+ *
+ * See README.md for the build instructions.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include <polygon.h>
+#include <obstacle_avoidance.h>
+#include <oa_map.h>
+
+#define MAX_MAP_POLYS 254
+#define MAX_MAP_PTS 4096
+#define MAX_MAP_RAYS 16383
+#define MAX_MAP_WAYPOINTS 255
+#define LINE_MAX_LEN 4096
+
+static poly_t polys[MAX_MAP_POLYS + 1];
+static point_t points[MAX_MAP_PTS];
+static struct oa_map_poly map_polys[MAX_MAP_POLYS];
+static uint16_t poly_n, point_n;
+static point_t waypoints[MAX_MAP_WAYPOINTS];
+static uint16_t waypoint_n;
+static int32_t bbox[4];
+static uint8_t has_bbox;
+
+/* one more ray than allowed, to detect the maps having too many */
+static uint8_t rays[4 * (MAX_MAP_RAYS + 1)];
+
+/** Reads the map description, returns 0 on success. */
+static int read_map(FILE *f)
+{
+    char line[LINE_MAX_LEN];
+    char *p, *end;
+    int lineno = 0;
+    uint16_t first;
+    float x, y;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineno++;
+        if ((p = strchr(line, '#')) != NULL)
+            *p = '\0';
+
+        p = line + strspn(line, " \t\r\n");
+        if (*p == '\0')
+            continue;
+
+        if (!strncmp(p, "bbox", 4)) {
+            if (sscanf(p + 4, "%d %d %d %d", &bbox[0], &bbox[1], &bbox[2], &bbox[3]) != 4) {
+                fprintf(stderr, "line %d: invalid bbox\n", lineno);
+                return -1;
+            }
+            has_bbox = 1;
+        }
+        else if (!strncmp(p, "poly", 4)) {
+            if (poly_n == MAX_MAP_POLYS) {
+                fprintf(stderr, "line %d: too many polygons\n", lineno);
+                return -1;
+            }
+
+            first = point_n;
+            p += 4;
+            while (1) {
+                x = strtof(p, &end);
+                if (end == p)
+                    break;
+                p = end;
+                y = strtof(p, &end);
+                if (end == p || point_n == MAX_MAP_PTS || point_n - first == 255) {
+                    fprintf(stderr, "line %d: invalid polygon\n", lineno);
+                    return -1;
+                }
+                p = end;
+                points[point_n].x = x;
+                points[point_n].y = y;
+                point_n++;
+            }
+
+            if (point_n - first < 2) {
+                fprintf(stderr, "line %d: a polygon has at least 2 vertices\n", lineno);
+                return -1;
+            }
+            map_polys[poly_n].first = first;
+            map_polys[poly_n].len = point_n - first;
+            poly_n++;
+        }
+        else if (!strncmp(p, "waypoint", 8)) {
+            if (waypoint_n == MAX_MAP_WAYPOINTS) {
+                fprintf(stderr, "line %d: too many waypoints\n", lineno);
+                return -1;
+            }
+            if (sscanf(p + 8, "%f %f", &x, &y) != 2) {
+                fprintf(stderr, "line %d: invalid waypoint\n", lineno);
+                return -1;
+            }
+            waypoints[waypoint_n].x = x;
+            waypoints[waypoint_n].y = y;
+            waypoint_n++;
+        }
+        else {
+            fprintf(stderr, "line %d: unknown item\n", lineno);
+            return -1;
+        }
+    }
+
+    if (!has_bbox) {
+        fprintf(stderr, "missing bbox\n");
+        return -1;
+    }
+    /* oa_load_map() refuses the maps which do not fit next to the
+     * start/stop polygon */
+    if (poly_n > MAX_POLY - 1 || point_n > MAX_PTS - 2) {
+        fprintf(stderr, "%d polygons and %d vertices, the obstacle avoidance "
+                "keeps %d and %d\n", poly_n, point_n, MAX_POLY - 1, MAX_PTS - 2);
+        return -1;
+    }
+    return 0;
+}
+
+/** Distance from p to the segment (a, b). */
+static float segment_distance(const point_t *p, const point_t *a, const point_t *b)
+{
+    float dx = b->x - a->x, dy = b->y - a->y;
+    float t = 0, l = dx * dx + dy * dy;
+
+    if (l > 0) {
+        t = ((p->x - a->x) * dx + (p->y - a->y) * dy) / l;
+        if (t < 0)
+            t = 0;
+        if (t > 1)
+            t = 1;
+    }
+    return hypotf(p->x - (a->x + t * dx), p->y - (a->y + t * dy));
+}
+
+/** Distance from p to the nearest obstacle, 0 inside an obstacle. */
+static float obstacle_distance(const point_t *p)
+{
+    float d, best = 65535;
+    uint16_t i, j;
+
+    for (i = 1; i <= poly_n; i++) {
+        if (polys[i].l > 2 && is_in_poly(p, &polys[i]))
+            return 0;
+        for (j = 0; j < polys[i].l; j++) {
+            d = segment_distance(p, &polys[i].pts[j], &polys[i].pts[(j + 1) % polys[i].l]);
+            if (d < best)
+                best = d;
+        }
+    }
+    return best;
+}
+
+/* Visibility graph of the vertices and the waypoints, in compressed rows:
+ * the neighbours of node i are adj[adj_first[i]] to adj[adj_first[i + 1] - 1].
+ * Nodes 0 to point_n - 1 are the vertices, the waypoints follow. */
+static uint32_t *adj_first;
+static uint16_t *adj;
+static float *adj_cost;
+static float checkpoint_cost = 1;
+
+/* Result of the searches, path of waypoint i to waypoint j at
+ * i * waypoint_n + j. Each path of a search has its checkpoints in
+ * path_points[i], from paths[].first. */
+static struct oa_map_path *paths;
+static uint16_t **path_points;
+static uint32_t *path_point_n;
+static uint32_t next_source;
+static pthread_mutex_t source_lock = PTHREAD_MUTEX_INITIALIZER;
+static int path_error;
+
+static const point_t *node_point(uint16_t n)
+{
+    return n < point_n ? &points[n] : &waypoints[n - point_n];
+}
+
+/** Returns 1 if no static polygon crosses the segment (p1, p2). */
+static uint8_t is_visible(const point_t *p1, const point_t *p2)
+{
+    uint16_t i;
+
+    for (i = 1; i <= poly_n; i++) {
+        if (is_crossing_poly(*p1, *p2, NULL, &polys[i]) == 1)
+            return 0;
+    }
+    return 1;
+}
+
+/** Builds the visibility graph from the static rays, and the rays of the
+ * waypoints. The rays of the waypoints are not pruned: a shortest path
+ * only turns at tangent vertices anyway. */
+static void build_graph(const uint8_t *static_rays, uint16_t ray_n)
+{
+    uint32_t node_n = point_n + waypoint_n;
+    uint32_t max_edges = 2 * (ray_n / 4 + (uint32_t)waypoint_n * node_n);
+    uint16_t (*edges)[2] = malloc(max_edges * sizeof(*edges));
+    uint32_t *fill;
+    uint32_t edge_n = 0, i, j, k;
+    uint16_t a, b;
+
+    for (i = 0; i < ray_n; i += 4) {
+        a = map_polys[static_rays[i] - 1].first + static_rays[i + 1];
+        b = map_polys[static_rays[i + 2] - 1].first + static_rays[i + 3];
+        edges[edge_n][0] = a;
+        edges[edge_n++][1] = b;
+        edges[edge_n][0] = b;
+        edges[edge_n++][1] = a;
+    }
+
+    for (i = 0; i < waypoint_n; i++) {
+        if (!is_in_boundingbox(&waypoints[i]))
+            fprintf(stderr, "warning: waypoint %u is out of the bbox\n", i);
+        for (j = 1; j <= poly_n; j++) {
+            if (polys[j].l > 2 && is_in_poly(&waypoints[i], &polys[j]) == 1)
+                fprintf(stderr, "warning: waypoint %u is in polygon %u\n", i, j - 1);
+        }
+
+        for (j = 0; j < node_n; j++) {
+            if (j == point_n + i || (j < point_n && !is_in_boundingbox(&points[j])))
+                continue;
+            /* each pair of waypoints once */
+            if (j >= point_n && j < point_n + i)
+                continue;
+            if (!is_visible(&waypoints[i], node_point(j)))
+                continue;
+            edges[edge_n][0] = point_n + i;
+            edges[edge_n++][1] = j;
+            edges[edge_n][0] = j;
+            edges[edge_n++][1] = point_n + i;
+        }
+    }
+
+    adj_first = calloc(node_n + 1, sizeof(uint32_t));
+    adj = malloc(edge_n * sizeof(uint16_t));
+    adj_cost = malloc(edge_n * sizeof(float));
+    fill = calloc(node_n, sizeof(uint32_t));
+    for (k = 0; k < edge_n; k++)
+        adj_first[edges[k][0] + 1]++;
+    for (i = 0; i < node_n; i++)
+        adj_first[i + 1] += adj_first[i];
+    for (k = 0; k < edge_n; k++) {
+        a = edges[k][0];
+        b = edges[k][1];
+        j = adj_first[a] + fill[a]++;
+        adj[j] = b;
+        adj_cost[j] = hypotf(node_point(a)->x - node_point(b)->x,
+                             node_point(a)->y - node_point(b)->y);
+    }
+    free(fill);
+    free(edges);
+}
+
+/** Dijkstra from one waypoint, with the cost of oa_process(): the length
+ * plus the checkpoint cost of each ray. The other waypoints are ends
+ * only, as the obstacle avoidance does not know them. */
+static int search_paths(uint16_t source, float *cost, float *length, uint16_t *prev,
+                        uint8_t *done)
+{
+    uint32_t node_n = point_n + waypoint_n;
+    uint32_t i, k, count = 0, cap = 64;
+    uint16_t *out = malloc(cap * sizeof(uint16_t));
+    uint16_t best, n, len, src = point_n + source;
+    struct oa_map_path *path;
+    float c;
+
+    for (i = 0; i < node_n; i++) {
+        cost[i] = INFINITY;
+        done[i] = 0;
+    }
+    cost[src] = 0;
+    length[src] = 0;
+
+    /* the graph is dense, a linear scan is as fast as a heap */
+    while (1) {
+        best = 0xffff;
+        for (i = 0; i < node_n; i++) {
+            if (!done[i] && cost[i] < INFINITY && (best == 0xffff || cost[i] < cost[best]))
+                best = i;
+        }
+        if (best == 0xffff)
+            break;
+        done[best] = 1;
+        if (best >= point_n && best != src)
+            continue;
+
+        for (k = adj_first[best]; k < adj_first[best + 1]; k++) {
+            n = adj[k];
+            c = cost[best] + adj_cost[k] + checkpoint_cost;
+            if (!done[n] && c < cost[n]) {
+                cost[n] = c;
+                length[n] = length[best] + adj_cost[k];
+                prev[n] = best;
+            }
+        }
+    }
+
+    for (i = 0; i < waypoint_n; i++) {
+        path = &paths[source * waypoint_n + i];
+        path->first = count;
+        path->len = 0;
+        path->reserved = 0;
+        if (cost[point_n + i] == INFINITY) {
+            path->length = -1;
+            continue;
+        }
+        path->length = i == source ? 0 : length[point_n + i];
+
+        len = 0;
+        for (n = point_n + i; n != src; n = prev[n]) {
+            if (n != point_n + i)
+                len++;
+        }
+        if (len > 255)
+            return -1;
+        if (count + len > cap) {
+            cap = 2 * (count + len);
+            out = realloc(out, cap * sizeof(uint16_t));
+        }
+        path->len = len;
+        k = count + len;
+        for (n = point_n + i; n != src; n = prev[n]) {
+            if (n != point_n + i)
+                out[--k] = n;
+        }
+        count += len;
+    }
+
+    path_points[source] = out;
+    path_point_n[source] = count;
+    return 0;
+}
+
+/** Thread computing the paths of the waypoints not yet taken. */
+static void *path_thread(void *arg)
+{
+    uint32_t node_n = point_n + waypoint_n;
+    float *cost = malloc(node_n * sizeof(float));
+    float *length = malloc(node_n * sizeof(float));
+    uint16_t *prev = malloc(node_n * sizeof(uint16_t));
+    uint8_t *done = malloc(node_n);
+    uint32_t source;
+
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&source_lock);
+        source = next_source++;
+        pthread_mutex_unlock(&source_lock);
+        if (source >= waypoint_n)
+            break;
+
+        if (search_paths(source, cost, length, prev, done) < 0) {
+            pthread_mutex_lock(&source_lock);
+            path_error = 1;
+            pthread_mutex_unlock(&source_lock);
+        }
+    }
+
+    free(cost);
+    free(length);
+    free(prev);
+    free(done);
+    return NULL;
+}
+
+/** Computes the paths between all the waypoints, returns the checkpoint
+ * indexes in one array (its size in *count) and rebases the paths on it. */
+static uint16_t *compute_paths(const uint8_t *static_rays, uint16_t ray_n,
+                               int thread_n, uint32_t *count)
+{
+    pthread_t threads[thread_n];
+    uint16_t *all;
+    uint32_t i, j, total = 0;
+    int t;
+
+    build_graph(static_rays, ray_n);
+
+    paths = calloc((uint32_t)waypoint_n * waypoint_n, sizeof(struct oa_map_path));
+    path_points = calloc(waypoint_n, sizeof(uint16_t *));
+    path_point_n = calloc(waypoint_n, sizeof(uint32_t));
+    for (t = 0; t < thread_n; t++)
+        pthread_create(&threads[t], NULL, path_thread, NULL);
+    for (t = 0; t < thread_n; t++)
+        pthread_join(threads[t], NULL);
+    if (path_error)
+        return NULL;
+
+    for (i = 0; i < waypoint_n; i++)
+        total += path_point_n[i];
+    if (total > 65535)
+        return NULL;
+
+    all = malloc((total + 1) * sizeof(uint16_t));
+    total = 0;
+    for (i = 0; i < waypoint_n; i++) {
+        memcpy(all + total, path_points[i], path_point_n[i] * sizeof(uint16_t));
+        for (j = 0; j < waypoint_n; j++)
+            paths[i * waypoint_n + j].first += total;
+        total += path_point_n[i];
+        free(path_points[i]);
+    }
+    *count = total;
+    return all;
+}
+
+/** Appends a section to the file being built. */
+static void add_section(uint8_t *buf, uint32_t *size, struct oa_map_section *section,
+                        uint32_t type, const void *data, uint32_t data_size, uint32_t count)
+{
+    section->type = type;
+    section->offset = *size;
+    section->size = data_size;
+    section->count = count;
+    memcpy(buf + *size, data, data_size);
+    *size += (data_size + 3) & ~3u;
+}
+
+int main(int argc, char **argv)
+{
+    struct oa_map_header *header;
+    struct oa_map_section *sections;
+    struct oa_map_distance dist;
+    struct oa_map map;
+    uint8_t pruning = 1;
+    float cell = 0;
+    const char *c_name = NULL;
+    uint8_t *buf;
+    uint16_t *dist_data = NULL;
+    uint16_t *wp_points = NULL;
+    uint32_t wp_point_n = 0;
+    int thread_n = 1;
+    float *bounds;
+    uint32_t size, buf_size, i, j;
+    uint32_t ray_n;
+    int32_t free_ray_n = -1;
+    point_t c;
+    float d;
+    FILE *f;
+    int arg;
+
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (!strcmp(argv[arg], "-n"))
+            pruning = 0;
+        else if (!strcmp(argv[arg], "-d") && arg + 1 < argc)
+            cell = atof(argv[++arg]);
+        else if (!strcmp(argv[arg], "-k") && arg + 1 < argc)
+            checkpoint_cost = atof(argv[++arg]);
+        else if (!strcmp(argv[arg], "-r") && arg + 1 < argc && atoi(argv[arg + 1]) >= 0)
+            free_ray_n = atoi(argv[++arg]);
+        else if (!strcmp(argv[arg], "-j") && arg + 1 < argc && atoi(argv[arg + 1]) > 0)
+            thread_n = atoi(argv[++arg]);
+        else if (!strcmp(argv[arg], "-c") && arg + 1 < argc)
+            c_name = argv[++arg];
+        else
+            break;
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "usage: %s [-n] [-d cell] [-k cost] [-r rays] [-j threads] [-c name] map.txt output\n", argv[0]);
+        return 1;
+    }
+
+    f = fopen(argv[arg], "r");
+    if (f == NULL) {
+        perror(argv[arg]);
+        return 1;
+    }
+    if (read_map(f) < 0)
+        return 1;
+    fclose(f);
+
+    /* polygon 0 is the start/stop polygon of the obstacle avoidance,
+     * empty here */
+    polys[0].pts = points;
+    polys[0].l = 0;
+    for (i = 0; i < poly_n; i++) {
+        polys[i + 1].pts = &points[map_polys[i].first];
+        polys[i + 1].l = map_polys[i].len;
+    }
+
+    polygon_set_boundingbox(bbox[0], bbox[1], bbox[2], bbox[3]);
+    polygon_set_tangent_pruning(pruning);
+    ray_n = calc_rays(polys, poly_n + 1, rays, sizeof(rays));
+    if (ray_n > sizeof(rays)) {
+        fprintf(stderr, "too many rays, more than %d\n", MAX_MAP_RAYS);
+        return 1;
+    }
+    /* oa_process() fails when the static rays and the ones of the start,
+     * the goal and the dynamic obstacles do not fit in its buffer. With
+     * the pruning, a point has at most two tangents to a convex
+     * polygon. */
+    if (free_ray_n < 0)
+        free_ray_n = pruning ? 4 * poly_n + 1 : 2 * point_n + 1;
+    if (ray_n / 4 + free_ray_n > MAX_RAYS / 2) {
+        fprintf(stderr, "%u rays and %d free ones, the obstacle avoidance "
+                "only keeps %d\n", ray_n / 4, free_ray_n, MAX_RAYS / 2);
+        return 1;
+    }
+
+    /* bounding boxes, the start/stop polygon gets an empty one */
+    bounds = calloc(4 * (poly_n + 1), sizeof(float));
+    bounds[0] = bounds[poly_n + 1] = 1;
+    bounds[2 * (poly_n + 1)] = bounds[3 * (poly_n + 1)] = -1;
+    for (i = 1; i <= poly_n; i++) {
+        bounds[i] = bounds[2 * (poly_n + 1) + i] = polys[i].pts[0].x;
+        bounds[poly_n + 1 + i] = bounds[3 * (poly_n + 1) + i] = polys[i].pts[0].y;
+        for (j = 1; j < polys[i].l; j++) {
+            bounds[i] = fminf(bounds[i], polys[i].pts[j].x);
+            bounds[poly_n + 1 + i] = fminf(bounds[poly_n + 1 + i], polys[i].pts[j].y);
+            bounds[2 * (poly_n + 1) + i] = fmaxf(bounds[2 * (poly_n + 1) + i], polys[i].pts[j].x);
+            bounds[3 * (poly_n + 1) + i] = fmaxf(bounds[3 * (poly_n + 1) + i], polys[i].pts[j].y);
+        }
+    }
+
+    memset(&dist, 0, sizeof(dist));
+    if (cell > 0) {
+        dist.x0 = bbox[0];
+        dist.y0 = bbox[1];
+        dist.cell = cell;
+        dist.w = ceilf((bbox[2] - bbox[0]) / cell);
+        dist.h = ceilf((bbox[3] - bbox[1]) / cell);
+        dist_data = malloc(dist.w * dist.h * sizeof(uint16_t));
+        for (j = 0; j < dist.h; j++) {
+            for (i = 0; i < dist.w; i++) {
+                c.x = dist.x0 + (i + 0.5f) * cell;
+                c.y = dist.y0 + (j + 0.5f) * cell;
+                d = obstacle_distance(&c);
+                dist_data[j * dist.w + i] = d > 65534 ? 65534 : (uint16_t)d;
+            }
+        }
+    }
+
+    if (waypoint_n > 0) {
+        wp_points = compute_paths(rays, ray_n, thread_n, &wp_point_n);
+        if (wp_points == NULL) {
+            fprintf(stderr, "too many checkpoints in the paths\n");
+            return 1;
+        }
+    }
+
+    buf_size = sizeof(struct oa_map_header) + 9 * sizeof(struct oa_map_section) +
+               sizeof(bbox) + sizeof(map_polys) + point_n * sizeof(point_t) +
+               ray_n + 4 * (poly_n + 1) * sizeof(float) + sizeof(dist) +
+               dist.w * dist.h * sizeof(uint16_t) + waypoint_n * sizeof(point_t) +
+               (uint32_t)waypoint_n * waypoint_n * sizeof(struct oa_map_path) +
+               wp_point_n * sizeof(uint16_t) + 9 * 4;
+    buf = calloc(1, buf_size);
+
+    header = (struct oa_map_header *)buf;
+    header->magic = OA_MAP_MAGIC;
+    header->version = OA_MAP_VERSION;
+    header->flags = pruning ? OA_MAP_FLAG_TANGENT_PRUNING : 0;
+    header->checkpoint_cost = checkpoint_cost;
+    header->section_n = 5 + (cell > 0) + (waypoint_n > 0 ? 3 : 0);
+
+    sections = (struct oa_map_section *)(header + 1);
+    size = sizeof(struct oa_map_header) + header->section_n * sizeof(struct oa_map_section);
+    add_section(buf, &size, &sections[0], OA_MAP_SECTION_BBOX, bbox, sizeof(bbox), 4);
+    add_section(buf, &size, &sections[1], OA_MAP_SECTION_POLYS, map_polys,
+                poly_n * sizeof(struct oa_map_poly), poly_n);
+    add_section(buf, &size, &sections[2], OA_MAP_SECTION_POINTS, points,
+                point_n * sizeof(point_t), point_n);
+    add_section(buf, &size, &sections[3], OA_MAP_SECTION_RAYS, rays, ray_n, ray_n / 4);
+    add_section(buf, &size, &sections[4], OA_MAP_SECTION_BOUNDS, bounds,
+                4 * (poly_n + 1) * sizeof(float), poly_n + 1);
+    if (cell > 0) {
+        add_section(buf, &size, &sections[5], OA_MAP_SECTION_DISTANCE, &dist, sizeof(dist), 1);
+        memcpy(buf + size, dist_data, dist.w * dist.h * sizeof(uint16_t));
+        sections[5].size += dist.w * dist.h * sizeof(uint16_t);
+        size += (dist.w * dist.h * sizeof(uint16_t) + 3) & ~3u;
+    }
+    if (waypoint_n > 0) {
+        i = header->section_n - 3;
+        add_section(buf, &size, &sections[i], OA_MAP_SECTION_WAYPOINTS, waypoints,
+                    waypoint_n * sizeof(point_t), waypoint_n);
+        add_section(buf, &size, &sections[i + 1], OA_MAP_SECTION_PATHS, paths,
+                    (uint32_t)waypoint_n * waypoint_n * sizeof(struct oa_map_path),
+                    (uint32_t)waypoint_n * waypoint_n);
+        add_section(buf, &size, &sections[i + 2], OA_MAP_SECTION_PATH_POINTS, wp_points,
+                    wp_point_n * sizeof(uint16_t), wp_point_n);
+    }
+    header->size = size;
+
+    if (oa_map_open(&map, buf, size) < 0) {
+        fprintf(stderr, "internal error: invalid map\n");
+        return 1;
+    }
+
+    f = fopen(argv[arg + 1], c_name ? "w" : "wb");
+    if (f == NULL) {
+        perror(argv[arg + 1]);
+        return 1;
+    }
+
+    if (c_name) {
+        fprintf(f, "/* Generated by oa_mapc from %s, do not edit. */\n\n", argv[arg]);
+        fprintf(f, "#include <stdint.h>\n\n");
+        fprintf(f, "const uint32_t %s_size = %u;\n\n", c_name, size);
+        fprintf(f, "const uint32_t %s[%u] = {", c_name, size / 4);
+        for (i = 0; i < size / 4; i++)
+            fprintf(f, "%s0x%08x,", i % 6 ? " " : "\n    ", ((uint32_t *)buf)[i]);
+        fprintf(f, "\n};\n");
+    }
+    else {
+        fwrite(buf, 1, size, f);
+    }
+    fclose(f);
+
+    fprintf(stderr, "%d polygons, %d vertices, %u rays, %d waypoints, %u bytes\n",
+            poly_n, point_n, (unsigned)(ray_n / 4), waypoint_n, size);
+    return 0;
+}
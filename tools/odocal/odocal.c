@@ -0,0 +1,171 @@
+/** @file tools/odocal/odocal.c
+ * @author CVRA
+ * @brief Calibrates the odometry from a recording of runs.
+ *
+ * Usage:
+ *  odocal [-w mm mrad] [-n passes] -2wheels track imp_per_mm gl gr log.txt
+ *  odocal [-w mm mrad] [-n passes] -holonomic res b0 b1 b2 r0 r1 r2 d0 d1 d2 log.txt
+ *
+ * The parameters are the current ones, the starting point of the fit.
+ * The recording is a text file with one item per line ('#' starts a
+ * comment):
+ *  - "ref x y a": a known pose, in mm and degrees. It ends the current run
+ *    and starts the next one.
+ *  - "enc e0 e1 [e2]": raw encoder values, 2 or 3 depending on the robot.
+ *  - "break": drops the current run, when the robot was moved by hand.
+ *
+ * The file is read once per pass of odometry_calibration, it is never
+ * loaded in memory.
+ *
+ * See README.md for the build instructions.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <odometry_calibration.h>
+
+#define DEFAULT_MAX_PASSES 50
+
+/** Reads the recording once, giving its runs to the calibration.
+ * @return 0 on success, -1 on a syntax error. */
+static int read_pass(FILE *f, struct odometry_calibration *cal)
+{
+    char line[256], word[16], *c;
+    struct odocal_pose pose;
+    int32_t enc[3];
+    double a;
+    int line_n = 0, n;
+    uint8_t in_run = 0;
+
+    rewind(f);
+    odocal_pass_begin(cal);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line_n++;
+        c = strchr(line, '#');
+        if (c != NULL)
+            *c = '\0';
+        if (sscanf(line, " %15s", word) != 1)
+            continue;
+
+        if (!strcmp(word, "ref")) {
+            if (sscanf(line, " ref %lf %lf %lf", &pose.x, &pose.y, &a) != 3) {
+                fprintf(stderr, "line %d: ref x y a expected\n", line_n);
+                return -1;
+            }
+            pose.a = a * M_PI / 180.;
+            if (in_run)
+                odocal_run_end(cal, &pose);
+            odocal_run_begin(cal, &pose);
+            in_run = 1;
+        }
+        else if (!strcmp(word, "enc")) {
+            n = sscanf(line, " enc %d %d %d", &enc[0], &enc[1], &enc[2]);
+            if (n != cal->wheel_n) {
+                fprintf(stderr, "line %d: %d encoder values expected\n", line_n, cal->wheel_n);
+                return -1;
+            }
+            if (in_run)
+                odocal_add_sample(cal, enc);
+        }
+        else if (!strcmp(word, "break")) {
+            in_run = 0;
+        }
+        else {
+            fprintf(stderr, "line %d: unknown item %s\n", line_n, word);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct odometry_calibration cal;
+    double weight_xy = 1., weight_a = 1.;
+    int max_passes = DEFAULT_MAX_PASSES;
+    int arg, i, ret = ODOCAL_CONTINUE;
+    FILE *f;
+
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (!strcmp(argv[arg], "-w") && arg + 2 < argc) {
+            weight_xy = atof(argv[++arg]);
+            weight_a = atof(argv[++arg]);
+        }
+        else if (!strcmp(argv[arg], "-n") && arg + 1 < argc && atoi(argv[arg + 1]) > 0)
+            max_passes = atoi(argv[++arg]);
+        else
+            break;
+    }
+
+    if (arg < argc && !strcmp(argv[arg], "-2wheels") && argc - arg == 6) {
+        odocal_init_2wheels(&cal, atof(argv[arg + 1]), atof(argv[arg + 2]),
+                            atof(argv[arg + 3]), atof(argv[arg + 4]));
+    }
+    else if (arg < argc && !strcmp(argv[arg], "-holonomic") && argc - arg == 12) {
+        double beta[3], radius[3], distance[3];
+
+        for (i = 0; i < 3; i++) {
+            beta[i] = atof(argv[arg + 2 + i]) * M_PI / 180.;
+            radius[i] = atof(argv[arg + 5 + i]);
+            distance[i] = atof(argv[arg + 8 + i]);
+        }
+        odocal_init_holonomic(&cal, beta, radius, distance, atoi(argv[arg + 1]));
+    }
+    else {
+        fprintf(stderr, "usage: %s [-w mm mrad] [-n passes] -2wheels track imp_per_mm gl gr log.txt\n"
+                "       %s [-w mm mrad] [-n passes] -holonomic res b0 b1 b2 r0 r1 r2 d0 d1 d2 log.txt\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+    odocal_set_weights(&cal, weight_xy, weight_a / 1000.);
+
+    f = fopen(argv[argc - 1], "r");
+    if (f == NULL) {
+        perror(argv[argc - 1]);
+        return 1;
+    }
+
+    for (i = 0; i < max_passes && ret == ODOCAL_CONTINUE; i++) {
+        if (read_pass(f, &cal) < 0)
+            return 1;
+        ret = odocal_pass_end(&cal);
+        if (i == 0)
+            printf("%u runs, %u samples, initial RMS error %g\n",
+                   cal.run_n, cal.sample_n, odocal_get_rms(&cal));
+    }
+    fclose(f);
+
+    if (ret == ODOCAL_ERR_NO_RUN) {
+        fprintf(stderr, "no complete run, a run needs a ref line at both ends\n");
+        return 1;
+    }
+    if (ret == ODOCAL_ERR_SINGULAR) {
+        fprintf(stderr, "the runs do not constrain all the parameters, "
+                "record runs turning both ways\n");
+        return 1;
+    }
+    printf("%s after %d passes, RMS error %g\n",
+           ret == ODOCAL_CONVERGED ? "converged" : "stopped", i, odocal_get_rms(&cal));
+
+    if (cal.type == ODOCAL_2WHEELS) {
+        double track, imp_per_mm, gl, gr;
+
+        odocal_get_2wheels(&cal, &track, &imp_per_mm, &gl, &gr);
+        printf("track_mm %.4f\ndistance_imp_per_mm %.6f\n", track, imp_per_mm);
+        printf("left_gain %.6f\nright_gain %.6f\n", gl, gr);
+    }
+    else {
+        double beta[3], radius[3], distance[3], scale;
+
+        scale = odocal_get_holonomic(&cal, beta, radius, distance);
+        for (i = 0; i < 3; i++)
+            printf("wheel %d: beta %.4f deg, radius %.6f, distance %.4f\n",
+                   i, beta[i] * 180. / M_PI, radius[i], distance[i]);
+        printf("distance_scale %.6f\n", scale);
+    }
+    return 0;
+}
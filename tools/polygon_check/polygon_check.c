@@ -0,0 +1,102 @@
+/** @file tools/polygon_check/polygon_check.c
+ * @author CVRA
+ * @brief Regression checks of is_crossing_poly() with concave polygons.
+ *
+ * Compares is_crossing_poly() on L and U shaped obstacles with a brute
+ * force test sampling points along the segment, for segments with their
+ * ends on a grid so that many of them run along edges or through
+ * vertices. Returns a non zero status if a crossing is missed or
+ * invented. Build on the host with:
+ *
+ *   gcc -O2 -I../../include -I../../modules/math/geometry polygon_check.c \
+ *       ../../modules/math/geometry/polygon.c \
+ *       ../../modules/math/geometry/lines.c \
+ *       ../../modules/math/geometry/vect_base.c -lm -o polygon_check
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <polygon.h>
+
+#define SAMPLES 512
+#define GRID 100
+
+static point_t shape_l[] = {
+    {500, 1200}, {700, 1200}, {700, 800}, {900, 800}, {900, 600}, {500, 600},
+};
+
+static point_t shape_u[] = {
+    {500, 600}, {1100, 600}, {1100, 1200}, {900, 1200},
+    {900, 800}, {700, 800}, {700, 1200}, {500, 1200},
+};
+
+/** Returns 1 if an end or a sampled point of the segment is inside. */
+static int brute_crossing(point_t p1, point_t p2, poly_t *pol)
+{
+    point_t m;
+    int i;
+
+    for (i = 0; i <= SAMPLES; i++) {
+        m.x = p1.x + (p2.x - p1.x) * i / SAMPLES;
+        m.y = p1.y + (p2.y - p1.y) * i / SAMPLES;
+        if (is_in_poly(&m, pol) == 1)
+            return 1;
+    }
+    return 0;
+}
+
+/** Checks all the segments between grid points around a polygon.
+ * @return The number of wrong answers. */
+static int check_shape(const char *name, point_t *pts, uint8_t n)
+{
+    poly_t pol = { pts, n };
+    point_t p1, p2;
+    int32_t x1, y1, x2, y2;
+    int missed = 0, spurious = 0, total = 0, got, expected;
+
+    for (x1 = 400; x1 <= 1200; x1 += GRID)
+    for (y1 = 500; y1 <= 1300; y1 += GRID)
+    for (x2 = 400; x2 <= 1200; x2 += GRID)
+    for (y2 = 500; y2 <= 1300; y2 += GRID) {
+        if (x1 == x2 && y1 == y2)
+            continue;
+        p1.x = x1; p1.y = y1;
+        p2.x = x2; p2.y = y2;
+        got = is_crossing_poly(p1, p2, NULL, &pol) == 1;
+        expected = brute_crossing(p1, p2, &pol);
+        total++;
+        if (expected && !got) {
+            if (missed < 5)
+                printf("%s: (%d %d) -> (%d %d) crosses, not seen\n", name,
+                       (int)x1, (int)y1, (int)x2, (int)y2);
+            missed++;
+        }
+        else if (got && !expected) {
+            if (spurious < 5)
+                printf("%s: (%d %d) -> (%d %d) does not cross, seen\n", name,
+                       (int)x1, (int)y1, (int)x2, (int)y2);
+            spurious++;
+        }
+    }
+    printf("%s: %d missed and %d spurious crossings out of %d segments\n",
+           name, missed, spurious, total);
+    return missed + spurious;
+}
+
+int main(void)
+{
+    poly_t l = { shape_l, sizeof(shape_l) / sizeof(shape_l[0]) };
+    point_t start = { 700, 1500 }, goal = { 700, 300 };
+    int bad = 0;
+
+    /* runs along the edge x = 700, then through the inside of the L */
+    if (is_crossing_poly(start, goal, NULL, &l) != 1) {
+        printf("L: vertical line x = 700 not seen as crossing\n");
+        bad++;
+    }
+
+    bad += check_shape("L", shape_l, sizeof(shape_l) / sizeof(shape_l[0]));
+    bad += check_shape("U", shape_u, sizeof(shape_u) / sizeof(shape_u[0]));
+    return bad != 0;
+}
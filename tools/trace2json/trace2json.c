@@ -0,0 +1,117 @@
+/** @file tools/trace2json/trace2json.c
+ * @author CVRA
+ * @brief Converts the output of trace_dump() to the Chrome trace format.
+ *
+ * Usage: trace2json [trace.txt] > trace.json
+ *
+ * The result can be opened in chrome://tracing or ui.perfetto.dev. Build
+ * on the host with gcc -O2 -o trace2json trace2json.c.
+ *
+ * Input lines:
+ *  - "T tid name": name of a thread,
+ *  - "E tid type timestamp_us value name": an event,
+ *  - "D tid count": events lost because the buffer was full.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_MAX_LEN 512
+
+/** Writes a JSON string, escaping the special characters. */
+static void print_string(const char *s)
+{
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            printf("\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            printf("\\u%04x", *s);
+        else
+            putchar(*s);
+    }
+    putchar('"');
+}
+
+/** Removes the end of line. */
+static void chomp(char *s)
+{
+    size_t len = strlen(s);
+
+    while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r'))
+        s[--len] = '\0';
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    char line[LINE_MAX_LEN];
+    char type;
+    unsigned tid, count;
+    double ts, value;
+    int offset, first = 1;
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [trace.txt]\n", argv[0]);
+        return 1;
+    }
+
+    if (argc == 2) {
+        in = fopen(argv[1], "r");
+        if (in == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    printf("{\"traceEvents\":[\n");
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        chomp(line);
+
+        if (sscanf(line, "T %u %n", &tid, &offset) == 1) {
+            printf("%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":",
+                   first ? "" : ",\n", tid);
+            print_string(line + offset);
+            printf("}}");
+        }
+        else if (sscanf(line, "E %u %c %lf %lf %n", &tid, &type, &ts, &value, &offset) == 4) {
+            printf("%s{\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":", first ? "" : ",\n", tid, ts);
+            print_string(line + offset);
+
+            switch (type) {
+            case 'B':
+                printf(",\"ph\":\"B\"}");
+                break;
+            case 'E':
+                printf(",\"ph\":\"E\"}");
+                break;
+            case 'C':
+                printf(",\"ph\":\"C\",\"args\":{\"value\":%g}}", value);
+                break;
+            default:
+                printf(",\"ph\":\"i\",\"s\":\"t\"}");
+                break;
+            }
+        }
+        else if (sscanf(line, "D %u %u", &tid, &count) == 2) {
+            fprintf(stderr, "thread %u: %u events lost\n", tid, count);
+            continue;
+        }
+        else {
+            if (line[0] != '\0')
+                fprintf(stderr, "ignored line: %s\n", line);
+            continue;
+        }
+
+        first = 0;
+    }
+
+    printf("\n]}\n");
+
+    if (in != stdin)
+        fclose(in);
+
+    return 0;
+}